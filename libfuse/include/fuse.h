@@ -596,6 +596,38 @@ struct fuse_operations {
 	 */
 	int (*fallocate) (const char *, int, off_t, off_t,
 			  struct fuse_file_info *);
+
+	/**
+	 * Find next data or hole after the specified offset
+	 *
+	 * Only SEEK_DATA and SEEK_HOLE are sent by the kernel. Returns
+	 * the resulting offset or a negated error.  If not
+	 * implemented the kernel falls back to treating the whole
+	 * file as data.
+	 */
+	off_t (*lseek) (const char *, off_t off, int whence,
+			struct fuse_file_info *);
+
+	/**
+	 * Copy a range of data from one file to another
+	 *
+	 * Performs an optimized copy between two file descriptors
+	 * without the additional cost of transferring data through
+	 * the FUSE kernel module to user space (glibc) and then back
+	 * into the FUSE filesystem again.
+	 *
+	 * Returns the number of bytes written or a negated error. If
+	 * not implemented the kernel falls back to reading and
+	 * writing the data.
+	 */
+	ssize_t (*copy_file_range) (const char *path_in,
+				    struct fuse_file_info *fi_in,
+				    off_t offset_in,
+				    const char *path_out,
+				    struct fuse_file_info *fi_out,
+				    off_t offset_out,
+				    size_t size,
+				    int flags);
 };
 
 /** Extra context that may be needed by some filesystems
@@ -713,6 +745,39 @@ double fuse_config_get_entry_timeout(const struct fuse *fuse_);
 double fuse_config_get_negative_entry_timeout(const struct fuse *fuse_);
 double fuse_config_get_attr_timeout(const struct fuse *fuse_);
 
+/**
+ * Register `fd_` as a backing file for passthrough io. On success
+ * returns a positive backing id to be set in fuse_file_info's
+ * backing_id by open() or create() and later released with
+ * fuse_passthrough_close(). Returns -errno on failure.
+ */
+int fuse_passthrough_open(struct fuse *fuse_, const int fd_);
+int fuse_passthrough_close(struct fuse *fuse_, const int backing_id_);
+
+/**
+ * Requests, directory handles and path buffers are recycled through
+ * per-thread free lists rather than returned to malloc. `allocated`
+ * is the number of objects obtained from the heap, `inuse` those
+ * handed out and `cached` those sitting in a free list.
+ */
+enum fuse_pool_type
+  {
+    FUSE_POOL_REQ,
+    FUSE_POOL_DH,
+    FUSE_POOL_PATH,
+    FUSE_POOL_MAX
+  };
+
+struct fuse_pool_stats
+{
+  uint64_t allocated;
+  uint64_t inuse;
+  uint64_t cached;
+};
+
+void fuse_pool_get_stats(const enum fuse_pool_type  type_,
+                         struct fuse_pool_stats    *stats_);
+
 /**
  * FUSE event loop with multiple threads
  *
@@ -906,6 +971,13 @@ int fuse_fs_poll(struct fuse_fs *fs, const char *path,
 		 unsigned *reventsp);
 int fuse_fs_fallocate(struct fuse_fs *fs, const char *path, int mode,
 		 off_t offset, off_t length, struct fuse_file_info *fi);
+off_t fuse_fs_lseek(struct fuse_fs *fs, const char *path, off_t off,
+		    int whence, struct fuse_file_info *fi);
+ssize_t fuse_fs_copy_file_range(struct fuse_fs *fs, const char *path_in,
+				struct fuse_file_info *fi_in, off_t off_in,
+				const char *path_out,
+				struct fuse_file_info *fi_out, off_t off_out,
+				size_t len, int flags);
 void fuse_fs_init(struct fuse_fs *fs, struct fuse_conn_info *conn);
 void fuse_fs_destroy(struct fuse_fs *fs);
 
@@ -85,6 +85,11 @@ struct fuse_file_info {
 
 	/** Lock owner id.  Available in locking operations and flush */
 	uint64_t lock_owner;
+
+	/** Backing file id from fuse_passthrough_open().  If set by
+	    open() or create() the kernel performs reads and writes
+	    directly against the backing file. */
+	int32_t backing_id;
 };
 
 /**
@@ -100,6 +105,7 @@ struct fuse_file_info {
  * FUSE_CAP_SPLICE_MOVE: ability to move data to the fuse device with splice()
  * FUSE_CAP_SPLICE_READ: ability to use splice() to read from the fuse device
  * FUSE_CAP_IOCTL_DIR: ioctl support on directories
+ * FUSE_CAP_PASSTHROUGH: passthrough read/write io to a backing file
  */
 #define FUSE_CAP_ASYNC_READ	(1 << 0)
 #define FUSE_CAP_POSIX_LOCKS	(1 << 1)
@@ -112,6 +118,7 @@ struct fuse_file_info {
 #define FUSE_CAP_SPLICE_READ	(1 << 9)
 #define FUSE_CAP_FLOCK_LOCKS	(1 << 10)
 #define FUSE_CAP_IOCTL_DIR	(1 << 11)
+#define FUSE_CAP_PASSTHROUGH	(1 << 12)
 
 /**
  * Ioctl flags
@@ -183,10 +190,16 @@ struct fuse_conn_info {
 	 */
 	unsigned congestion_threshold;
 
+	/**
+	 * Maximum stacking depth of backing files used for
+	 * passthrough.  Only used if FUSE_CAP_PASSTHROUGH is wanted.
+	 */
+	unsigned max_stack_depth;
+
 	/**
 	 * For future use.
 	 */
-	unsigned reserved[23];
+	unsigned reserved[22];
 };
 
 struct fuse_session;
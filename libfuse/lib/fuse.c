@@ -38,6 +38,7 @@
 #include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
 
 #define FUSE_NODE_SLAB 1
 
@@ -151,6 +152,7 @@ struct fuse {
 	struct list_head partial_slabs;
 	struct list_head full_slabs;
 	pthread_t prune_thread;
+	unsigned int opendir_count;
 };
 
 struct lock {
@@ -779,6 +781,50 @@ out_err:
 	return node;
 }
 
+/*
+ * Path buffers start out at PATH_BUF_SIZE bytes and come from a pool.
+ * The rare one which has to grow is replaced with a plain heap
+ * buffer. The size kept in front of the string tells path_free()
+ * which it is.
+ */
+#define PATH_BUF_SIZE 256
+
+struct path_buf {
+	size_t size;
+	char data[];
+};
+
+static char *path_alloc(unsigned size)
+{
+	struct path_buf *pb;
+
+	if (size == PATH_BUF_SIZE)
+		pb = fuse_pool_alloc(FUSE_POOL_PATH,
+				     sizeof(struct path_buf) + PATH_BUF_SIZE);
+	else
+		pb = malloc(sizeof(struct path_buf) + size);
+	if (pb == NULL)
+		return NULL;
+
+	pb->size = size;
+
+	return pb->data;
+}
+
+static void path_free(char *path)
+{
+	struct path_buf *pb;
+
+	if (path == NULL)
+		return;
+
+	pb = (struct path_buf *) (path - offsetof(struct path_buf, data));
+	if (pb->size == PATH_BUF_SIZE)
+		fuse_pool_free(FUSE_POOL_PATH, pb);
+	else
+		free(pb);
+}
+
 static char *add_name(char **buf, unsigned *bufsize, char *s, const char *name)
 {
 	size_t len = strlen(name);
@@ -795,13 +841,14 @@ static char *add_name(char **buf, unsigned *bufsize, char *s, const char *name)
 				newbufsize *= 2;
 		}
 
-		newbuf = realloc(*buf, newbufsize);
+		newbuf = path_alloc(newbufsize);
 		if (newbuf == NULL)
 			return NULL;
 
-		*buf = newbuf;
 		s = newbuf + newbufsize - pathlen;
-		memmove(s, newbuf + *bufsize - pathlen, pathlen);
+		memcpy(s, *buf + *bufsize - pathlen, pathlen);
+		path_free(*buf);
+		*buf = newbuf;
 		*bufsize = newbufsize;
 	}
 	s -= len;
@@ -836,7 +883,7 @@ static void unlock_path(struct fuse *f, fuse_ino_t nodeid, struct node *wnode,
 static int try_get_path(struct fuse *f, fuse_ino_t nodeid, const char *name,
 			char **path, struct node **wnodep, bool need_lock)
 {
-	unsigned bufsize = 256;
+	unsigned bufsize = PATH_BUF_SIZE;
 	char *buf;
 	char *s;
 	struct node *node;
@@ -846,7 +893,7 @@ static int try_get_path(struct fuse *f, fuse_ino_t nodeid, const char *name,
 	*path = NULL;
 
 	err = -ENOMEM;
-	buf = malloc(bufsize);
+	buf = path_alloc(bufsize);
 	if (buf == NULL)
 		goto out_err;
 
@@ -909,7 +956,7 @@ static int try_get_path(struct fuse *f, fuse_ino_t nodeid, const char *name,
 	if (need_lock)
 		unlock_path(f, nodeid, wnode, node);
  out_free:
-	free(buf);
+	path_free(buf);
 
  out_err:
 	return err;
@@ -1116,7 +1163,7 @@ static int try_get_path2(struct fuse *f, fuse_ino_t nodeid1, const char *name1,
 			struct node *wn1 = wnode1 ? *wnode1 : NULL;
 
 			unlock_path(f, nodeid1, wn1, NULL);
-			free(*path1);
+			path_free(*path1);
 		}
 	}
 	return err;
@@ -1163,7 +1210,7 @@ static void free_path_wrlock(struct fuse *f, fuse_ino_t nodeid,
 	if (f->lockq)
 		wake_up_queued(f);
 	pthread_mutex_unlock(&f->lock);
-	free(path);
+	path_free(path);
 }
 
 static void free_path(struct fuse *f, fuse_ino_t nodeid, char *path)
@@ -1181,8 +1228,8 @@ static void free_path2(struct fuse *f, fuse_ino_t nodeid1, fuse_ino_t nodeid2,
 	unlock_path(f, nodeid2, wnode2, NULL);
 	wake_up_queued(f);
 	pthread_mutex_unlock(&f->lock);
-	free(path1);
-	free(path2);
+	path_free(path1);
+	path_free(path2);
 }
 
 static void forget_node(struct fuse *f, fuse_ino_t nodeid, uint64_t nlookup)
@@ -2256,6 +2303,47 @@ int fuse_fs_fallocate(struct fuse_fs *fs, const char *path, int mode,
 		return -ENOSYS;
 }
 
+off_t fuse_fs_lseek(struct fuse_fs *fs, const char *path, off_t off,
+		    int whence, struct fuse_file_info *fi)
+{
+	fuse_get_context()->private_data = fs->user_data;
+	if (fs->op.lseek) {
+		if (fs->debug)
+			fprintf(stderr, "lseek[%llu] %llu %s\n",
+				(unsigned long long) fi->fh,
+				(unsigned long long) off,
+				(whence == SEEK_DATA) ? "SEEK_DATA" :
+				(whence == SEEK_HOLE) ? "SEEK_HOLE" : "???");
+
+		return fs->op.lseek(path, off, whence, fi);
+	} else
+		return -ENOSYS;
+}
+
+ssize_t fuse_fs_copy_file_range(struct fuse_fs *fs, const char *path_in,
+				struct fuse_file_info *fi_in, off_t off_in,
+				const char *path_out,
+				struct fuse_file_info *fi_out, off_t off_out,
+				size_t len, int flags)
+{
+	fuse_get_context()->private_data = fs->user_data;
+	if (fs->op.copy_file_range) {
+		if (fs->debug)
+			fprintf(stderr, "copy_file_range[%llu] %llu -> [%llu] %llu, %zu bytes, flags 0x%x\n",
+				(unsigned long long) fi_in->fh,
+				(unsigned long long) off_in,
+				(unsigned long long) fi_out->fh,
+				(unsigned long long) off_out,
+				len,
+				flags);
+
+		return fs->op.copy_file_range(path_in, fi_in, off_in,
+					      path_out, fi_out, off_out,
+					      len, flags);
+	} else
+		return -ENOSYS;
+}
+
 static int is_open(struct fuse *f, fuse_ino_t dir, const char *name)
 {
 	struct node *node;
@@ -2301,7 +2389,7 @@ static char *hidden_name(struct fuse *f, fuse_ino_t dir, const char *oldname,
 		res = fuse_fs_getattr(f->fs, newpath, &buf);
 		if (res == -ENOENT)
 			break;
-		free(newpath);
+		path_free(newpath);
 		newpath = NULL;
 	} while(res == 0 && --failctr);
 
@@ -2320,7 +2408,7 @@ static int hide_node(struct fuse *f, const char *oldpath,
 		err = fuse_fs_rename(f->fs, oldpath, newpath);
 		if (!err)
 			err = rename_node(f, dir, oldname, dir, newname, 1);
-		free(newpath);
+		path_free(newpath);
 	}
 	return err;
 }
@@ -3223,7 +3311,8 @@ static void fuse_lib_opendir(fuse_req_t req, fuse_ino_t ino,
 	char *path;
 	int err;
 
-	dh = (struct fuse_dh *) malloc(sizeof(struct fuse_dh));
+	dh = (struct fuse_dh *) fuse_pool_alloc(FUSE_POOL_DH,
+						sizeof(struct fuse_dh));
 	if (dh == NULL) {
 		reply_err(req, -ENOMEM);
 		return;
@@ -3249,17 +3338,23 @@ static void fuse_lib_opendir(fuse_req_t req, fuse_ino_t ino,
 		dh->fh = fi.fh;
 	}
 	if (!err) {
+		pthread_mutex_lock(&f->lock);
+		f->opendir_count++;
+		pthread_mutex_unlock(&f->lock);
 		if (fuse_reply_open(req, llfi) == -ENOENT) {
 			/* The opendir syscall was interrupted, so it
 			   must be cancelled */
 			fuse_fs_releasedir(f->fs, path, &fi);
+			pthread_mutex_lock(&f->lock);
+			f->opendir_count--;
+			pthread_mutex_unlock(&f->lock);
 			pthread_mutex_destroy(&dh->lock);
-			free(dh);
+			fuse_pool_free(FUSE_POOL_DH, dh);
 		}
 	} else {
 		reply_err(req, err);
 		pthread_mutex_destroy(&dh->lock);
-		free(dh);
+		fuse_pool_free(FUSE_POOL_DH, dh);
 	}
 	free_path(f, ino, path);
 }
@@ -3427,11 +3522,15 @@ static void fuse_lib_releasedir(fuse_req_t req, fuse_ino_t ino,
 	fuse_finish_interrupt(f, req, &d);
 	free_path(f, ino, path);
 
+	pthread_mutex_lock(&f->lock);
+	f->opendir_count--;
+	pthread_mutex_unlock(&f->lock);
+
 	pthread_mutex_lock(&dh->lock);
 	pthread_mutex_unlock(&dh->lock);
 	pthread_mutex_destroy(&dh->lock);
 	free(dh->contents);
-	free(dh);
+	fuse_pool_free(FUSE_POOL_DH, dh);
 	reply_err(req, 0);
 }
 
@@ -3986,6 +4085,68 @@ static void fuse_lib_fallocate(fuse_req_t req, fuse_ino_t ino, int mode,
 	reply_err(req, err);
 }
 
+static void fuse_lib_lseek(fuse_req_t req, fuse_ino_t ino, off_t off,
+			   int whence, struct fuse_file_info *fi)
+{
+	struct fuse *f = req_fuse_prepare(req);
+	struct fuse_intr_data d;
+	char *path;
+	off_t res;
+	int err;
+
+	err = get_path_nullok(f, ino, &path);
+	if (err) {
+		reply_err(req, err);
+		return;
+	}
+
+	fuse_prepare_interrupt(f, req, &d);
+	res = fuse_fs_lseek(f->fs, path, off, whence, fi);
+	fuse_finish_interrupt(f, req, &d);
+	free_path(f, ino, path);
+	if (res >= 0)
+		fuse_reply_lseek(req, res);
+	else
+		reply_err(req, res);
+}
+
+static void fuse_lib_copy_file_range(fuse_req_t req, fuse_ino_t nodeid_in,
+				     off_t off_in, struct fuse_file_info *fi_in,
+				     fuse_ino_t nodeid_out, off_t off_out,
+				     struct fuse_file_info *fi_out, size_t len,
+				     int flags)
+{
+	struct fuse *f = req_fuse_prepare(req);
+	struct fuse_intr_data d;
+	char *path_in, *path_out;
+	ssize_t res;
+	int err;
+
+	err = get_path_nullok(f, nodeid_in, &path_in);
+	if (err) {
+		reply_err(req, err);
+		return;
+	}
+
+	err = get_path_nullok(f, nodeid_out, &path_out);
+	if (err) {
+		free_path(f, nodeid_in, path_in);
+		reply_err(req, err);
+		return;
+	}
+
+	fuse_prepare_interrupt(f, req, &d);
+	res = fuse_fs_copy_file_range(f->fs, path_in, fi_in, off_in, path_out,
+				      fi_out, off_out, len, flags);
+	fuse_finish_interrupt(f, req, &d);
+	free_path(f, nodeid_in, path_in);
+	free_path(f, nodeid_out, path_out);
+	if (res >= 0)
+		fuse_reply_write(req, res);
+	else
+		reply_err(req, res);
+}
+
 static int clean_delay(struct fuse *f)
 {
 	/*
@@ -4041,6 +4202,305 @@ int fuse_clean_cache(struct fuse *f)
 	return clean_delay(f);
 }
 
+/*
+ * Handover state. The connection parameters followed by every node
+ * known to the kernel. Fixed width fields only so that different
+ * builds can exchange it.
+ */
+struct handover_state {
+	uint32_t proto_major;
+	uint32_t proto_minor;
+	uint32_t async_read;
+	uint32_t max_write;
+	uint32_t max_readahead;
+	uint32_t capable;
+	uint32_t want;
+	uint32_t max_background;
+	uint32_t congestion_threshold;
+	uint32_t max_stack_depth;
+	uint32_t generation;
+	uint32_t reserved;
+	uint64_t ctr;
+	uint64_t count;
+};
+
+struct handover_node {
+	uint64_t nodeid;
+	uint64_t parent;
+	uint64_t nlookup;
+	uint32_t generation;
+	int32_t refctr;
+	uint32_t namelen;
+	uint32_t reserved;
+};
+
+struct handover_buf {
+	char *mem;
+	size_t len;
+	size_t size;
+};
+
+static int handover_put(struct handover_buf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		size_t size = b->size ? b->size : 4096;
+		char *mem;
+
+		while (size < b->len + len)
+			size *= 2;
+		mem = (char *) realloc(b->mem, size);
+		if (mem == NULL)
+			return -1;
+		b->mem = mem;
+		b->size = size;
+	}
+
+	memcpy(b->mem + b->len, data, len);
+	b->len += len;
+
+	return 0;
+}
+
+static int handover_get(const char **p, const char *end, void *data,
+			size_t len)
+{
+	if ((size_t) (end - *p) < len)
+		return -1;
+
+	memcpy(data, *p, len);
+	*p += len;
+
+	return 0;
+}
+
+/*
+ * Open file and directory handles are pointers into this process
+ * and can't be moved so the node table may only be handed over when
+ * there are none.
+ */
+int fuse_handover_busy(struct fuse *f)
+{
+	size_t i;
+	int busy;
+
+	pthread_mutex_lock(&f->lock);
+	busy = (f->opendir_count != 0);
+	for (i = 0; i < f->id_table.size && !busy; i++) {
+		struct node *node;
+
+		for (node = f->id_table.array[i]; node != NULL;
+		     node = node->id_next) {
+			if (node->open_count || node->locks || node->is_hidden) {
+				busy = 1;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&f->lock);
+
+	return busy;
+}
+
+int fuse_handover_save(struct fuse *f, char **buf, size_t *len)
+{
+	struct handover_buf b = { NULL, 0, 0 };
+	struct handover_state st;
+	struct fuse_conn_info conn;
+	size_t i;
+	int res = -1;
+
+	if (fuse_lowlevel_get_conn(f->se, &conn) == -1)
+		return -1;
+
+	memset(&st, 0, sizeof(st));
+	st.proto_major = conn.proto_major;
+	st.proto_minor = conn.proto_minor;
+	st.async_read = conn.async_read;
+	st.max_write = conn.max_write;
+	st.max_readahead = conn.max_readahead;
+	st.capable = conn.capable;
+	st.want = conn.want;
+	st.max_background = conn.max_background;
+	st.congestion_threshold = conn.congestion_threshold;
+	st.max_stack_depth = conn.max_stack_depth;
+
+	pthread_mutex_lock(&f->lock);
+	st.generation = f->generation;
+	st.ctr = f->ctr;
+	st.count = f->id_table.use;
+	if (handover_put(&b, &st, sizeof(st)) == -1)
+		goto out;
+
+	for (i = 0; i < f->id_table.size; i++) {
+		struct node *node;
+
+		for (node = f->id_table.array[i]; node != NULL;
+		     node = node->id_next) {
+			struct handover_node hn;
+
+			memset(&hn, 0, sizeof(hn));
+			hn.nodeid = node->nodeid;
+			hn.generation = node->generation;
+			hn.nlookup = node->nlookup;
+			hn.refctr = node->refctr;
+			if (node->parent) {
+				hn.parent = node->parent->nodeid;
+				hn.namelen = strlen(node->name);
+			}
+
+			if (handover_put(&b, &hn, sizeof(hn)) == -1 ||
+			    handover_put(&b, node->name, hn.namelen) == -1)
+				goto out;
+		}
+	}
+	res = 0;
+
+out:
+	pthread_mutex_unlock(&f->lock);
+	if (res == -1) {
+		free(b.mem);
+		return -1;
+	}
+
+	*buf = b.mem;
+	*len = b.len;
+
+	return 0;
+}
+
+struct handover_entry {
+	struct node *node;
+	uint64_t parent;
+	int32_t refctr;
+	char *name;
+};
+
+static int handover_restore_nodes(struct fuse *f, const char **p,
+				  const char *end, uint64_t count,
+				  struct handover_entry *ents)
+{
+	uint64_t i;
+
+	/* First make every node findable by id... */
+	for (i = 0; i < count; i++) {
+		struct handover_node hn;
+		struct node *node;
+
+		if (handover_get(p, end, &hn, sizeof(hn)) == -1 ||
+		    (size_t) (end - *p) < hn.namelen ||
+		    hn.refctr <= 0 || hn.nodeid == 0)
+			return -1;
+
+		if (hn.parent) {
+			ents[i].name = strndup(*p, hn.namelen);
+			if (ents[i].name == NULL)
+				return -1;
+		}
+		*p += hn.namelen;
+
+		if (hn.nodeid == FUSE_ROOT_ID) {
+			node = get_node(f, FUSE_ROOT_ID);
+		} else {
+			if (get_node_nocheck(f, hn.nodeid) != NULL)
+				return -1;
+			node = alloc_node(f);
+			if (node == NULL)
+				return -1;
+			node->nodeid = hn.nodeid;
+			hash_id(f, node);
+			if (lru_enabled(f)) {
+				struct node_lru *lnode = node_lru(node);
+				init_list_head(&lnode->lru);
+			}
+		}
+		node->generation = hn.generation;
+		node->nlookup = hn.nlookup;
+
+		ents[i].node = node;
+		ents[i].parent = hn.parent;
+		ents[i].refctr = hn.refctr;
+	}
+
+	/* ...then link them into the directory tree */
+	for (i = 0; i < count; i++) {
+		if (!ents[i].parent)
+			continue;
+		if (ents[i].parent == ents[i].node->nodeid ||
+		    get_node_nocheck(f, ents[i].parent) == NULL)
+			return -1;
+		if (hash_name(f, ents[i].node, ents[i].parent,
+			      ents[i].name) == -1)
+			return -1;
+	}
+
+	/* Linking bumped the parents' counts, use the original ones */
+	for (i = 0; i < count; i++) {
+		ents[i].node->refctr = ents[i].refctr;
+		if (lru_enabled(f) && ents[i].node->nlookup == 1 &&
+		    ents[i].node->nodeid != FUSE_ROOT_ID)
+			set_forget_time(f, ents[i].node);
+	}
+
+	return 0;
+}
+
+int fuse_handover_restore(struct fuse *f, const char *buf, size_t len)
+{
+	const char *p = buf;
+	const char *end = buf + len;
+	struct handover_state st;
+	struct handover_entry *ents;
+	struct fuse_conn_info conn;
+	size_t bufsize;
+	uint64_t i;
+	int res;
+
+	if (handover_get(&p, end, &st, sizeof(st)) == -1)
+		return -1;
+	if (st.count > (len / sizeof(struct handover_node)))
+		return -1;
+
+	/* The kernel keeps sending writes as large as it was told */
+	bufsize = fuse_chan_bufsize(fuse_session_next_chan(f->se, NULL));
+	if (bufsize < (size_t) st.max_write + 4096) {
+		fprintf(stderr, "fuse: handover max_write %u too large for "
+			"buffer size %zu\n", st.max_write, bufsize);
+		return -1;
+	}
+
+	ents = (struct handover_entry *) calloc(st.count + 1, sizeof(*ents));
+	if (ents == NULL)
+		return -1;
+
+	pthread_mutex_lock(&f->lock);
+	f->ctr = st.ctr;
+	f->generation = st.generation;
+	res = handover_restore_nodes(f, &p, end, st.count, ents);
+	pthread_mutex_unlock(&f->lock);
+
+	for (i = 0; i < st.count; i++)
+		free(ents[i].name);
+	free(ents);
+
+	if (res == -1)
+		return -1;
+
+	memset(&conn, 0, sizeof(conn));
+	conn.proto_major = st.proto_major;
+	conn.proto_minor = st.proto_minor;
+	conn.async_read = st.async_read;
+	conn.max_write = st.max_write;
+	conn.max_readahead = st.max_readahead;
+	conn.capable = st.capable;
+	conn.want = st.want;
+	conn.max_background = st.max_background;
+	conn.congestion_threshold = st.congestion_threshold;
+	conn.max_stack_depth = st.max_stack_depth;
+	fuse_lowlevel_resume(f->se, &conn);
+
+	return 0;
+}
+
 static struct fuse_lowlevel_ops fuse_path_ops = {
 	.init = fuse_lib_init,
 	.destroy = fuse_lib_destroy,
@@ -4081,6 +4541,8 @@ static struct fuse_lowlevel_ops fuse_path_ops = {
 	.ioctl = fuse_lib_ioctl,
 	.poll = fuse_lib_poll,
 	.fallocate = fuse_lib_fallocate,
+	.lseek = fuse_lib_lseek,
+	.copy_file_range = fuse_lib_copy_file_range,
 };
 
 int fuse_notify_poll(struct fuse_pollhandle *ph)
@@ -4614,7 +5076,7 @@ void fuse_destroy(struct fuse *f)
 					char *path;
 					if (try_get_path(f, node->nodeid, NULL, &path, NULL, false) == 0) {
 						fuse_fs_unlink(f->fs, path);
-						free(path);
+						path_free(path);
 					}
 				}
 			}
@@ -4767,3 +5229,37 @@ fuse_config_get_attr_timeout(const struct fuse *fuse_)
 {
   return fuse_->conf.attr_timeout;
 }
+
+static int
+fuse_dev_fd(const struct fuse *fuse_)
+{
+  return fuse_chan_fd(fuse_session_next_chan(fuse_->se,NULL));
+}
+
+int
+fuse_passthrough_open(struct fuse *fuse_,
+                      const int    fd_)
+{
+  int rv;
+  struct fuse_backing_map map;
+
+  memset(&map,0,sizeof(map));
+  map.fd = fd_;
+
+  rv = ioctl(fuse_dev_fd(fuse_),FUSE_DEV_IOC_BACKING_OPEN,&map);
+
+  return ((rv == -1) ? -errno : rv);
+}
+
+int
+fuse_passthrough_close(struct fuse *fuse_,
+                       const int    backing_id_)
+{
+  int rv;
+  uint32_t id;
+
+  id = backing_id_;
+  rv = ioctl(fuse_dev_fd(fuse_),FUSE_DEV_IOC_BACKING_CLOSE,&id);
+
+  return ((rv == -1) ? -errno : rv);
+}
@@ -0,0 +1,568 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/*
+ * Handover of a live connection between processes.
+ *
+ * A running filesystem listens on a unix socket. A new instance for
+ * the same mountpoint connects to it, the old one stops reading from
+ * /dev/fuse, answers whatever it already read and then passes the
+ * device fd and its node table over. The new instance resumes
+ * service with the same node ids and generations so the kernel's
+ * dentries, inodes and page cache stay valid. The old one exits
+ * without unmounting once the new one confirms.
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+#include "fuse_i.h"
+#include "fuse_lowlevel.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define HANDOVER_MAGIC   0x4d465348	/* MFSH */
+#define HANDOVER_VERSION 1
+
+/* How long to keep asking while the old instance has files open */
+#define HANDOVER_BUSY_TRIES 100
+#define HANDOVER_BUSY_WAIT  (50 * 1000)
+
+/* Seconds the listener waits on a request and each side on the other's answer */
+#define HANDOVER_REQUEST_TIMEOUT 5
+#define HANDOVER_ACK_TIMEOUT     30
+
+struct handover_msg {
+	uint32_t magic;
+	uint32_t version;
+	int32_t error;
+	uint32_t reserved;
+	uint64_t len;
+};
+
+static pthread_mutex_t handover_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct fuse *handover_fuse;
+static char *handover_path;
+static char *handover_mountpoint;
+static int handover_listenfd = -1;
+static int handover_client = -1;
+static int handover_peer = -1;
+static pthread_t handover_main;
+static pthread_t handover_thread;
+static sem_t handover_done;
+
+static int handover_set_timeout(int fd, int secs)
+{
+	struct timeval tv;
+
+	tv.tv_sec = secs;
+	tv.tv_usec = 0;
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1)
+		return -1;
+
+	return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int handover_write(int fd, const void *data, size_t len)
+{
+	const char *p = (const char *) data;
+
+	while (len) {
+		ssize_t res = send(fd, p, len, MSG_NOSIGNAL);
+		if (res == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += res;
+		len -= res;
+	}
+
+	return 0;
+}
+
+static int handover_read(int fd, void *data, size_t len)
+{
+	char *p = (char *) data;
+
+	while (len) {
+		ssize_t res = read(fd, p, len);
+		if (res == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (res == 0) {
+			errno = EPIPE;
+			return -1;
+		}
+		p += res;
+		len -= res;
+	}
+
+	return 0;
+}
+
+static int handover_send_msg(int fd, int error, uint64_t len, int passfd)
+{
+	struct handover_msg msg;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	ssize_t res;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.magic = HANDOVER_MAGIC;
+	msg.version = HANDOVER_VERSION;
+	msg.error = error;
+	msg.len = len;
+
+	if (passfd < 0)
+		return handover_write(fd, &msg, sizeof(msg));
+
+	iov.iov_base = &msg;
+	iov.iov_len = sizeof(msg);
+	memset(&mh, 0, sizeof(mh));
+	memset(cbuf, 0, sizeof(cbuf));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&mh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &passfd, sizeof(int));
+
+	do {
+		res = sendmsg(fd, &mh, MSG_NOSIGNAL);
+	} while (res == -1 && errno == EINTR);
+	if (res == -1)
+		return -1;
+
+	return handover_write(fd, (char *) &msg + res, sizeof(msg) - res);
+}
+
+static int handover_recv_msg(int fd, struct handover_msg *msg, int *passfd)
+{
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	ssize_t res;
+
+	if (passfd)
+		*passfd = -1;
+
+	iov.iov_base = msg;
+	iov.iov_len = sizeof(*msg);
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+
+	do {
+		res = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+	} while (res == -1 && errno == EINTR);
+	if (res == -1)
+		return -1;
+	if (res == 0) {
+		errno = EPIPE;
+		return -1;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+		int tmpfd;
+
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		memcpy(&tmpfd, CMSG_DATA(cmsg), sizeof(int));
+		if (passfd && *passfd == -1)
+			*passfd = tmpfd;
+		else
+			close(tmpfd);
+	}
+
+	if (handover_read(fd, (char *) msg + res, sizeof(*msg) - res) == -1 ||
+	    msg->magic != HANDOVER_MAGIC ||
+	    msg->version != HANDOVER_VERSION) {
+		if (passfd && *passfd != -1) {
+			close(*passfd);
+			*passfd = -1;
+		}
+		if (errno != EPIPE)
+			errno = EPROTO;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int handover_sockaddr(struct sockaddr_un *addr, const char *path)
+{
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		fprintf(stderr, "fuse: handover path too long: %s\n", path);
+		return -1;
+	}
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strcpy(addr->sun_path, path);
+
+	return 0;
+}
+
+static int handover_request(const struct sockaddr_un *addr,
+			    const char *mountpoint, int *sock,
+			    struct handover_msg *msg, int *chfd)
+{
+	*sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (*sock == -1) {
+		perror("fuse: handover socket");
+		return -1;
+	}
+
+	if (connect(*sock, (const struct sockaddr *) addr,
+		    sizeof(*addr)) == -1) {
+		int err = errno;
+
+		close(*sock);
+		if (err == ENOENT || err == ECONNREFUSED)
+			return 1;
+		fprintf(stderr, "fuse: handover connect to %s: %s\n",
+			addr->sun_path, strerror(err));
+		return -1;
+	}
+
+	if (handover_send_msg(*sock, 0, strlen(mountpoint), -1) == -1 ||
+	    handover_write(*sock, mountpoint, strlen(mountpoint)) == -1 ||
+	    handover_recv_msg(*sock, msg, chfd) == -1) {
+		fprintf(stderr, "fuse: handover from %s: %s\n",
+			addr->sun_path, strerror(errno));
+		close(*sock);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Take over the connection of a running instance. Returns 0 and the
+ * device fd plus serialized state when taken over, 1 if there is no
+ * instance to take over from and -1 on error or if it refused. While
+ * files are open the request is retried for a little while.
+ */
+int fuse_handover_receive(const char *path, const char *mountpoint,
+			  int *fd, char **buf, size_t *len)
+{
+	struct sockaddr_un addr;
+	struct handover_msg msg;
+	char *state;
+	int tries;
+	int sock;
+	int chfd;
+	int res;
+
+	if (handover_sockaddr(&addr, path) == -1)
+		return -1;
+
+	for (tries = 0; ; tries++) {
+		res = handover_request(&addr, mountpoint, &sock, &msg, &chfd);
+		if (res != 0)
+			return res;
+		if (msg.error != EBUSY || tries == HANDOVER_BUSY_TRIES)
+			break;
+		close(sock);
+		usleep(HANDOVER_BUSY_WAIT);
+	}
+
+	if (msg.error || chfd == -1) {
+		fprintf(stderr, "fuse: handover refused by %s: %s\n",
+			path, strerror(msg.error ? msg.error : EPROTO));
+		if (chfd != -1)
+			close(chfd);
+		close(sock);
+		return -1;
+	}
+
+	state = (char *) malloc(msg.len ? msg.len : 1);
+	if (state == NULL || handover_read(sock, state, msg.len) == -1) {
+		fprintf(stderr, "fuse: handover state from %s: %s\n",
+			path, strerror(state ? errno : ENOMEM));
+		free(state);
+		close(chfd);
+		close(sock);
+		return -1;
+	}
+
+	handover_peer = sock;
+	*fd = chfd;
+	*buf = state;
+	*len = msg.len;
+
+	return 0;
+}
+
+/*
+ * Tell the previous instance whether the connection was taken over.
+ * Until then it keeps its own copy of the device open and resumes
+ * service if the answer is no or doesn't come in time. When taking
+ * over it answers whether it stood down or had already resumed so
+ * the device is never served by both. If it is gone altogether the
+ * device is ours.
+ */
+int fuse_handover_complete(int ok)
+{
+	struct handover_msg reply;
+	int res;
+
+	if (handover_peer == -1)
+		return 0;
+
+	res = handover_send_msg(handover_peer, ok ? 0 : ECANCELED, 0, -1);
+	if (ok) {
+		handover_set_timeout(handover_peer, HANDOVER_ACK_TIMEOUT);
+		if (handover_recv_msg(handover_peer, &reply, NULL) == 0) {
+			errno = reply.error;
+			res = (reply.error ? -1 : 0);
+		} else {
+			res = ((errno == EPIPE || errno == ECONNRESET) ? 0 : -1);
+		}
+	}
+	close(handover_peer);
+	handover_peer = -1;
+
+	return res;
+}
+
+static int handover_check_request(int fd)
+{
+	struct handover_msg msg;
+	struct ucred cred;
+	socklen_t credlen = sizeof(cred);
+	char mountpoint[PATH_MAX];
+
+	/* Only one request is looked at at a time so don't wait forever */
+	if (handover_set_timeout(fd, HANDOVER_REQUEST_TIMEOUT) == -1)
+		return errno;
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) == -1)
+		return errno;
+	if (cred.uid != 0 && cred.uid != geteuid())
+		return EPERM;
+
+	if (handover_recv_msg(fd, &msg, NULL) == -1)
+		return errno;
+	if (msg.len >= sizeof(mountpoint))
+		return ENAMETOOLONG;
+	if (handover_read(fd, mountpoint, msg.len) == -1)
+		return errno;
+	mountpoint[msg.len] = '\0';
+
+	if (strcmp(mountpoint, handover_mountpoint) != 0)
+		return EXDEV;
+
+	return 0;
+}
+
+static void *handover_listener(void *data)
+{
+	(void) data;
+
+	for (;;) {
+		int fd;
+		int err;
+
+		fd = accept4(handover_listenfd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			perror("fuse: handover accept");
+			break;
+		}
+
+		err = handover_check_request(fd);
+		if (!err && fuse_handover_busy(handover_fuse))
+			err = EBUSY;
+		if (err) {
+			handover_send_msg(fd, err, 0, -1);
+			close(fd);
+			continue;
+		}
+
+		pthread_mutex_lock(&handover_lock);
+		handover_client = fd;
+		pthread_mutex_unlock(&handover_lock);
+
+		/* Stop the loop. The signal only wakes the main thread. */
+		fuse_exit(handover_fuse);
+		pthread_kill(handover_main, SIGHUP);
+
+		while (sem_wait(&handover_done) == -1 && errno == EINTR)
+			;
+	}
+
+	return NULL;
+}
+
+int fuse_handover_listen(struct fuse *f, const char *path,
+			 const char *mountpoint)
+{
+	struct sockaddr_un addr;
+	mode_t umask_prev;
+	int res;
+
+	if (handover_sockaddr(&addr, path) == -1)
+		return -1;
+
+	handover_listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (handover_listenfd == -1) {
+		perror("fuse: handover socket");
+		return -1;
+	}
+
+	/* Whatever is at the path is stale or the instance we replaced */
+	unlink(path);
+	umask_prev = umask(0077);
+	res = bind(handover_listenfd, (struct sockaddr *) &addr,
+		   sizeof(addr));
+	umask(umask_prev);
+	if (res == -1 || listen(handover_listenfd, 1) == -1) {
+		fprintf(stderr, "fuse: handover listen on %s: %s\n",
+			path, strerror(errno));
+		goto out_close;
+	}
+
+	handover_fuse = f;
+	handover_main = pthread_self();
+	handover_path = strdup(path);
+	handover_mountpoint = strdup(mountpoint);
+	if (handover_path == NULL || handover_mountpoint == NULL)
+		goto out_unlink;
+
+	sem_init(&handover_done, 0, 0);
+	if (fuse_start_thread(&handover_thread, handover_listener, NULL) == -1) {
+		sem_destroy(&handover_done);
+		goto out_unlink;
+	}
+
+	return 0;
+
+out_unlink:
+	unlink(path);
+	free(handover_path);
+	free(handover_mountpoint);
+	handover_path = NULL;
+	handover_mountpoint = NULL;
+out_close:
+	close(handover_listenfd);
+	handover_listenfd = -1;
+	return -1;
+}
+
+int fuse_handover_pending(void)
+{
+	int pending;
+
+	pthread_mutex_lock(&handover_lock);
+	pending = (handover_client != -1);
+	pthread_mutex_unlock(&handover_lock);
+
+	return pending;
+}
+
+/*
+ * Called once the loop has stopped. Returns 0 if the new instance
+ * took over and this one should exit without unmounting.
+ */
+int fuse_handover_send(struct fuse *f)
+{
+	struct fuse_chan *ch = fuse_session_next_chan(fuse_get_session(f),
+						      NULL);
+	struct handover_msg ack;
+	char *buf = NULL;
+	size_t len = 0;
+	int err;
+	int fd;
+	int res = -1;
+
+	pthread_mutex_lock(&handover_lock);
+	fd = handover_client;
+	handover_client = -1;
+	pthread_mutex_unlock(&handover_lock);
+
+	if (fuse_handover_busy(f))
+		err = EBUSY;
+	else if (fuse_handover_save(f, &buf, &len) == -1)
+		err = EAGAIN;
+	else
+		err = 0;
+
+	handover_set_timeout(fd, HANDOVER_ACK_TIMEOUT);
+	if (handover_send_msg(fd, err, len, err ? -1 : fuse_chan_fd(ch)) == 0 &&
+	    !err &&
+	    handover_write(fd, buf, len) == 0 &&
+	    handover_recv_msg(fd, &ack, NULL) == 0 &&
+	    ack.error == 0)
+		res = 0;
+
+	/* Whether it stood down or timed out and resumes, let it know */
+	if (!err)
+		handover_send_msg(fd, res ? ETIMEDOUT : 0, 0, -1);
+
+	free(buf);
+	close(fd);
+	sem_post(&handover_done);
+
+	return res;
+}
+
+void fuse_handover_close(int unlink_path)
+{
+	if (handover_listenfd == -1)
+		return;
+
+	pthread_cancel(handover_thread);
+	pthread_join(handover_thread, NULL);
+	sem_destroy(&handover_done);
+	close(handover_listenfd);
+	handover_listenfd = -1;
+
+	if (unlink_path)
+		unlink(handover_path);
+	free(handover_path);
+	free(handover_mountpoint);
+	handover_path = NULL;
+	handover_mountpoint = NULL;
+}
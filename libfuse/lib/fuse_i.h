@@ -110,6 +110,7 @@ int fuse_chan_clearfd(struct fuse_chan *ch);
 
 void fuse_kern_unmount(const char *mountpoint, int fd);
 int fuse_kern_mount(const char *mountpoint, struct fuse_args *args);
+int fuse_kern_mount_opts(struct fuse_args *args);
 
 int fuse_send_reply_iov_nofree(fuse_req_t req, int error, struct iovec *iov,
 			       int count);
@@ -127,4 +128,25 @@ struct fuse *fuse_setup_common(int argc, char *argv[],
 
 void cuse_lowlevel_init(fuse_req_t req, fuse_ino_t nodeide, const void *inarg);
 
+int fuse_lowlevel_get_conn(struct fuse_session *se,
+			   struct fuse_conn_info *conn);
+void fuse_lowlevel_resume(struct fuse_session *se,
+			  const struct fuse_conn_info *conn);
+
+int fuse_handover_busy(struct fuse *f);
+int fuse_handover_save(struct fuse *f, char **buf, size_t *len);
+int fuse_handover_restore(struct fuse *f, const char *buf, size_t len);
+
+int fuse_handover_receive(const char *path, const char *mountpoint,
+			  int *fd, char **buf, size_t *len);
+int fuse_handover_complete(int ok);
+int fuse_handover_listen(struct fuse *f, const char *path,
+			 const char *mountpoint);
+int fuse_handover_pending(void);
+int fuse_handover_send(struct fuse *f);
+void fuse_handover_close(int unlink_path);
+
+void *fuse_pool_alloc(enum fuse_pool_type type, size_t size);
+void fuse_pool_free(enum fuse_pool_type type, void *ptr);
+
 int fuse_start_thread(pthread_t *thread_id, void *(*func)(void *), void *arg);
@@ -28,7 +28,10 @@ restart:
 	res = read(fuse_chan_fd(ch), buf, size);
 	err = errno;
 
-	if (fuse_session_exited(se))
+	/* A request which was already read must still be answered even
+	   when exiting as the device may be handed over to another
+	   process which knows nothing about it */
+	if (res == -1 && fuse_session_exited(se))
 		return 0;
 	if (res == -1) {
 		/* ENOENT means the operation was interrupted, it's safe
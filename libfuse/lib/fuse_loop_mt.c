@@ -87,10 +87,10 @@ static void *fuse_do_work(void *data)
 			break;
 		}
 
+		fuse_session_process_buf(mt->se, &fbuf, ch);
+
 		if (mt->exit)
 			return NULL;
-
-		fuse_session_process_buf(mt->se, &fbuf, ch);
 	}
 
 	sem_post(&mt->finish);
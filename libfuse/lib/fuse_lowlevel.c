@@ -121,7 +121,7 @@ static void list_add_req(struct fuse_req *req, struct fuse_req *next)
 static void destroy_req(fuse_req_t req)
 {
 	pthread_mutex_destroy(&req->lock);
-	free(req);
+	fuse_pool_free(FUSE_POOL_REQ, req);
 }
 
 void fuse_free_req(fuse_req_t req)
@@ -143,10 +143,12 @@ static struct fuse_req *fuse_ll_alloc_req(struct fuse_ll *f)
 {
 	struct fuse_req *req;
 
-	req = (struct fuse_req *) calloc(1, sizeof(struct fuse_req));
+	req = (struct fuse_req *) fuse_pool_alloc(FUSE_POOL_REQ,
+						  sizeof(struct fuse_req));
 	if (req == NULL) {
 		fprintf(stderr, "fuse: failed to allocate request\n");
 	} else {
+		memset(req, 0, sizeof(struct fuse_req));
 		req->f = f;
 		req->ctr = 1;
 		list_init_req(req);
@@ -352,6 +354,10 @@ static void fill_open(struct fuse_open_out *arg,
 		arg->open_flags |= FOPEN_KEEP_CACHE;
 	if (f->nonseekable)
 		arg->open_flags |= FOPEN_NONSEEKABLE;
+	if (f->backing_id > 0) {
+		arg->open_flags |= FOPEN_PASSTHROUGH;
+		arg->backing_id = f->backing_id;
+	}
 }
 
 int fuse_reply_entry(fuse_req_t req, const struct fuse_entry_param *e)
@@ -976,6 +982,16 @@ int fuse_reply_poll(fuse_req_t req, unsigned revents)
 	return send_reply_ok(req, &arg, sizeof(arg));
 }
 
+int fuse_reply_lseek(fuse_req_t req, off_t off)
+{
+	struct fuse_lseek_out arg;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.offset = off;
+
+	return send_reply_ok(req, &arg, sizeof(arg));
+}
+
 static void do_lookup(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
 {
 	char *name = (char *) inarg;
@@ -1738,6 +1754,48 @@ static void do_fallocate(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
 		fuse_reply_err(req, ENOSYS);
 }
 
+static void do_copy_file_range(fuse_req_t req, fuse_ino_t nodeid_in,
+			       const void *inarg)
+{
+	struct fuse_copy_file_range_in *arg =
+		(struct fuse_copy_file_range_in *) inarg;
+	struct fuse_file_info fi_in, fi_out;
+	size_t len;
+
+	memset(&fi_in, 0, sizeof(fi_in));
+	fi_in.fh = arg->fh_in;
+
+	memset(&fi_out, 0, sizeof(fi_out));
+	fi_out.fh = arg->fh_out;
+
+	/* the reply's size is 32 bits so keep the count representable */
+	len = arg->len;
+	if (len > (UINT32_MAX & ~(size_t) 4095))
+		len = (UINT32_MAX & ~(size_t) 4095);
+
+	if (req->f->op.copy_file_range)
+		req->f->op.copy_file_range(req, nodeid_in, arg->off_in,
+					   &fi_in, arg->nodeid_out,
+					   arg->off_out, &fi_out, len,
+					   arg->flags);
+	else
+		fuse_reply_err(req, ENOSYS);
+}
+
+static void do_lseek(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
+{
+	struct fuse_lseek_in *arg = (struct fuse_lseek_in *) inarg;
+	struct fuse_file_info fi;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.fh = arg->fh;
+
+	if (req->f->op.lseek)
+		req->f->op.lseek(req, nodeid, arg->offset, arg->whence, &fi);
+	else
+		fuse_reply_err(req, ENOSYS);
+}
+
 static void do_init(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
 {
 	struct fuse_init_in *arg = (struct fuse_init_in *) inarg;
@@ -1816,6 +1874,9 @@ static void do_init(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
 	}
 	if (req->f->conn.proto_minor >= 18)
 		f->conn.capable |= FUSE_CAP_IOCTL_DIR;
+	if ((arg->flags & FUSE_INIT_EXT) &&
+	    (arg->flags2 & (FUSE_PASSTHROUGH >> 32)))
+		f->conn.capable |= FUSE_CAP_PASSTHROUGH;
 
 	if (f->atomic_o_trunc)
 		f->conn.want |= FUSE_CAP_ATOMIC_O_TRUNC;
@@ -1861,6 +1922,14 @@ static void do_init(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
 		outarg.flags |= FUSE_DONT_MASK;
 	if (f->conn.want & FUSE_CAP_FLOCK_LOCKS)
 		outarg.flags |= FUSE_FLOCK_LOCKS;
+	if ((f->conn.want & FUSE_CAP_PASSTHROUGH) &&
+	    (f->conn.capable & FUSE_CAP_PASSTHROUGH)) {
+		if (!f->conn.max_stack_depth)
+			f->conn.max_stack_depth = 1;
+		outarg.flags |= FUSE_INIT_EXT;
+		outarg.flags2 |= (FUSE_PASSTHROUGH >> 32);
+		outarg.max_stack_depth = f->conn.max_stack_depth;
+	}
 	outarg.max_readahead = f->conn.max_readahead;
 	outarg.max_write = f->conn.max_write;
 	if (f->conn.proto_minor >= 13) {
@@ -1880,6 +1949,7 @@ static void do_init(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
 	if (f->debug) {
 		fprintf(stderr, "   INIT: %u.%u\n", outarg.major, outarg.minor);
 		fprintf(stderr, "   flags=0x%08x\n", outarg.flags);
+		fprintf(stderr, "   flags2=0x%08x\n", outarg.flags2);
 		fprintf(stderr, "   max_readahead=0x%08x\n",
 			outarg.max_readahead);
 		fprintf(stderr, "   max_write=0x%08x\n", outarg.max_write);
@@ -1906,6 +1976,38 @@ static void do_destroy(fuse_req_t req, fuse_ino_t nodeid, const void *inarg)
 	send_reply_ok(req, NULL, 0);
 }
 
+int fuse_lowlevel_get_conn(struct fuse_session *se,
+			   struct fuse_conn_info *conn)
+{
+	struct fuse_ll *f = (struct fuse_ll *) fuse_session_data(se);
+
+	if (!f->got_init || f->got_destroy)
+		return -1;
+
+	*conn = f->conn;
+
+	return 0;
+}
+
+/*
+ * Resume a connection which was initialized by another process. The
+ * kernel won't send INIT again so the negotiated parameters are taken
+ * as is and the filesystem's init is called to set up its own state.
+ */
+void fuse_lowlevel_resume(struct fuse_session *se,
+			  const struct fuse_conn_info *conn)
+{
+	struct fuse_ll *f = (struct fuse_ll *) fuse_session_data(se);
+
+	f->conn = *conn;
+	f->got_init = 1;
+	if (f->op.init)
+		f->op.init(f->userdata, &f->conn);
+
+	/* Nothing can be renegotiated so keep what the kernel agreed to */
+	f->conn = *conn;
+}
+
 static void list_del_nreq(struct fuse_notify_req *nreq)
 {
 	struct fuse_notify_req *prev = nreq->prev;
@@ -2291,6 +2393,8 @@ static struct {
 	[FUSE_POLL]	   = { do_poll,        "POLL"	     },
 	[FUSE_FALLOCATE]   = { do_fallocate,   "FALLOCATE"   },
 	[FUSE_DESTROY]	   = { do_destroy,     "DESTROY"     },
+	[FUSE_LSEEK]	   = { do_lseek,       "LSEEK"	     },
+	[FUSE_COPY_FILE_RANGE] = { do_copy_file_range, "COPY_FILE_RANGE" },
 	[FUSE_NOTIFY_REPLY] = { (void *) 1,    "NOTIFY_REPLY" },
 	[FUSE_BATCH_FORGET] = { do_batch_forget, "BATCH_FORGET" },
 	[CUSE_INIT]	   = { cuse_lowlevel_init, "CUSE_INIT"   },
@@ -2617,7 +2721,7 @@ static int fuse_ll_receive_buf(struct fuse_session *se, struct fuse_buf *buf,
 	res = splice(fuse_chan_fd(ch), NULL, llp->pipe[1], NULL, bufsize, 0);
 	err = errno;
 
-	if (fuse_session_exited(se))
+	if (res == -1 && fuse_session_exited(se))
 		return 0;
 
 	if (res == -1) {
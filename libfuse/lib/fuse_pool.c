@@ -0,0 +1,273 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+/*
+ * Free-list pools for objects which are allocated and released once
+ * per request.
+ *
+ * Each thread keeps a short list per pool which it can use without
+ * locking. When that list grows too long half of it is moved to a
+ * shared list and a thread with an empty list refills from the
+ * shared one before falling back to malloc. Objects released by a
+ * different thread than the one which allocated them, as happens
+ * with interrupted requests, simply join the releasing thread's
+ * list. A thread's list is handed back to the shared one when it
+ * exits.
+ *
+ * Occupancy is counted per thread as well and only summed when the
+ * stats are read. Objects are allocated and freed by different
+ * threads so a single thread's counts can go negative. What's cached
+ * is what was allocated minus what's in use.
+ */
+
+#include "config.h"
+#include "fuse_i.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_THREAD_MAX 64
+#define POOL_SHARED_MAX 1024
+
+struct pool_obj {
+	struct pool_obj *next;
+};
+
+struct pool_list {
+	struct pool_obj *head;
+	unsigned count;
+};
+
+struct pool_counts {
+	int64_t allocated;
+	int64_t inuse;
+};
+
+struct pool {
+	pthread_mutex_t lock;
+	struct pool_list shared;
+	/* shared.count, readable without the lock as a hint */
+	unsigned available;
+	/* counts of threads which have exited */
+	struct pool_counts retired;
+};
+
+struct pool_thread {
+	struct pool_list lists[FUSE_POOL_MAX];
+	struct pool_counts counts[FUSE_POOL_MAX];
+	struct pool_thread *prev;
+	struct pool_thread *next;
+	int registered;
+};
+
+static struct pool pools[FUSE_POOL_MAX] = {
+	[FUSE_POOL_REQ]  = { .lock = PTHREAD_MUTEX_INITIALIZER },
+	[FUSE_POOL_DH]   = { .lock = PTHREAD_MUTEX_INITIALIZER },
+	[FUSE_POOL_PATH] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+static __thread struct pool_thread pool_local;
+static struct pool_thread *pool_threads;
+static pthread_mutex_t pool_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* Only the owning thread writes its counts. Readers may be others. */
+static void pool_count(int64_t *counter, int64_t n)
+{
+	__atomic_store_n(counter,
+			 __atomic_load_n(counter, __ATOMIC_RELAXED) + n,
+			 __ATOMIC_RELAXED);
+}
+
+static struct pool_obj *pool_pop(struct pool_list *list)
+{
+	struct pool_obj *obj;
+
+	obj = list->head;
+	list->head = obj->next;
+	list->count--;
+
+	return obj;
+}
+
+static void pool_push(struct pool_list *list, struct pool_obj *obj)
+{
+	obj->next = list->head;
+	list->head = obj;
+	list->count++;
+}
+
+/* Moves up to `count` objects to the shared list. Frees the rest
+   once that is full. */
+static void pool_drain(struct pool *p, struct pool_list *local,
+		       struct pool_counts *counts, unsigned count)
+{
+	struct pool_obj *obj;
+
+	pthread_mutex_lock(&p->lock);
+	while (count-- && local->head) {
+		obj = pool_pop(local);
+		if (p->shared.count < POOL_SHARED_MAX) {
+			pool_push(&p->shared, obj);
+			continue;
+		}
+
+		free(obj);
+		pool_count(&counts->allocated, -1);
+	}
+	__atomic_store_n(&p->available, p->shared.count, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void pool_refill(struct pool *p, struct pool_list *local)
+{
+	pthread_mutex_lock(&p->lock);
+	while (p->shared.head && local->count < (POOL_THREAD_MAX / 2))
+		pool_push(local, pool_pop(&p->shared));
+	__atomic_store_n(&p->available, p->shared.count, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void pool_thread_exit(void *data)
+{
+	int i;
+	struct pool_thread *t = (struct pool_thread *) data;
+
+	for (i = 0; i < FUSE_POOL_MAX; i++)
+		pool_drain(&pools[i], &t->lists[i], &t->counts[i],
+			   t->lists[i].count);
+
+	pthread_mutex_lock(&pool_threads_lock);
+	for (i = 0; i < FUSE_POOL_MAX; i++) {
+		pools[i].retired.allocated += t->counts[i].allocated;
+		pools[i].retired.inuse += t->counts[i].inuse;
+	}
+	if (t->prev)
+		t->prev->next = t->next;
+	else
+		pool_threads = t->next;
+	if (t->next)
+		t->next->prev = t->prev;
+	memset(t->counts, 0, sizeof(t->counts));
+	t->registered = 0;
+	pthread_mutex_unlock(&pool_threads_lock);
+}
+
+static void pool_init(void)
+{
+	pthread_key_create(&pool_key, pool_thread_exit);
+}
+
+static void pool_register(struct pool_thread *t)
+{
+	pthread_once(&pool_once, pool_init);
+	pthread_setspecific(pool_key, t);
+
+	pthread_mutex_lock(&pool_threads_lock);
+	t->prev = NULL;
+	t->next = pool_threads;
+	if (t->next)
+		t->next->prev = t;
+	pool_threads = t;
+	pthread_mutex_unlock(&pool_threads_lock);
+
+	t->registered = 1;
+}
+
+void *fuse_pool_alloc(enum fuse_pool_type type, size_t size)
+{
+	struct pool *p = &pools[type];
+	struct pool_thread *t = &pool_local;
+	struct pool_list *local = &t->lists[type];
+	struct pool_obj *obj;
+
+	if (!t->registered)
+		pool_register(t);
+
+	if (local->head == NULL &&
+	    __atomic_load_n(&p->available, __ATOMIC_RELAXED))
+		pool_refill(p, local);
+
+	if (local->head != NULL) {
+		obj = pool_pop(local);
+	} else {
+		if (size < sizeof(struct pool_obj))
+			size = sizeof(struct pool_obj);
+		obj = malloc(size);
+		if (obj == NULL)
+			return NULL;
+		pool_count(&t->counts[type].allocated, 1);
+	}
+
+	pool_count(&t->counts[type].inuse, 1);
+
+	return obj;
+}
+
+void fuse_pool_free(enum fuse_pool_type type, void *ptr)
+{
+	struct pool *p = &pools[type];
+	struct pool_thread *t = &pool_local;
+	struct pool_list *local = &t->lists[type];
+
+	if (ptr == NULL)
+		return;
+
+	if (!t->registered)
+		pool_register(t);
+	if (local->count >= POOL_THREAD_MAX)
+		pool_drain(p, local, &t->counts[type], POOL_THREAD_MAX / 2);
+
+	pool_push(local, (struct pool_obj *) ptr);
+	pool_count(&t->counts[type].inuse, -1);
+}
+
+void fuse_pool_get_stats(const enum fuse_pool_type type_,
+			 struct fuse_pool_stats *stats_)
+{
+	struct pool *p = &pools[type_];
+	struct pool_thread *t;
+	int64_t allocated;
+	int64_t inuse;
+
+	pthread_mutex_lock(&pool_threads_lock);
+	allocated = p->retired.allocated;
+	inuse = p->retired.inuse;
+	for (t = pool_threads; t != NULL; t = t->next) {
+		allocated += __atomic_load_n(&t->counts[type_].allocated,
+					     __ATOMIC_RELAXED);
+		inuse += __atomic_load_n(&t->counts[type_].inuse,
+					 __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&pool_threads_lock);
+
+	/* Counts are read one thread at a time so may be a little off */
+	if (allocated < 0)
+		allocated = 0;
+	if (inuse < 0)
+		inuse = 0;
+	if (inuse > allocated)
+		inuse = allocated;
+
+	stats_->allocated = allocated;
+	stats_->inuse = inuse;
+	stats_->cached = allocated - inuse;
+}
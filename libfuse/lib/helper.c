@@ -33,6 +33,7 @@ struct helper_opts {
 	int foreground;
 	int nodefault_subtype;
 	char *mountpoint;
+	char *handover;
 };
 
 #define FUSE_HELPER_OPT(t, p) { t, offsetof(struct helper_opts, p), 1 }
@@ -44,6 +45,7 @@ static const struct fuse_opt fuse_helper_opts[] = {
 	FUSE_HELPER_OPT("-s",		singlethread),
 	FUSE_HELPER_OPT("fsname=",	nodefault_subtype),
 	FUSE_HELPER_OPT("subtype=",	nodefault_subtype),
+	FUSE_HELPER_OPT("handover=%s",	handover),
 
 	FUSE_OPT_KEY("-h",		KEY_HELP),
 	FUSE_OPT_KEY("--help",		KEY_HELP),
@@ -76,6 +78,8 @@ static void helper_help(void)
 		"    -d   -o debug          enable debug output (implies -f)\n"
 		"    -f                     foreground operation\n"
 		"    -s                     disable multi-threaded operation\n"
+		"    -o handover=PATH       take over from / hand over to another\n"
+		"                           instance via unix socket PATH\n"
 		"\n"
 		);
 }
@@ -144,8 +148,9 @@ static int add_default_subtype(const char *progname, struct fuse_args *args)
 	return res;
 }
 
-int fuse_parse_cmdline(struct fuse_args *args, char **mountpoint,
-		       int *multithreaded, int *foreground)
+static int fuse_parse_cmdline_common(struct fuse_args *args,
+				     char **mountpoint, int *multithreaded,
+				     int *foreground, char **handover)
 {
 	int res;
 	struct helper_opts hopts;
@@ -170,13 +175,25 @@ int fuse_parse_cmdline(struct fuse_args *args, char **mountpoint,
 		*multithreaded = !hopts.singlethread;
 	if (foreground)
 		*foreground = hopts.foreground;
+	if (handover)
+		*handover = hopts.handover;
+	else
+		free(hopts.handover);
 	return 0;
 
 err:
 	free(hopts.mountpoint);
+	free(hopts.handover);
 	return -1;
 }
 
+int fuse_parse_cmdline(struct fuse_args *args, char **mountpoint,
+		       int *multithreaded, int *foreground)
+{
+	return fuse_parse_cmdline_common(args, mountpoint, multithreaded,
+					 foreground, NULL);
+}
+
 int fuse_daemonize(int foreground)
 {
 	if (!foreground) {
@@ -276,26 +293,61 @@ void fuse_unmount(const char *mountpoint, struct fuse_chan *ch)
 	fuse_unmount_common(mountpoint, ch);
 }
 
-struct fuse *fuse_setup_common(int argc, char *argv[],
-			       const struct fuse_operations *op,
-			       size_t op_size,
-			       char **mountpoint,
-			       int *multithreaded,
-			       int *fd,
-			       void *user_data,
-			       int compat)
+/*
+ * With handover=PATH set first try to take over the connection of an
+ * instance already serving the mountpoint and only mount if there
+ * is none.
+ */
+static struct fuse *fuse_setup_handover(int argc, char *argv[],
+					const struct fuse_operations *op,
+					size_t op_size,
+					char **mountpoint,
+					int *multithreaded,
+					int *fd,
+					void *user_data,
+					int compat,
+					char **handover)
 {
 	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
-	struct fuse_chan *ch;
-	struct fuse *fuse;
+	struct fuse_chan *ch = NULL;
+	struct fuse *fuse = NULL;
+	char *hopath = NULL;
+	char *state = NULL;
+	size_t statelen = 0;
+	int resumed = 0;
 	int foreground;
+	int chfd;
 	int res;
 
-	res = fuse_parse_cmdline(&args, mountpoint, multithreaded, &foreground);
+	res = fuse_parse_cmdline_common(&args, mountpoint, multithreaded,
+					&foreground, &hopath);
 	if (res == -1)
 		return NULL;
 
-	ch = fuse_mount_common(*mountpoint, &args);
+	if (hopath) {
+		res = fuse_handover_receive(hopath, *mountpoint, &chfd,
+					    &state, &statelen);
+		if (res == -1) {
+			fuse_opt_free_args(&args);
+			goto err_free;
+		}
+		if (res == 0) {
+			resumed = 1;
+			ch = fuse_kern_chan_new(chfd);
+			if (!ch || fuse_kern_mount_opts(&args) == -1) {
+				if (ch)
+					fuse_chan_destroy(ch);
+				else
+					close(chfd);
+				fuse_handover_complete(0);
+				fuse_opt_free_args(&args);
+				goto err_free;
+			}
+		}
+	}
+
+	if (!ch)
+		ch = fuse_mount_common(*mountpoint, &args);
 	if (!ch) {
 		fuse_opt_free_args(&args);
 		goto err_free;
@@ -306,6 +358,16 @@ struct fuse *fuse_setup_common(int argc, char *argv[],
 	if (fuse == NULL)
 		goto err_unmount;
 
+	if (state) {
+		res = fuse_handover_restore(fuse, state, statelen);
+		free(state);
+		state = NULL;
+		if (res == -1) {
+			fprintf(stderr, "fuse: invalid handover state\n");
+			goto err_unmount;
+		}
+	}
+
 	res = fuse_daemonize(foreground);
 	if (res == -1)
 		goto err_unmount;
@@ -314,20 +376,56 @@ struct fuse *fuse_setup_common(int argc, char *argv[],
 	if (res == -1)
 		goto err_unmount;
 
+	/*
+	 * If the confirmation can't be delivered the previous instance
+	 * gave up waiting and is serving the device again.
+	 */
+	if (resumed && fuse_handover_complete(1) == -1) {
+		fprintf(stderr, "fuse: handover not confirmed: %s\n",
+			strerror(errno));
+		goto err_unmount;
+	}
+
 	if (fd)
 		*fd = fuse_chan_fd(ch);
+	if (handover)
+		*handover = hopath;
+	else
+		free(hopath);
 
 	return fuse;
 
 err_unmount:
-	fuse_unmount_common(*mountpoint, ch);
+	if (resumed) {
+		/* Not ours to unmount. The previous instance resumes. */
+		fuse_handover_complete(0);
+		if (fuse == NULL)
+			fuse_chan_destroy(ch);
+	} else {
+		fuse_unmount_common(*mountpoint, ch);
+	}
 	if (fuse)
 		fuse_destroy(fuse);
 err_free:
+	free(state);
+	free(hopath);
 	free(*mountpoint);
 	return NULL;
 }
 
+struct fuse *fuse_setup_common(int argc, char *argv[],
+			       const struct fuse_operations *op,
+			       size_t op_size,
+			       char **mountpoint,
+			       int *multithreaded,
+			       int *fd,
+			       void *user_data,
+			       int compat)
+{
+	return fuse_setup_handover(argc, argv, op, op_size, mountpoint,
+				   multithreaded, fd, user_data, compat, NULL);
+}
+
 struct fuse *fuse_setup(int argc, char *argv[],
 			const struct fuse_operations *op, size_t op_size,
 			char **mountpoint, int *multithreaded, void *user_data)
@@ -357,19 +455,40 @@ static int fuse_main_common(int argc, char *argv[],
 {
 	struct fuse *fuse;
 	char *mountpoint;
+	char *handover = NULL;
 	int multithreaded;
 	int res;
 
-	fuse = fuse_setup_common(argc, argv, op, op_size, &mountpoint,
-				 &multithreaded, NULL, user_data, compat);
+	fuse = fuse_setup_handover(argc, argv, op, op_size, &mountpoint,
+				   &multithreaded, NULL, user_data, compat,
+				   &handover);
 	if (fuse == NULL)
 		return 1;
 
-	if (multithreaded)
-		res = fuse_loop_mt(fuse);
-	else
-		res = fuse_loop(fuse);
+	if (handover) {
+		fuse_handover_listen(fuse, handover, mountpoint);
+		free(handover);
+	}
+
+	for (;;) {
+		if (multithreaded)
+			res = fuse_loop_mt(fuse);
+		else
+			res = fuse_loop(fuse);
+
+		if (!fuse_handover_pending())
+			break;
+
+		/* The new instance owns the mount now, just go away */
+		if (fuse_handover_send(fuse) == 0) {
+			fuse_handover_close(0);
+			fuse_remove_signal_handlers(fuse_get_session(fuse));
+			free(mountpoint);
+			return 0;
+		}
+	}
 
+	fuse_handover_close(1);
 	fuse_teardown_common(fuse, mountpoint);
 	if (res == -1)
 		return 1;
@@ -575,6 +575,28 @@ static int get_mnt_flag_opts(char **mnt_optsp, int flags)
 	return 0;
 }
 
+/*
+ * Consume the mount options without mounting. Used when taking over
+ * an existing mount so they don't reach the library as unknown.
+ */
+int fuse_kern_mount_opts(struct fuse_args *args)
+{
+	struct mount_opts mo;
+	int res;
+
+	memset(&mo, 0, sizeof(mo));
+	res = fuse_opt_parse(args, &mo, fuse_mount_opts, fuse_mount_opt_proc);
+
+	free(mo.fsname);
+	free(mo.subtype);
+	free(mo.fusermount_opts);
+	free(mo.subtype_opt);
+	free(mo.kernel_opts);
+	free(mo.mtab_opts);
+
+	return res;
+}
+
 int fuse_kern_mount(const char *mountpoint, struct fuse_args *args)
 {
 	struct mount_opts mo;
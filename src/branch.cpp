@@ -18,9 +18,13 @@
 
 #include "branch.hpp"
 #include "fs.hpp"
+#include "fs_base_close.hpp"
+#include "fs_base_open.hpp"
 #include "fs_glob.hpp"
+#include "rcu.hpp"
 #include "str.hpp"
 
+#include <fcntl.h>
 #include <fnmatch.h>
 
 #include <string>
@@ -47,6 +51,29 @@ Branch::ro_or_nc(void) const
           (mode == Branch::NC));
 }
 
+/*
+  Branches are looked up by address first since the paths handed out
+  by policies point directly into the branch list. The string compare
+  covers copies such as those stored in the open policy cache.
+*/
+const Branch *
+Branches::find(const string &path_) const
+{
+  for(size_t i = 0, ei = size(); i != ei; i++)
+    {
+      if(&(*this)[i].path == &path_)
+        return &(*this)[i];
+    }
+
+  for(size_t i = 0, ei = size(); i != ei; i++)
+    {
+      if((*this)[i].path == path_)
+        return &(*this)[i];
+    }
+
+  return NULL;
+}
+
 string
 Branches::to_string(const bool mode_) const
 {
@@ -96,6 +123,23 @@ Branches::to_paths(vector<string> &vec_) const
     }
 }
 
+/*
+  With branch_fds an O_PATH descriptor to the root of each branch lets
+  the *at() family of calls resolve paths relative to it rather than
+  having the kernel walk the branch prefix on every call. If it can
+  not be opened the branch falls back to absolute paths.
+*/
+static
+int
+open_root(const string &path_)
+{
+#ifdef O_PATH
+  return fs::open(path_,O_PATH|O_DIRECTORY|O_CLOEXEC);
+#else
+  return fs::open(path_,O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+#endif
+}
+
 static
 void
 parse(const string &str_,
@@ -124,6 +168,7 @@ parse(const string &str_,
   for(size_t i = 0; i < globbed.size(); i++)
     {
       branch.path = globbed[i];
+      branch.fd   = -1;
       branches_.push_back(branch);
     }
 }
@@ -190,12 +235,18 @@ Branches::add_end(const std::string &str_)
 void
 Branches::erase_begin(void)
 {
+  if(empty())
+    return;
+
   erase(begin());
 }
 
 void
 Branches::erase_end(void)
 {
+  if(empty())
+    return;
+
   pop_back();
 }
 
@@ -220,3 +271,55 @@ Branches::erase_fnmatch(const std::string &str_)
       i = ((match == 0) ? erase(i) : (i+1));
     }
 }
+
+/*
+  Snapshots are never modified once published. Changes are made to a
+  copy which replaces the current one here. Root descriptors only the
+  old snapshot used are closed once no reader can be using it.
+*/
+void
+Branches::publish(rcu::Ptr<Branches> &ptr_,
+                  Branches           *branches_)
+{
+  Branches *old;
+
+  old = ptr_.exchange(branches_);
+  if(old == NULL)
+    return;
+
+  rcu::synchronize();
+
+  old->close_fds(*branches_);
+
+  delete old;
+}
+
+void
+Branches::open_fds(void)
+{
+  for(iterator i = begin(); i != end(); ++i)
+    {
+      if(i->fd < 0)
+        i->fd = open_root(i->path);
+    }
+}
+
+void
+Branches::close_fds(const Branches &keep_)
+{
+  for(iterator i = begin(); i != end(); ++i)
+    {
+      bool keep;
+
+      if(i->fd < 0)
+        continue;
+
+      keep = false;
+      for(const_iterator k = keep_.begin(); k != keep_.end() && !keep; ++k)
+        keep = (k->fd == i->fd);
+
+      if(!keep)
+        fs::close(i->fd);
+      i->fd = -1;
+    }
+}
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include "rcu.hpp"
+
 #include <string>
 #include <vector>
 
@@ -33,6 +35,7 @@ struct Branch
 
   Mode        mode;
   std::string path;
+  int         fd;
 
   bool ro(void) const;
   bool nc(void) const;
@@ -41,6 +44,12 @@ struct Branch
 
 class Branches : public std::vector<Branch>
 {
+public:
+  typedef rcu::Snapshot<Branches> Snapshot;
+
+public:
+  const Branch *find(const std::string &path_) const;
+
 public:
   std::string to_string(const bool mode_ = false) const;
 
@@ -53,4 +62,12 @@ public:
   void erase_begin(void);
   void erase_end(void);
   void erase_fnmatch(const std::string &str_);
+
+  void open_fds(void);
+
+public:
+  static void publish(rcu::Ptr<Branches> &ptr_, Branches *branches_);
+
+private:
+  void close_fds(const Branches &keep_);
 };
@@ -0,0 +1,48 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "clonepath_cache.hpp"
+
+#include <string>
+
+#include <stdint.h>
+
+using std::string;
+
+ClonePathCache&
+ClonePathCache::instance(void)
+{
+  static ClonePathCache cache;
+
+  return cache;
+}
+
+bool
+ClonePathCache::has(const string &branch_,
+                    const char   *fusedirpath_)
+{
+  return PathCache::get(fusedirpath_,branch_.c_str());
+}
+
+void
+ClonePathCache::insert(const string   &branch_,
+                       const char     *fusedirpath_,
+                       const uint64_t  generation_)
+{
+  PathCache::insert(fusedirpath_,branch_.c_str(),1,generation_);
+}
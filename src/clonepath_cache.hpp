@@ -0,0 +1,49 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "path_cache.hpp"
+
+#include <string>
+
+#include <stdint.h>
+
+/*
+  Directories known to exist on each branch. fs::clonepath consults
+  it before walking and recreating a path so creates in directories
+  already cloned to a branch skip the stat/mkdir/metadata copy of
+  every component. Entries are dropped when the directory (or one
+  above it) is removed or renamed through mergerfs, when the branches
+  change, and after the timeout.
+
+  There is one instance for the process since clonepath is used
+  outside of FUSE requests as well.
+*/
+class ClonePathCache : public PathCache
+{
+public:
+  static ClonePathCache &instance(void);
+
+public:
+  bool has(const std::string &branch_,
+           const char        *fusedirpath_);
+  void insert(const std::string &branch_,
+              const char        *fusedirpath_,
+              const uint64_t     generation_);
+};
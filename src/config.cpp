@@ -23,7 +23,6 @@
 #include "config.hpp"
 #include "errno.hpp"
 #include "fs.hpp"
-#include "rwlock.hpp"
 
 #define MINFREESPACE_DEFAULT (4294967295ULL)
 #define POLICYINIT(X) X(policies[FuseFunc::Enum::X])
@@ -33,18 +32,30 @@ using std::vector;
 
 Config::Config()
   : destmount(),
-    branches(),
+    branches(new Branches()),
     branches_lock(),
     minfreespace(MINFREESPACE_DEFAULT),
     moveonenospc(false),
+    branch_fds(false),
     direct_io(false),
     dropcacheonclose(false),
+    dropcacheonclose_minsize(0),
+    dropcacheonclose_streamed(false),
+    dropcacheonclose_budget(0),
     symlinkify(false),
     symlinkify_timeout(3600),
     nullrw(false),
     ignorepponrename(false),
     security_capability(true),
+    getattr_coalesce(false),
     link_cow(false),
+    link_cow_lazy(false),
+    share_rdonly_fds(false),
+    passthrough(false),
+    readahead(0),
+    writecombine(0),
+    prealloc(0),
+    fanout(0),
     xattr(0),
     statfs(StatFS::BASE),
     statfs_ignore(StatFSIgnore::NONE),
@@ -68,9 +79,10 @@ Config::Config()
     POLICYINIT(truncate),
     POLICYINIT(unlink),
     POLICYINIT(utimens),
+    clonepath_cache(ClonePathCache::instance()),
     controlfile("/.mergerfs")
 {
-  pthread_rwlock_init(&branches_lock,NULL);
+  pthread_mutex_init(&branches_lock,NULL);
 
   set_category_policy("action","epall");
   set_category_policy("create","epmfs");
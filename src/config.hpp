@@ -17,7 +17,11 @@
 #pragma once
 
 #include "branch.hpp"
+#include "clonepath_cache.hpp"
+#include "enoattr_cache.hpp"
+#include "enoent_cache.hpp"
 #include "fusefunc.hpp"
+#include "openrules.hpp"
 #include "policy.hpp"
 #include "policy_cache.hpp"
 
@@ -62,18 +66,30 @@ public:
 
 public:
   std::string              destmount;
-  Branches                 branches;
-  mutable pthread_rwlock_t branches_lock;
+  rcu::Ptr<Branches>       branches;
+  mutable pthread_mutex_t  branches_lock;
   uint64_t                 minfreespace;
   bool                     moveonenospc;
+  bool                     branch_fds;
   bool                     direct_io;
   bool                     dropcacheonclose;
+  uint64_t                 dropcacheonclose_minsize;
+  bool                     dropcacheonclose_streamed;
+  uint64_t                 dropcacheonclose_budget;
   bool                     symlinkify;
   time_t                   symlinkify_timeout;
   bool                     nullrw;
   bool                     ignorepponrename;
   bool                     security_capability;
+  bool                     getattr_coalesce;
   bool                     link_cow;
+  bool                     link_cow_lazy;
+  bool                     share_rdonly_fds;
+  bool                     passthrough;
+  uint64_t                 readahead;
+  uint64_t                 writecombine;
+  uint64_t                 prealloc;
+  uint64_t                 fanout;
   int                      xattr;
   StatFS::Enum             statfs;
   StatFSIgnore::Enum       statfs_ignore;
@@ -102,7 +118,11 @@ public:
   const Policy *&utimens;
 
 public:
-  mutable PolicyCache open_cache;
+  mutable PolicyCache  open_cache;
+  mutable ENOENTCache  enoent_cache;
+  mutable ENOATTRCache enoattr_cache;
+  ClonePathCache      &clonepath_cache;
+  OpenRules            open_rules;
 
 public:
   const std::string controlfile;
@@ -16,7 +16,8 @@
 
 #pragma once
 
-#include <string>
+#include "pool.hpp"
+#include "smallstring.hpp"
 
 class DirInfo
 {
@@ -27,5 +28,18 @@ public:
   }
 
 public:
-  std::string fusepath;
+  static
+  Pool&
+  pool(void)
+  {
+    static Pool pool(sizeof(DirInfo));
+
+    return pool;
+  }
+
+  static void *operator new(size_t) { return DirInfo::pool().alloc(); }
+  static void operator delete(void *ptr_) { DirInfo::pool().free(ptr_); }
+
+public:
+  SmallString<128> fusepath;
 };
@@ -0,0 +1,299 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "config.hpp"
+#include "dropcache.hpp"
+#include "errno.hpp"
+#include "fileinfo.hpp"
+#include "fs_base_close.hpp"
+#include "fs_base_fadvise.hpp"
+#include "fs_base_open.hpp"
+#include "fs_base_readlink.hpp"
+#include "fs_base_stat.hpp"
+#include "readahead.hpp"
+#include "ugid.hpp"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+
+struct RetainedFile
+{
+  dev_t       dev;
+  ino_t       ino;
+  uint64_t    size;
+  std::string path;
+};
+
+typedef std::list<RetainedFile>                       RetainedList;
+typedef std::pair<dev_t,ino_t>                        RetainedKey;
+typedef std::map<RetainedKey,RetainedList::iterator>  RetainedMap;
+
+// most recently closed at the front
+static pthread_mutex_t g_lock     = PTHREAD_MUTEX_INITIALIZER;
+static RetainedList    g_lru;
+static RetainedMap     g_files;
+static uint64_t        g_retained = 0;
+
+#ifndef O_NOATIME
+#define O_NOATIME 0
+#endif
+
+namespace l
+{
+  static
+  void
+  drop(const int fd_)
+  {
+    // according to Feh of nocache calling it once doesn't always work
+    // https://github.com/Feh/nocache
+    fs::fadvise_dontneed(fd_);
+    fs::fadvise_dontneed(fd_);
+  }
+
+  /*
+    The file is reopened by the path it had when retained, possibly
+    by another user than the one who opened it. Opened as root so
+    permissions don't matter, without following links, blocking on
+    FIFOs, or touching atime, and only dropped if it's still the
+    same regular file.
+  */
+  static
+  void
+  drop(const RetainedFile &file_)
+  {
+    int rv;
+    int fd;
+    struct stat st;
+    const ugid::SetRootGuard ugidGuard;
+
+    fd = fs::open(file_.path,O_RDONLY|O_NOFOLLOW|O_NONBLOCK|O_NOATIME);
+    if(fd == -1)
+      return;
+
+    rv = fs::fstat(fd,&st);
+    if((rv == 0) &&
+       S_ISREG(st.st_mode) &&
+       (st.st_dev == file_.dev) &&
+       (st.st_ino == file_.ino))
+      l::drop(fd);
+
+    fs::close(fd);
+  }
+
+  static
+  int
+  fdpath(const int  fd_,
+         string    &path_)
+  {
+    int rv;
+    char link[64];
+    char buf[PATH_MAX];
+
+    snprintf(link,sizeof(link),"/proc/self/fd/%d",fd_);
+
+    rv = fs::readlink(link,buf,sizeof(buf) - 1);
+    if(rv == -1)
+      return -1;
+
+    buf[rv] = '\0';
+    path_   = buf;
+
+    return 0;
+  }
+
+  // must hold g_lock
+  static
+  void
+  forget_locked(const RetainedKey &key_)
+  {
+    RetainedMap::iterator i;
+
+    i = g_files.find(key_);
+    if(i == g_files.end())
+      return;
+
+    g_retained -= i->second->size;
+    g_lru.erase(i->second);
+    g_files.erase(i);
+  }
+
+  static
+  void
+  forget(const struct stat &st_)
+  {
+    pthread_mutex_lock(&g_lock);
+    l::forget_locked(RetainedKey(st_.st_dev,st_.st_ino));
+    pthread_mutex_unlock(&g_lock);
+  }
+
+  static
+  void
+  retain(const struct stat &st_,
+         const uint64_t     size_,
+         const string      &path_,
+         const uint64_t     budget_)
+  {
+    RetainedFile file;
+    RetainedKey key(st_.st_dev,st_.st_ino);
+    vector<RetainedFile> evicted;
+
+    file.dev  = st_.st_dev;
+    file.ino  = st_.st_ino;
+    file.size = size_;
+    file.path = path_;
+
+    pthread_mutex_lock(&g_lock);
+    l::forget_locked(key);
+    g_lru.push_front(file);
+    g_files[key] = g_lru.begin();
+    g_retained  += size_;
+    while(g_retained > budget_)
+      {
+        const RetainedFile &oldest = g_lru.back();
+
+        evicted.push_back(oldest);
+        g_retained -= oldest.size;
+        g_files.erase(RetainedKey(oldest.dev,oldest.ino));
+        g_lru.pop_back();
+      }
+    pthread_mutex_unlock(&g_lock);
+
+    for(size_t i = 0; i < evicted.size(); i++)
+      l::drop(evicted[i]);
+  }
+}
+
+namespace dropcache
+{
+  Tracker::Tracker()
+    : _next(0),
+      _bytes_read(0),
+      _sequential(true)
+  {
+
+  }
+
+  /*
+    Uses the same tolerance for reordered reads as readahead so a
+    file streamed by several threads still counts as sequential.
+  */
+  void
+  Tracker::read(const off_t  offset_,
+                const size_t size_)
+  {
+    off_t end;
+    off_t next;
+
+    end  = (offset_ + size_);
+    next = __atomic_load_n(&_next,__ATOMIC_RELAXED);
+    if(!ReadAhead::sequential(next,
+                              offset_,
+                              READAHEAD_MIN_WINDOW,
+                              next + READAHEAD_MIN_WINDOW))
+      __atomic_store_n(&_sequential,false,__ATOMIC_RELAXED);
+
+    while((end > next) &&
+          !__atomic_compare_exchange_n(&_next,&next,end,true,
+                                       __ATOMIC_RELAXED,__ATOMIC_RELAXED))
+      ;
+
+    __atomic_add_fetch(&_bytes_read,(uint64_t)size_,__ATOMIC_RELAXED);
+  }
+
+  bool
+  Tracker::streamed(const off_t filesize_) const
+  {
+    return (__atomic_load_n(&_sequential,__ATOMIC_RELAXED) &&
+            (filesize_ > 0) &&
+            (bytes_read() >= (uint64_t)filesize_));
+  }
+
+  void
+  release(const Config &config_,
+          FileInfo     *fi_,
+          const int     flags_)
+  {
+    int rv;
+    bool rdonly;
+    uint64_t size;
+    string path;
+    struct stat st;
+
+    if(!config_.dropcacheonclose)
+      return;
+
+    rv = fs::fstat(fi_->fd,&st);
+    if(rv == -1)
+      {
+        l::drop(fi_->fd);
+        return;
+      }
+
+    rdonly = ((flags_ & O_ACCMODE) == O_RDONLY);
+    if(((uint64_t)st.st_size >= config_.dropcacheonclose_minsize) ||
+       (config_.dropcacheonclose_streamed &&
+        rdonly &&
+        fi_->cachetracker.streamed(st.st_size)))
+      {
+        l::forget(st);
+        l::drop(fi_->fd);
+        return;
+      }
+
+    if(config_.dropcacheonclose_budget == 0)
+      return;
+
+    size = (uint64_t)st.st_size;
+    if(rdonly)
+      size = std::min(size,fi_->cachetracker.bytes_read());
+    if(size == 0)
+      return;
+
+    rv = l::fdpath(fi_->fd,path);
+    if(rv == -1)
+      return;
+
+    l::retain(st,size,path,config_.dropcacheonclose_budget);
+  }
+
+  uint64_t
+  retained(void)
+  {
+    uint64_t rv;
+
+    pthread_mutex_lock(&g_lock);
+    rv = g_retained;
+    pthread_mutex_unlock(&g_lock);
+
+    return rv;
+  }
+}
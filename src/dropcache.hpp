@@ -0,0 +1,70 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+  Page cache policy applied on release when dropcacheonclose is
+  enabled. Rather than dropping every file's cache:
+
+  * files at least `dropcacheonclose_minsize` bytes are dropped
+  * with `dropcacheonclose_streamed` files only ever read sequentially
+    from start to end during that open are dropped as well
+  * everything else is kept and, with `dropcacheonclose_budget`, the
+    least recently closed files are dropped once the estimated amount
+    kept exceeds the budget
+
+  With the defaults every file is dropped as before.
+*/
+
+class Config;
+class FileInfo;
+
+namespace dropcache
+{
+  class Tracker
+  {
+  public:
+    Tracker();
+
+  public:
+    void read(const off_t  offset,
+              const size_t size);
+
+  public:
+    uint64_t bytes_read(void) const { return __atomic_load_n(&_bytes_read,__ATOMIC_RELAXED); }
+    bool     streamed(const off_t filesize) const;
+
+  private:
+    // updated by concurrent reads of the same handle
+    off_t    _next;
+    uint64_t _bytes_read;
+    bool     _sequential;
+  };
+
+  void
+  release(const Config &config,
+          FileInfo     *fi,
+          const int     flags);
+
+  uint64_t retained(void);
+}
@@ -0,0 +1,116 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "enoattr_cache.hpp"
+#include "str.hpp"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+
+using std::set;
+using std::string;
+using std::vector;
+
+static const char DEFAULT_NAMES[] =
+  "security.capability:system.posix_acl_access:system.posix_acl_default";
+
+ENOATTRCache::ENOATTRCache(void)
+{
+  pthread_mutex_init(&_names_lock,NULL);
+  names(DEFAULT_NAMES);
+}
+
+ENOATTRCache::~ENOATTRCache(void)
+{
+  pthread_mutex_destroy(&_names_lock);
+}
+
+bool
+ENOATTRCache::has(const char *fusepath_,
+                  const char *attrname_)
+{
+  return PathCache::get(fusepath_,attrname_);
+}
+
+void
+ENOATTRCache::insert(const char     *fusepath_,
+                     const char     *attrname_,
+                     const uint64_t  generation_)
+{
+  bool cacheable;
+
+  if(timeout == 0)
+    return;
+
+  pthread_mutex_lock(&_names_lock);
+  cacheable = _names.count(attrname_);
+  pthread_mutex_unlock(&_names_lock);
+
+  if(cacheable)
+    PathCache::insert(fusepath_,attrname_,1,generation_);
+}
+
+string
+ENOATTRCache::names(void)
+{
+  string rv;
+  set<string>::const_iterator i;
+
+  pthread_mutex_lock(&_names_lock);
+
+  for(i = _names.begin(); i != _names.end(); ++i)
+    {
+      if(!rv.empty())
+        rv += ':';
+      rv += *i;
+    }
+
+  pthread_mutex_unlock(&_names_lock);
+
+  return rv;
+}
+
+/*
+  Changing the names drops everything so entries for names no longer
+  configured don't linger and lookups racing the change can't record
+  one.
+*/
+void
+ENOATTRCache::names(const string &names_)
+{
+  vector<string> names;
+
+  str::split(names,names_,':');
+
+  pthread_mutex_lock(&_names_lock);
+
+  _names.clear();
+  for(size_t i = 0; i < names.size(); i++)
+    {
+      if(!names[i].empty())
+        _names.insert(names[i]);
+    }
+
+  pthread_mutex_unlock(&_names_lock);
+
+  PathCache::clear();
+}
@@ -0,0 +1,57 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "path_cache.hpp"
+
+#include <set>
+#include <string>
+
+#include <pthread.h>
+#include <stdint.h>
+
+/*
+  Userspace cache of extended attributes known to be absent from a
+  path. The kernel asks for security.capability before writes and for
+  the POSIX ACLs on permission checks and most files have neither.
+  Only ENOATTR results for the configured attribute names are kept.
+  Anything mergerfs does to a path which could add or change its
+  attributes drops what is known about it.
+*/
+class ENOATTRCache : public PathCache
+{
+public:
+  ENOATTRCache(void);
+  ~ENOATTRCache(void);
+
+public:
+  bool        has(const char *fusepath_,
+                  const char *attrname_);
+  void        insert(const char     *fusepath_,
+                     const char     *attrname_,
+                     const uint64_t  generation_);
+
+public:
+  std::string names(void);
+  void        names(const std::string &names_);
+
+private:
+  pthread_mutex_t       _names_lock;
+  std::set<std::string> _names;
+};
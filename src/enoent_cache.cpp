@@ -0,0 +1,127 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "enoent_cache.hpp"
+#include "fs_path.hpp"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace l
+{
+  static
+  const char *
+  basename(const char *fusepath_)
+  {
+    const char *p;
+
+    p = ::strrchr(fusepath_,'/');
+
+    return ((p == NULL) ? fusepath_ : (p + 1));
+  }
+
+  // NULL if it doesn't fit, a truncated name could match another
+  static
+  const char *
+  name(char        *buf_,
+       const size_t size_,
+       const char  *fusepath_,
+       const uid_t  uid_,
+       const gid_t  gid_)
+  {
+    int rv;
+
+    rv = snprintf(buf_,size_,"%u:%u:%s",uid_,gid_,l::basename(fusepath_));
+    if((rv < 0) || ((size_t)rv >= size_))
+      return NULL;
+
+    return buf_;
+  }
+}
+
+bool
+ENOENTCache::has(const char  *fusepath_,
+                 const uid_t  uid_,
+                 const gid_t  gid_)
+{
+  int rv;
+  fs::path::Buf parent;
+  char name[32 + NAME_MAX];
+
+  if(timeout == 0)
+    return false;
+
+  rv = parent.dirname(fusepath_);
+  if(rv == -1)
+    return false;
+  if(l::name(name,sizeof(name),fusepath_,uid_,gid_) == NULL)
+    return false;
+
+  return PathCache::get(parent.c_str(),name);
+}
+
+void
+ENOENTCache::insert(const char     *fusepath_,
+                    const uid_t     uid_,
+                    const gid_t     gid_,
+                    const uint64_t  generation_)
+{
+  int rv;
+  fs::path::Buf parent;
+  char name[32 + NAME_MAX];
+
+  if(timeout == 0)
+    return;
+
+  rv = parent.dirname(fusepath_);
+  if(rv == -1)
+    return;
+  if(l::name(name,sizeof(name),fusepath_,uid_,gid_) == NULL)
+    return;
+
+  PathCache::insert(parent.c_str(),name,1,generation_);
+}
+
+void
+ENOENTCache::invalidate(const char *fusepath_)
+{
+  int rv;
+  fs::path::Buf parent;
+
+  if(timeout == 0)
+    return;
+
+  rv = parent.dirname(fusepath_);
+  if(rv == -1)
+    PathCache::clear();
+  else
+    PathCache::invalidate(parent.c_str());
+}
+
+/*
+  For renames. A directory moved into place brings its contents with
+  it so anything recorded under the new path is dropped as well.
+*/
+void
+ENOENTCache::invalidate_tree(const char *fusepath_)
+{
+  ENOENTCache::invalidate(fusepath_);
+  PathCache::invalidate_tree(fusepath_);
+}
@@ -0,0 +1,47 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "path_cache.hpp"
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+  Userspace cache of paths known to be absent from all branches. The
+  kernel's negative entry cache is dropped whenever the parent
+  directory changes which makes it nearly useless for workloads like
+  interpreter module searches. Entries are grouped by parent
+  directory so creating anything in a directory drops what is known
+  about it. A path the policy couldn't see because of permissions is
+  also reported as ENOENT so entries are kept per uid and gid.
+*/
+class ENOENTCache : public PathCache
+{
+public:
+  bool has(const char  *fusepath_,
+           const uid_t  uid_,
+           const gid_t  gid_);
+  void insert(const char     *fusepath_,
+              const uid_t     uid_,
+              const gid_t     gid_,
+              const uint64_t  generation_);
+  void invalidate(const char *fusepath_);
+  void invalidate_tree(const char *fusepath_);
+};
@@ -0,0 +1,226 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "errno.hpp"
+#include "fanout.hpp"
+#include "rv.hpp"
+#include "ugid.hpp"
+
+#include <fuse.h>
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define FANOUT_MAX_THREADS 64
+
+using std::list;
+using std::string;
+using std::vector;
+
+namespace l
+{
+  struct Batch
+  {
+    const Policy::Func::cstrptrvec *basepaths;
+    fanout::Func                    func;
+    const void                     *data;
+    uid_t                           uid;
+    gid_t                           gid;
+    vector<int>                     rv;
+    vector<int>                     err;
+    size_t                          next;
+    size_t                          done;
+    int                             refs;
+    pthread_cond_t                  cond;
+  };
+}
+
+static pthread_mutex_t   g_lock    = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t    g_cond    = PTHREAD_COND_INITIALIZER;
+static list<l::Batch*>   g_queue;
+static uint64_t          g_threads = 0;
+
+namespace l
+{
+  /*
+    Claims and runs tasks from the batch until none are left. Called
+    and returns with g_lock held.
+  */
+  static
+  void
+  work(Batch *batch_)
+  {
+    int rv;
+    size_t i;
+
+    while(batch_->next < batch_->basepaths->size())
+      {
+        i = batch_->next++;
+        pthread_mutex_unlock(&g_lock);
+
+        rv = batch_->func((*batch_->basepaths)[i],batch_->data);
+        batch_->rv[i]  = rv;
+        batch_->err[i] = errno;
+
+        pthread_mutex_lock(&g_lock);
+        batch_->done++;
+      }
+  }
+
+  static
+  void*
+  worker(void *arg_)
+  {
+    Batch *batch;
+
+    pthread_mutex_lock(&g_lock);
+    for(;;)
+      {
+        while(g_queue.empty())
+          pthread_cond_wait(&g_cond,&g_lock);
+
+        batch = g_queue.front();
+        g_queue.pop_front();
+        if(batch->next >= batch->basepaths->size())
+          continue;
+        batch->refs++;
+        pthread_mutex_unlock(&g_lock);
+
+        /*
+          Switching credentials is a syscall (or several) so it's kept
+          outside the lock. The ref keeps the batch alive meanwhile.
+        */
+        {
+          const ugid::Set ugid(batch->uid,batch->gid);
+
+          pthread_mutex_lock(&g_lock);
+          l::work(batch);
+          pthread_mutex_unlock(&g_lock);
+        }
+
+        pthread_mutex_lock(&g_lock);
+        batch->refs--;
+        pthread_cond_broadcast(&batch->cond);
+      }
+
+    return NULL;
+  }
+
+  /*
+    Workers are started as needed and live for the life of the
+    process. Called with g_lock held.
+  */
+  static
+  void
+  start_threads(const uint64_t threads_)
+  {
+    int rv;
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    if(g_threads >= threads_)
+      return;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    while(g_threads < std::min(threads_,(uint64_t)FANOUT_MAX_THREADS))
+      {
+        rv = pthread_create(&thread,&attr,l::worker,NULL);
+        if(rv != 0)
+          break;
+        g_threads++;
+      }
+    pthread_attr_destroy(&attr);
+  }
+
+  static
+  int
+  run_inline(const Policy::Func::cstrptrvec &basepaths_,
+             fanout::Func                    func_,
+             const void                     *data_)
+  {
+    int rv;
+    int error;
+
+    error = -1;
+    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
+      {
+        rv = func_(basepaths_[i],data_);
+        error = error::calc(rv,error,errno);
+      }
+
+    return error;
+  }
+}
+
+namespace fanout
+{
+  int
+  run(const Policy::Func::cstrptrvec &basepaths_,
+      Func                            func_,
+      const void                     *data_,
+      const uint64_t                  threads_)
+  {
+    int error;
+    size_t n;
+    l::Batch batch;
+    const fuse_context *fc = fuse_get_context();
+
+    n = basepaths_.size();
+    if((threads_ == 0) || (n <= 1))
+      return l::run_inline(basepaths_,func_,data_);
+
+    batch.basepaths = &basepaths_;
+    batch.func      = func_;
+    batch.data      = data_;
+    batch.uid       = fc->uid;
+    batch.gid       = fc->gid;
+    batch.rv.resize(n,-1);
+    batch.err.resize(n,0);
+    batch.next      = 0;
+    batch.done      = 0;
+    batch.refs      = 0;
+    pthread_cond_init(&batch.cond,NULL);
+
+    pthread_mutex_lock(&g_lock);
+    l::start_threads(threads_);
+    for(size_t i = 1, ei = std::min((uint64_t)n,g_threads + 1); i < ei; i++)
+      g_queue.push_back(&batch);
+    pthread_cond_broadcast(&g_cond);
+
+    l::work(&batch);
+
+    g_queue.remove(&batch);
+    while((batch.done < n) || (batch.refs > 0))
+      pthread_cond_wait(&batch.cond,&g_lock);
+    pthread_mutex_unlock(&g_lock);
+
+    pthread_cond_destroy(&batch.cond);
+
+    error = -1;
+    for(size_t i = 0; i < n; i++)
+      error = error::calc(batch.rv[i],error,batch.err[i]);
+
+    return error;
+  }
+}
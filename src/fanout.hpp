@@ -0,0 +1,50 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "policy.hpp"
+
+#include <string>
+
+#include <stdint.h>
+
+/*
+  Runs an action against each branch path concurrently on a shared
+  pool of worker threads. The calling thread works on the batch too so
+  progress doesn't depend on a worker being free. Each task runs as
+  the caller's uid/gid.
+
+  `func` returns -1 and sets errno on failure. Results are merged in
+  branch order with error::calc so the outcome is identical to the
+  serial loops: 0 if any branch succeeded, otherwise the errno of the
+  last failure. The return value is that errno (or 0), to be negated
+  by the caller.
+
+  With `threads` of 0 or a single path the actions are run inline.
+*/
+namespace fanout
+{
+  typedef int (*Func)(const std::string *basepath, const void *data);
+
+  int
+  run(const Policy::Func::cstrptrvec &basepaths,
+      Func                            func,
+      const void                     *data,
+      const uint64_t                  threads);
+}
@@ -0,0 +1,241 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "fdshare.hpp"
+
+#include "fs_base_close.hpp"
+#include "fs_base_open.hpp"
+#include "fs_base_stat.hpp"
+#include "fs_branch.hpp"
+
+#include <map>
+#include <string>
+
+#include <fuse.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+using std::string;
+
+namespace fdshare
+{
+  struct Entry
+  {
+    string   key;
+    int      fd;
+    int      flags;
+    dev_t    dev;
+    ino_t    ino;
+    uint64_t refs;
+  };
+}
+
+typedef std::map<string,fdshare::Entry*> EntryMap;
+
+namespace l
+{
+  static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+  static EntryMap        g_entries;
+  static uint64_t        g_hits = 0;
+
+  static
+  bool
+  matches(const fdshare::Entry *entry_,
+          const int             flags_,
+          const struct stat    &st_)
+  {
+    return ((entry_->flags == flags_) &&
+            (entry_->dev   == st_.st_dev) &&
+            (entry_->ino   == st_.st_ino));
+  }
+
+  // caller holds g_lock
+  static
+  int
+  acquire(const string      &key_,
+          const int          flags_,
+          const struct stat &st_,
+          fdshare::Entry   **entry_)
+  {
+    EntryMap::iterator i;
+
+    i = g_entries.find(key_);
+    if(i == g_entries.end())
+      return -1;
+    if(!l::matches(i->second,flags_,st_))
+      return -1;
+
+    i->second->refs++;
+    *entry_ = i->second;
+
+    return i->second->fd;
+  }
+}
+
+namespace fdshare
+{
+  /*
+    Returns a descriptor as fs::branch::open() would. *entry_ is set
+    if the descriptor is shared and must be handed back with
+    release() rather than closed. Anything other than a regular file
+    which is still the same file after opening is returned unshared.
+  */
+  int
+  open(const Branch  &branch_,
+       const char    *fusepath_,
+       const int      flags_,
+       Entry        **entry_)
+  {
+    int rv;
+    int fd;
+    string key;
+    Entry *entry;
+    struct stat st;
+    struct stat fdst;
+    char ugid[32];
+    const fuse_context *fc = fuse_get_context();
+
+    *entry_ = NULL;
+
+    rv = fs::branch::lstat(branch_,fusepath_,&st);
+    if((rv == -1) || !S_ISREG(st.st_mode))
+      return fs::branch::open(branch_,fusepath_,flags_);
+
+    snprintf(ugid,sizeof(ugid),"%u:%u:",fc->uid,fc->gid);
+
+    key  = ugid;
+    key += branch_.path;
+    key += fusepath_;
+
+    pthread_mutex_lock(&l::g_lock);
+    fd = l::acquire(key,flags_,st,entry_);
+    if(fd != -1)
+      l::g_hits++;
+    pthread_mutex_unlock(&l::g_lock);
+    if(fd != -1)
+      return fd;
+
+    fd = fs::branch::open(branch_,fusepath_,flags_);
+    if(fd == -1)
+      return -1;
+
+    rv = fs::fstat(fd,&fdst);
+    if((rv == -1) ||
+       (fdst.st_dev != st.st_dev) ||
+       (fdst.st_ino != st.st_ino))
+      return fd;
+
+    pthread_mutex_lock(&l::g_lock);
+    rv = l::acquire(key,flags_,st,entry_);
+    if(rv == -1)
+      {
+        // replaces any stale entry, its holders keep it alive
+        entry = new Entry();
+        entry->key   = key;
+        entry->fd    = fd;
+        entry->flags = flags_;
+        entry->dev   = st.st_dev;
+        entry->ino   = st.st_ino;
+        entry->refs  = 1;
+
+        l::g_entries[key] = entry;
+        *entry_ = entry;
+      }
+    pthread_mutex_unlock(&l::g_lock);
+
+    // lost a race with another open of the same file
+    if(rv != -1)
+      {
+        fs::close(fd);
+        fd = rv;
+      }
+
+    return fd;
+  }
+
+  /*
+    Drops a reference. Returns true if it was the last one, in which
+    case the caller now owns the descriptor outright and is
+    responsible for closing it.
+  */
+  bool
+  release(Entry *entry_)
+  {
+    EntryMap::iterator i;
+
+    pthread_mutex_lock(&l::g_lock);
+    entry_->refs--;
+    if(entry_->refs > 0)
+      {
+        pthread_mutex_unlock(&l::g_lock);
+        return false;
+      }
+
+    i = l::g_entries.find(entry_->key);
+    if((i != l::g_entries.end()) && (i->second == entry_))
+      l::g_entries.erase(i);
+    pthread_mutex_unlock(&l::g_lock);
+
+    delete entry_;
+
+    return true;
+  }
+
+  /*
+    A private descriptor on the same file for anything tied to the
+    open file description, such as flock, which other holders
+    mustn't observe. The shared one stays in use for I/O so it's
+    never swapped out from under concurrent reads.
+  */
+  int
+  reopen(const Entry *entry_)
+  {
+    char path[64];
+
+    snprintf(path,sizeof(path),"/proc/self/fd/%d",entry_->fd);
+
+    return fs::open(path,(entry_->flags & ~(O_CREAT|O_EXCL|O_NOFOLLOW)));
+  }
+
+  uint64_t
+  open_count(void)
+  {
+    uint64_t rv;
+
+    pthread_mutex_lock(&l::g_lock);
+    rv = l::g_entries.size();
+    pthread_mutex_unlock(&l::g_lock);
+
+    return rv;
+  }
+
+  uint64_t
+  hits(void)
+  {
+    uint64_t rv;
+
+    pthread_mutex_lock(&l::g_lock);
+    rv = l::g_hits;
+    pthread_mutex_unlock(&l::g_lock);
+
+    return rv;
+  }
+}
@@ -0,0 +1,50 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "branch.hpp"
+
+#include <stdint.h>
+
+/*
+  Read-only opens of the same regular file on the same branch can
+  share one branch file descriptor. Reads use pread so the shared
+  offset doesn't matter. Entries are keyed by the caller's uid and
+  gid, branch and path, so a descriptor is only handed to those who
+  opened it under the same credentials, and only reused while the
+  path still refers to the inode the descriptor was opened on and
+  the open flags match. The descriptor is closed when the last
+  FileInfo using it is released.
+*/
+
+namespace fdshare
+{
+  struct Entry;
+
+  int open(const Branch  &branch_,
+           const char    *fusepath_,
+           const int      flags_,
+           Entry        **entry_);
+
+  bool release(Entry *entry_);
+  int  reopen(const Entry *entry_);
+
+  uint64_t open_count(void);
+  uint64_t hits(void);
+}
@@ -16,7 +16,18 @@
 
 #pragma once
 
-#include <string>
+#include "dropcache.hpp"
+#include "fs_cow.hpp"
+#include "pool.hpp"
+#include "prealloc.hpp"
+#include "readahead.hpp"
+#include "smallstring.hpp"
+#include "writecombine.hpp"
+
+#include <pthread.h>
+
+namespace fdshare { struct Entry; }
+namespace fs { class MoveFile; }
 
 class FileInfo
 {
@@ -24,11 +35,64 @@ public:
   FileInfo(const int   fd_,
            const char *fusepath_)
     : fd(fd_),
-      fusepath(fusepath_)
+      direct_io(false),
+      backing_id(0),
+      shared(NULL),
+      flockfd(-1),
+      fusepath(fusepath_),
+      movefile(NULL),
+      moveerror(0),
+      cow(NULL)
+  {
+    pthread_rwlock_init(&lock,NULL);
+  }
+
+  ~FileInfo()
   {
+    pthread_rwlock_destroy(&lock);
+    delete cow;
   }
 
+public:
+  static
+  Pool&
+  pool(void)
+  {
+    static Pool pool(sizeof(FileInfo));
+
+    return pool;
+  }
+
+  static void *operator new(size_t) { return FileInfo::pool().alloc(); }
+  static void operator delete(void *ptr_) { FileInfo::pool().free(ptr_); }
+
 public:
   int fd;
-  std::string fusepath;
+  // as decided at open, the kernel doesn't pass it with each request
+  bool direct_io;
+  int backing_id;
+  // set when fd is shared with other read-only opens of the file
+  fdshare::Entry *shared;
+  // private descriptor for flock when fd is shared, opened on demand
+  int flockfd;
+  SmallString<128> fusepath;
+
+  // writes hold it shared while moveonenospc is enabled or a move
+  // is running, the switchover exclusively
+  pthread_rwlock_t  lock;
+  fs::MoveFile     *movefile;
+  // failure writing data queued on a failed move, for flush/fsync
+  int               moveerror;
+
+  // link_cow_lazy: set until the first modification breaks the link
+  fs::cow::Deferred *cow;
+
+  // only a hint so concurrent readers aren't serialized on it
+  ReadAhead readahead;
+
+  dropcache::Tracker cachetracker;
+
+  writecombine::Buffer writebuf;
+
+  Prealloc prealloc;
 };
@@ -28,16 +28,24 @@ namespace fs
   namespace acl
   {
     bool
-    dir_has_defaults(const std::string &fullpath_)
+    dir_has_defaults(const char *fullpath_)
     {
       int rv;
-      std::string dirpath;
+      fs::path::Buf dirpath;
 
-      dirpath = fs::path::dirname(&fullpath_);
+      rv = dirpath.dirname(fullpath_);
+      if(rv == -1)
+        return false;
 
-      rv = fs::lgetxattr(dirpath,POSIX_ACL_DEFAULT_XATTR,NULL,0);
+      rv = fs::lgetxattr(dirpath.c_str(),POSIX_ACL_DEFAULT_XATTR,NULL,0);
 
       return (rv != -1);
     }
+
+    bool
+    dir_has_defaults(const std::string &fullpath_)
+    {
+      return fs::acl::dir_has_defaults(fullpath_.c_str());
+    }
   }
 }
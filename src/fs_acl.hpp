@@ -24,6 +24,8 @@ namespace fs
 {
   namespace acl
   {
+    bool
+    dir_has_defaults(const char *fullpath_);
     bool
     dir_has_defaults(const std::string &fullpath_);
   }
@@ -0,0 +1,112 @@
+/*
+  ISC License
+
+  Copyright (c) 2020, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "fs_acl.hpp"
+#include "fs_acl_cache.hpp"
+#include "fs_path.hpp"
+#include "path_cache.hpp"
+
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+using std::string;
+
+/*
+  Whether a directory on a branch has a default ACL. Creates check
+  the parent directory every time to know if the umask applies but
+  it almost never changes. Entries are grouped by FUSE directory path
+  so that a change through mergerfs can drop the directory (and those
+  below it) on every branch at once. Changes made directly to the
+  branches are picked up after the timeout.
+*/
+
+static const char POSIX_ACL_DEFAULT_XATTR[] = "system.posix_acl_default";
+
+static PathCache g_cache;
+
+namespace fs
+{
+  namespace acl
+  {
+    uint64_t
+    cache_timeout(void)
+    {
+      return g_cache.timeout;
+    }
+
+    void
+    cache_timeout(const uint64_t timeout_)
+    {
+      g_cache.timeout = timeout_;
+    }
+
+    bool
+    dir_has_defaults_cache(const string &basepath_,
+                           const char   *fusepath_)
+    {
+      bool rv;
+      uint64_t value;
+      uint64_t generation;
+      fs::path::Buf fullpath;
+      fs::path::Buf fusedirpath;
+
+      if(fullpath.make(basepath_,fusepath_) == -1)
+        return false;
+      if((g_cache.timeout == 0) || (fusedirpath.dirname(fusepath_) == -1))
+        return fs::acl::dir_has_defaults(fullpath.c_str());
+
+      if(g_cache.get(fusedirpath.c_str(),basepath_.c_str(),&value))
+        return !!value;
+
+      generation = g_cache.generation();
+
+      rv = fs::acl::dir_has_defaults(fullpath.c_str());
+
+      g_cache.insert(fusedirpath.c_str(),basepath_.c_str(),rv,generation);
+
+      return rv;
+    }
+
+    /*
+      A directory's default ACL set or removed through mergerfs, or
+      the directory removed or renamed, takes everything below it
+      along.
+    */
+    void
+    cache_invalidate_tree(const char *fusepath_)
+    {
+      g_cache.invalidate_tree(fusepath_);
+    }
+
+    void
+    cache_invalidate_xattr(const char *fusepath_,
+                           const char *attrname_)
+    {
+      if(strcmp(attrname_,POSIX_ACL_DEFAULT_XATTR) == 0)
+        fs::acl::cache_invalidate_tree(fusepath_);
+    }
+
+    void
+    cache_clear(void)
+    {
+      g_cache.clear();
+    }
+  }
+}
@@ -0,0 +1,46 @@
+/*
+  ISC License
+
+  Copyright (c) 2020, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <stdint.h>
+
+namespace fs
+{
+  namespace acl
+  {
+    uint64_t
+    cache_timeout(void);
+    void
+    cache_timeout(const uint64_t timeout_);
+
+    bool
+    dir_has_defaults_cache(const std::string &basepath_,
+                           const char        *fusepath_);
+
+    void
+    cache_invalidate_tree(const char *fusepath_);
+    void
+    cache_invalidate_xattr(const char *fusepath_,
+                           const char *attrname_);
+    void
+    cache_clear(void);
+  }
+}
@@ -25,6 +25,17 @@
 
 namespace fs
 {
+  static
+  inline
+  int
+  access(const int   dirfd_,
+         const char *path_,
+         const int   mode_,
+         const int   flags_)
+  {
+    return ::faccessat(dirfd_,path_,mode_,flags_);
+  }
+
   static
   inline
   int
@@ -33,7 +44,7 @@ namespace fs
          const int          mode_,
          const int          flags_)
   {
-    return ::faccessat(dirfd_,path_.c_str(),mode_,flags_);
+    return fs::access(dirfd_,path_.c_str(),mode_,flags_);
   }
 
   static
@@ -46,6 +57,15 @@ namespace fs
     return fs::access(AT_FDCWD,path_,mode_,flags_);
   }
 
+  static
+  inline
+  int
+  eaccess(const char *path_,
+          const int   mode_)
+  {
+    return fs::access(AT_FDCWD,path_,mode_,AT_EACCESS);
+  }
+
   static
   inline
   int
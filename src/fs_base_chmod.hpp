@@ -26,13 +26,22 @@
 
 namespace fs
 {
+  static
+  inline
+  int
+  chmod(const char   *path_,
+        const mode_t  mode_)
+  {
+    return ::chmod(path_,mode_);
+  }
+
   static
   inline
   int
   chmod(const std::string &path_,
         const mode_t       mode_)
   {
-    return ::chmod(path_.c_str(),mode_);
+    return fs::chmod(path_.c_str(),mode_);
   }
 
   static
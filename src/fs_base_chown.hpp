@@ -47,6 +47,16 @@ namespace fs
     return fs::chown(path_,st_.st_uid,st_.st_gid);
   }
 
+  static
+  inline
+  int
+  lchown(const char  *path_,
+         const uid_t  uid_,
+         const gid_t  gid_)
+  {
+    return ::lchown(path_,uid_,gid_);
+  }
+
   static
   inline
   int
@@ -54,7 +64,7 @@ namespace fs
          const uid_t        uid_,
          const gid_t        gid_)
   {
-    return ::lchown(path_.c_str(),uid_,gid_);
+    return fs::lchown(path_.c_str(),uid_,gid_);
   }
 
   static
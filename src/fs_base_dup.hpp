@@ -29,4 +29,13 @@ namespace fs
   {
     return ::dup(fd_);
   }
+
+  static
+  inline
+  int
+  dup2(const int oldfd_,
+       const int newfd_)
+  {
+    return ::dup2(oldfd_,newfd_);
+  }
 }
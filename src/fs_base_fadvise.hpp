@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <sys/types.h>
+
 namespace fs
 {
   int
@@ -20,6 +20,7 @@
 
 #include <string>
 
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -33,4 +34,14 @@ namespace fs
   {
     return ::mkdir(path_.c_str(),mode_);
   }
+
+  static
+  inline
+  int
+  mkdirat(const int     dirfd_,
+          const char   *path_,
+          const mode_t  mode_)
+  {
+    return ::mkdirat(dirfd_,path_,mode_);
+  }
 }
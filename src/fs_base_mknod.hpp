@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <string>
+
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -25,6 +27,16 @@
 
 namespace fs
 {
+  static
+  inline
+  int
+  mknod(const char   *path_,
+        const mode_t  mode_,
+        const dev_t   dev_)
+  {
+    return ::mknod(path_,mode_,dev_);
+  }
+
   static
   inline
   int
@@ -32,6 +44,6 @@ namespace fs
         const mode_t       mode_,
         const dev_t        dev_)
   {
-    return ::mknod(path_.c_str(),mode_,dev_);
+    return fs::mknod(path_.c_str(),mode_,dev_);
   }
 }
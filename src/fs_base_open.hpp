@@ -63,4 +63,25 @@ namespace fs
   {
     return fs::open(path_.c_str(),flags_,mode_);
   }
+
+  static
+  inline
+  int
+  openat(const int   dirfd_,
+         const char *path_,
+         const int   flags_)
+  {
+    return ::openat(dirfd_,path_,flags_);
+  }
+
+  static
+  inline
+  int
+  openat(const int     dirfd_,
+         const char   *path_,
+         const int     flags_,
+         const mode_t  mode_)
+  {
+    return ::openat(dirfd_,path_,flags_,mode_);
+  }
 }
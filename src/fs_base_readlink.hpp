@@ -24,6 +24,16 @@
 
 namespace fs
 {
+  static
+  inline
+  int
+  readlink(const char   *path_,
+           char         *buf_,
+           const size_t  bufsiz_)
+  {
+    return ::readlink(path_,buf_,bufsiz_);
+  }
+
   static
   inline
   int
@@ -31,6 +41,6 @@ namespace fs
            char              *buf_,
            const size_t       bufsiz_)
   {
-    return ::readlink(path_.c_str(),buf_,bufsiz_);
+    return fs::readlink(path_.c_str(),buf_,bufsiz_);
   }
 }
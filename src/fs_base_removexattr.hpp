@@ -28,13 +28,22 @@ namespace fs
   static
   inline
   int
-  lremovexattr(const std::string &path_,
-               const char        *attrname_)
+  lremovexattr(const char *path_,
+               const char *attrname_)
   {
 #ifdef USE_XATTR
-    return ::lremovexattr(path_.c_str(),attrname_);
+    return ::lremovexattr(path_,attrname_);
 #else
     return (errno=ENOTSUP,-1);
 #endif
   }
+
+  static
+  inline
+  int
+  lremovexattr(const std::string &path_,
+               const char        *attrname_)
+  {
+    return fs::lremovexattr(path_.c_str(),attrname_);
+  }
 }
@@ -18,6 +18,9 @@
 
 #pragma once
 
+#include <string>
+
+#include <fcntl.h>
 #include <stdio.h>
 
 namespace fs
@@ -39,4 +42,15 @@ namespace fs
   {
     return fs::rename(oldpath_.c_str(),newpath_.c_str());
   }
+
+  static
+  inline
+  int
+  renameat(const int   olddirfd_,
+           const char *oldpath_,
+           const int   newdirfd_,
+           const char *newpath_)
+  {
+    return ::renameat(olddirfd_,oldpath_,newdirfd_,newpath_);
+  }
 }
@@ -20,6 +20,7 @@
 
 #include <string>
 
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -71,6 +72,17 @@ namespace fs
     return ::fstat(fd_,st_);
   }
 
+  static
+  inline
+  int
+  fstatat(const int    dirfd_,
+          const char  *path_,
+          struct stat *st_,
+          const int    flags_)
+  {
+    return ::fstatat(dirfd_,path_,st_,flags_);
+  }
+
   static
   inline
   timespec *
@@ -0,0 +1,57 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifndef STATX_TYPE
+# define STATX_TYPE         0x0001U
+# define STATX_MODE         0x0002U
+# define STATX_NLINK        0x0004U
+# define STATX_UID          0x0008U
+# define STATX_GID          0x0010U
+# define STATX_ATIME        0x0020U
+# define STATX_MTIME        0x0040U
+# define STATX_CTIME        0x0080U
+# define STATX_INO          0x0100U
+# define STATX_SIZE         0x0200U
+# define STATX_BLOCKS       0x0400U
+# define STATX_BASIC_STATS  0x07ffU
+#endif
+
+#ifndef AT_STATX_DONT_SYNC
+# define AT_STATX_DONT_SYNC 0x4000
+#endif
+
+namespace fs
+{
+  /*
+    Fill only the fields of `st_` selected by `mask_`. Uses statx(2)
+    when available so the filesystem may skip attributes not asked
+    for. Otherwise falls back to fstatat(2) and ignores the mask and
+    AT_STATX_* flags.
+  */
+  int
+  statx(const int           dirfd_,
+        const char         *path_,
+        const int           flags_,
+        const unsigned int  mask_,
+        struct stat        *st_);
+}
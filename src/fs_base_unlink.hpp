@@ -20,6 +20,7 @@
 
 #include <string>
 
+#include <fcntl.h>
 #include <unistd.h>
 
 namespace fs
@@ -39,4 +40,14 @@ namespace fs
   {
     return fs::unlink(path_.c_str());
   }
+
+  static
+  inline
+  int
+  unlinkat(const int   dirfd_,
+           const char *path_,
+           const int   flags_)
+  {
+    return ::unlinkat(dirfd_,path_,flags_);
+  }
 }
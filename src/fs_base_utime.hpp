@@ -59,9 +59,18 @@ namespace fs
   static
   inline
   int
-  lutime(const std::string     &path_,
+  lutime(const char            *path_,
          const struct timespec  times_[2])
   {
     return fs::utime(AT_FDCWD,path_,times_,AT_SYMLINK_NOFOLLOW);
   }
+
+  static
+  inline
+  int
+  lutime(const std::string     &path_,
+         const struct timespec  times_[2])
+  {
+    return fs::lutime(path_.c_str(),times_);
+  }
 }
@@ -25,6 +25,17 @@
 
 namespace fs
 {
+  static
+  inline
+  int
+  utime(const int              dirfd,
+        const char            *path,
+        const struct timespec  times[2],
+        const int              flags)
+  {
+    return ::utimensat(dirfd,path,times,flags);
+  }
+
   static
   inline
   int
@@ -33,7 +44,7 @@ namespace fs
         const struct timespec  times[2],
         const int              flags)
   {
-    return ::utimensat(dirfd,path.c_str(),times,flags);
+    return fs::utime(dirfd,path.c_str(),times,flags);
   }
 
   static
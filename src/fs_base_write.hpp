@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <sys/uio.h>
 #include <unistd.h>
 
 namespace fs
@@ -42,4 +43,15 @@ namespace fs
   {
     return ::pwrite(fd,buf,count,offset);
   }
+
+  static
+  inline
+  ssize_t
+  pwritev(const int           fd,
+          const struct iovec *iov,
+          const int           iovcnt,
+          const off_t         offset)
+  {
+    return ::pwritev(fd,iov,iovcnt,offset);
+  }
 }
@@ -0,0 +1,217 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "branch.hpp"
+#include "fs_base_mkdir.hpp"
+#include "fs_base_open.hpp"
+#include "fs_base_rename.hpp"
+#include "fs_base_stat.hpp"
+#include "fs_base_statx.hpp"
+#include "fs_base_unlink.hpp"
+#include "fs_path.hpp"
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/*
+  Wrappers which operate on a FUSE path within a branch. When the
+  branch has a root descriptor the *at() variant is used with a path
+  relative to it. Otherwise the absolute path is built on the stack
+  and used relative to AT_FDCWD.
+*/
+
+namespace fs
+{
+  namespace branch
+  {
+    static
+    inline
+    const char *
+    relpath(const char *fusepath_)
+    {
+      while(*fusepath_ == '/')
+        fusepath_++;
+
+      return ((*fusepath_ == '\0') ? "." : fusepath_);
+    }
+
+    static
+    inline
+    int
+    at(const Branch   &branch_,
+       const char     *fusepath_,
+       fs::path::Buf  &buf_,
+       int            *dirfd_,
+       const char    **path_)
+    {
+      if(branch_.fd >= 0)
+        {
+          *dirfd_ = branch_.fd;
+          *path_  = fs::branch::relpath(fusepath_);
+          return 0;
+        }
+
+      if(buf_.make(branch_.path,fusepath_) == -1)
+        return -1;
+
+      *dirfd_ = AT_FDCWD;
+      *path_  = buf_.c_str();
+
+      return 0;
+    }
+
+    static
+    inline
+    int
+    lstat(const Branch &branch_,
+          const char   *fusepath_,
+          struct stat  *st_)
+    {
+      int dirfd;
+      const char *path;
+      fs::path::Buf buf;
+
+      if(fs::branch::at(branch_,fusepath_,buf,&dirfd,&path) == -1)
+        return -1;
+
+      return fs::fstatat(dirfd,path,st_,AT_SYMLINK_NOFOLLOW);
+    }
+
+    /*
+      Existence and policy checks need few if any attributes and can
+      accept cached values so don't force a sync with remote
+      filesystems.
+    */
+    static
+    inline
+    int
+    statx(const Branch       &branch_,
+          const char         *fusepath_,
+          const unsigned int  mask_,
+          struct stat        *st_)
+    {
+      int dirfd;
+      const char *path;
+      fs::path::Buf buf;
+
+      if(fs::branch::at(branch_,fusepath_,buf,&dirfd,&path) == -1)
+        return -1;
+
+      return fs::statx(dirfd,
+                       path,
+                       (AT_SYMLINK_NOFOLLOW|AT_STATX_DONT_SYNC),
+                       mask_,
+                       st_);
+    }
+
+    static
+    inline
+    int
+    open(const Branch &branch_,
+         const char   *fusepath_,
+         const int     flags_)
+    {
+      int dirfd;
+      const char *path;
+      fs::path::Buf buf;
+
+      if(fs::branch::at(branch_,fusepath_,buf,&dirfd,&path) == -1)
+        return -1;
+
+      return fs::openat(dirfd,path,flags_);
+    }
+
+    static
+    inline
+    int
+    open(const Branch &branch_,
+         const char   *fusepath_,
+         const int     flags_,
+         const mode_t  mode_)
+    {
+      int dirfd;
+      const char *path;
+      fs::path::Buf buf;
+
+      if(fs::branch::at(branch_,fusepath_,buf,&dirfd,&path) == -1)
+        return -1;
+
+      return fs::openat(dirfd,path,flags_,mode_);
+    }
+
+    static
+    inline
+    int
+    mkdir(const Branch &branch_,
+          const char   *fusepath_,
+          const mode_t  mode_)
+    {
+      int dirfd;
+      const char *path;
+      fs::path::Buf buf;
+
+      if(fs::branch::at(branch_,fusepath_,buf,&dirfd,&path) == -1)
+        return -1;
+
+      return fs::mkdirat(dirfd,path,mode_);
+    }
+
+    static
+    inline
+    int
+    unlink(const Branch &branch_,
+           const char   *fusepath_)
+    {
+      int dirfd;
+      const char *path;
+      fs::path::Buf buf;
+
+      if(fs::branch::at(branch_,fusepath_,buf,&dirfd,&path) == -1)
+        return -1;
+
+      return fs::unlinkat(dirfd,path,0);
+    }
+
+    static
+    inline
+    int
+    rename(const Branch &branch_,
+           const char   *oldfusepath_,
+           const char   *newfusepath_)
+    {
+      int olddirfd;
+      int newdirfd;
+      const char *oldpath;
+      const char *newpath;
+      fs::path::Buf oldbuf;
+      fs::path::Buf newbuf;
+
+      if(fs::branch::at(branch_,oldfusepath_,oldbuf,&olddirfd,&oldpath) == -1)
+        return -1;
+      if(fs::branch::at(branch_,newfusepath_,newbuf,&newdirfd,&newpath) == -1)
+        return -1;
+
+      return fs::renameat(olddirfd,oldpath,newdirfd,newpath);
+    }
+  }
+}
@@ -29,6 +29,68 @@
 #include "fs_sendfile.hpp"
 #include "fs_xattr.hpp"
 
+#include <algorithm>
+
+#include <stdint.h>
+
+#define COPY_CHUNK_SIZE (64 * 1024 * 1024)
+
+static
+bool
+fallback_error(const int err_)
+{
+  switch(err_)
+    {
+    case EINVAL:
+    case ENOSYS:
+    case ENOTTY:
+    case EXDEV:
+    case EOPNOTSUPP:
+#if ENOTSUP != EOPNOTSUPP
+    case ENOTSUP:
+#endif
+      return true;
+    }
+
+  return false;
+}
+
+/*
+  copy_file_range may copy less than asked for (the kernel caps a
+  single call) so loop over explicit offsets in large chunks. If the
+  very first call isn't supported the caller falls back to other
+  methods. A failure midway is a real error.
+*/
+static
+int
+copydata_copy_file_range(const int    src_fd_,
+                         const int    dst_fd_,
+                         const size_t count_)
+{
+  ssize_t rv;
+  int64_t off_in;
+  int64_t off_out;
+
+  off_in  = 0;
+  off_out = 0;
+  while((size_t)off_in < count_)
+    {
+      rv = fs::copy_file_range(src_fd_,&off_in,
+                               dst_fd_,&off_out,
+                               std::min((size_t)(count_ - off_in),
+                                        (size_t)COPY_CHUNK_SIZE),
+                               0);
+      if((rv == -1) && (errno == EINTR))
+        continue;
+      if(rv == -1)
+        return ((off_in == 0) ? -1 : (errno=EIO,-1));
+      if(rv == 0)
+        break;
+    }
+
+  return 0;
+}
+
 static
 int
 copydata(const int    src_fd_,
@@ -37,18 +99,18 @@ copydata(const int    src_fd_,
 {
   int rv;
 
+  rv = fs::ficlone(src_fd_,dst_fd_);
+  if((rv != -1) || !fallback_error(errno))
+    return rv;
+
   fs::fadvise_willneed(src_fd_,0,count_);
   fs::fadvise_sequential(src_fd_,0,count_);
 
   fs::fallocate(dst_fd_,0,0,count_);
   fs::ftruncate(dst_fd_,count_);
 
-  rv = fs::ficlone(src_fd_,dst_fd_);
-  if((rv != -1) || ((rv == -1) && (errno != EOPNOTSUPP)))
-    return rv;
-
-  rv = fs::copy_file_range(src_fd_,dst_fd_,count_);
-  if((rv != -1) || ((rv == -1) && (errno != EOPNOTSUPP)))
+  rv = ::copydata_copy_file_range(src_fd_,dst_fd_,count_);
+  if((rv != -1) || !fallback_error(errno))
     return rv;
 
   rv = fs::sendfile(src_fd_,dst_fd_,count_);
@@ -78,8 +140,8 @@ ignorable_error(const int err_)
 namespace fs
 {
   int
-  clonefile(const int src_fd_,
-            const int dst_fd_)
+  clonemetadata(const int src_fd_,
+                const int dst_fd_)
   {
     int rv;
     struct stat src_st;
@@ -88,10 +150,6 @@ namespace fs
     if(rv == -1)
       return -1;
 
-    rv = ::copydata(src_fd_,dst_fd_,src_st.st_size);
-    if(rv == -1)
-      return -1;
-
     rv = fs::attr::copy(src_fd_,dst_fd_);
     if((rv == -1) && !ignorable_error(errno))
       return -1;
@@ -114,4 +172,22 @@ namespace fs
 
     return 0;
   }
+
+  int
+  clonefile(const int src_fd_,
+            const int dst_fd_)
+  {
+    int rv;
+    struct stat src_st;
+
+    rv = fs::fstat(src_fd_,&src_st);
+    if(rv == -1)
+      return -1;
+
+    rv = ::copydata(src_fd_,dst_fd_,src_st.st_size);
+    if(rv == -1)
+      return -1;
+
+    return fs::clonemetadata(src_fd_,dst_fd_);
+  }
 }
@@ -18,6 +18,10 @@
 
 namespace fs
 {
+  int
+  clonemetadata(const int src_fd_,
+                const int dst_fd_);
+
   int
   clonefile(const int src_fd_,
             const int dst_fd_);
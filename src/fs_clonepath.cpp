@@ -16,6 +16,7 @@
 
 #include <string>
 
+#include "clonepath_cache.hpp"
 #include "errno.h"
 #include "fs_attr.hpp"
 #include "fs_base_chmod.hpp"
@@ -61,14 +62,20 @@ namespace fs
             const char   *relative,
             const bool    return_metadata_errors)
   {
-    int         rv;
-    struct stat st;
-    string      topath;
-    string      frompath;
-    string      dirname;
+    int             rv;
+    uint64_t        gen;
+    struct stat     st;
+    string          topath;
+    string          frompath;
+    string          dirname;
+    ClonePathCache &cache = ClonePathCache::instance();
 
     if((relative == NULL) || (relative[0] == '\0'))
       return 0;
+    if(cache.has(tosrc,relative))
+      return 0;
+
+    gen = cache.generation();
 
     dirname = fs::path::dirname(relative);
     if(!dirname.empty())
@@ -89,10 +96,12 @@ namespace fs
     rv = fs::mkdir(topath,st.st_mode);
     if(rv == -1)
       {
-        if(errno == EEXIST)
-          return 0;
-        else
+        if(errno != EEXIST)
           return -1;
+
+        cache.insert(tosrc,relative,gen);
+
+        return 0;
       }
 
     // it may not support it... it's fine...
@@ -113,6 +122,8 @@ namespace fs
     if(return_metadata_errors && (rv == -1))
       return -1;
 
+    cache.insert(tosrc,relative,gen);
+
     return 0;
   }
 
@@ -20,6 +20,7 @@
 #include "fs_mktemp.hpp"
 
 #include "fs_base_close.hpp"
+#include "fs_base_dup.hpp"
 #include "fs_base_open.hpp"
 #include "fs_base_rename.hpp"
 #include "fs_base_stat.hpp"
@@ -127,5 +128,51 @@ namespace fs
 
       return 0;
     }
+
+    /*
+      Break the link for an already open handle and switch the handle
+      over to the new file. If the path no longer refers to the file
+      behind the handle another handle already broke the link and the
+      handle only needs to follow it.
+    */
+    int
+    break_link(const char *fullpath_,
+               const int   fd_,
+               const int   flags_)
+    {
+      int rv;
+      int fd;
+      struct stat fd_st;
+      struct stat path_st;
+
+      rv = fs::fstat(fd_,&fd_st);
+      if(rv == -1)
+        return -1;
+
+      rv = fs::lstat(fullpath_,&path_st);
+      if(rv == -1)
+        return -1;
+
+      if((fd_st.st_dev == path_st.st_dev) &&
+         (fd_st.st_ino == path_st.st_ino))
+        {
+          if(!fs::cow::is_eligible(path_st))
+            return 0;
+
+          rv = fs::cow::break_link(fullpath_);
+          if(rv == -1)
+            return -1;
+        }
+
+      fd = fs::open(fullpath_,(flags_ & ~(O_CREAT|O_EXCL|O_TRUNC)));
+      if(fd == -1)
+        return -1;
+
+      rv = fs::dup2(fd,fd_);
+
+      fs::close(fd);
+
+      return ((rv == -1) ? -1 : 0);
+    }
   }
 }
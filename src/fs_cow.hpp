@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <string>
+
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -32,5 +34,20 @@ namespace fs
     bool is_eligible(const char *fullpath_, const int flags_);
 
     int  break_link(const char *fullpath_);
+    int  break_link(const char *fullpath_, const int fd_, const int flags_);
+
+    // link_cow_lazy: where and how the handle was opened
+    struct Deferred
+    {
+      Deferred(const std::string &fullpath_,
+               const int          flags_)
+        : fullpath(fullpath_),
+          flags(flags_)
+      {
+      }
+
+      std::string fullpath;
+      int         flags;
+    };
   }
 }
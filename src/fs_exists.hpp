@@ -18,7 +18,10 @@
 
 #pragma once
 
+#include "branch.hpp"
 #include "fs_base_stat.hpp"
+#include "fs_base_statx.hpp"
+#include "fs_branch.hpp"
 #include "fs_path.hpp"
 
 #include <string>
@@ -73,4 +76,40 @@ namespace fs
 
     return fs::exists(basepath_,relpath_,&st);
   }
+
+  static
+  inline
+  bool
+  exists(const Branch       &branch_,
+         const char         *relpath_,
+         const unsigned int  mask_,
+         struct stat        *st_)
+  {
+    int rv;
+
+    rv = fs::branch::statx(branch_,relpath_,mask_,st_);
+
+    return (rv == 0);
+  }
+
+  static
+  inline
+  bool
+  exists(const Branch &branch_,
+         const char   *relpath_,
+         struct stat  *st_)
+  {
+    return fs::exists(branch_,relpath_,STATX_BASIC_STATS,st_);
+  }
+
+  static
+  inline
+  bool
+  exists(const Branch &branch_,
+         const char   *relpath_)
+  {
+    struct stat st;
+
+    return fs::exists(branch_,relpath_,0,&st);
+  }
 }
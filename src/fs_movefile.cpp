@@ -14,113 +14,547 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
-#include <fcntl.h>
-#include <stdlib.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-#include <string>
-#include <vector>
-
 #include "errno.hpp"
 #include "fs.hpp"
-#include "fs_base_open.hpp"
 #include "fs_base_close.hpp"
+#include "fs_base_dup.hpp"
+#include "fs_base_fadvise.hpp"
+#include "fs_base_fallocate.hpp"
+#include "fs_base_ftruncate.hpp"
 #include "fs_base_mkstemp.hpp"
+#include "fs_base_open.hpp"
+#include "fs_base_read.hpp"
 #include "fs_base_rename.hpp"
-#include "fs_base_unlink.hpp"
 #include "fs_base_stat.hpp"
+#include "fs_base_unlink.hpp"
+#include "fs_base_write.hpp"
 #include "fs_clonefile.hpp"
 #include "fs_clonepath.hpp"
+#include "fs_copy_file_range.hpp"
+#include "fs_ficlone.hpp"
+#include "fs_movefile.hpp"
 #include "fs_path.hpp"
 
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using std::map;
 using std::string;
 using std::vector;
 
+#define MOVEFILE_CHUNK_SIZE  (64 * 1024 * 1024)
+#define MOVEFILE_MAX_THREADS 4
+#define MOVEFILE_BUF_SIZE    (1024 * 1024)
+#define MOVEFILE_DEFER_MAX   (16 * 1024 * 1024)
+
+typedef map<string,const fs::MoveFile*> MoveFileMap;
+
+static pthread_mutex_t g_movefiles_lock = PTHREAD_MUTEX_INITIALIZER;
+static MoveFileMap     g_movefiles;
+
+namespace l
+{
+  static
+  bool
+  copy_file_range_unsupported(const int error_)
+  {
+    switch(error_)
+      {
+      case EXDEV:
+      case EINVAL:
+      case ENOSYS:
+      case EOPNOTSUPP:
+        return true;
+      }
+
+    return false;
+  }
+
+  static
+  ssize_t
+  copy_rw(const int     src_fd_,
+          const int     dst_fd_,
+          const off_t   offset_,
+          const size_t  size_,
+          vector<char> &buf_)
+  {
+    ssize_t nr;
+    ssize_t nw;
+    size_t  nleft;
+
+    if(buf_.empty())
+      buf_.resize(MOVEFILE_BUF_SIZE);
+
+    nr = fs::pread(src_fd_,&buf_[0],std::min(size_,buf_.size()),offset_);
+    if(nr <= 0)
+      return nr;
+
+    nleft = nr;
+    while(nleft > 0)
+      {
+        nw = fs::pwrite(dst_fd_,&buf_[nr - nleft],nleft,offset_ + (nr - nleft));
+        if((nw == -1) && (errno == EINTR))
+          continue;
+        if(nw == -1)
+          return -1;
+
+        nleft -= nw;
+      }
+
+    return nr;
+  }
+
+  static
+  int
+  pwrite_all(const int     fd_,
+             const char   *buf_,
+             const size_t  size_,
+             const off_t   offset_)
+  {
+    ssize_t nw;
+    size_t  nleft;
+
+    nleft = size_;
+    while(nleft > 0)
+      {
+        nw = fs::pwrite(fd_,&buf_[size_ - nleft],nleft,offset_ + (size_ - nleft));
+        if((nw == -1) && (errno == EINTR))
+          continue;
+        if(nw == -1)
+          return -1;
+
+        nleft -= nw;
+      }
+
+    return 0;
+  }
+}
+
 namespace fs
 {
+  MoveFile::MoveFile(const string &fusepath_)
+    : _fusepath(fusepath_),
+      _src_fd(-1),
+      _dst_fd(-1),
+      _flags(0),
+      _size(0),
+      _copied(0),
+      _next(0),
+      _error(0),
+      _registered(false),
+      _deferred_size(0),
+      _deferring(false)
+  {
+    pthread_mutex_init(&_dirty_lock,NULL);
+  }
+
+  MoveFile::~MoveFile()
+  {
+    if(_registered)
+      {
+        pthread_mutex_lock(&g_movefiles_lock);
+        g_movefiles.erase(_fusepath);
+        pthread_mutex_unlock(&g_movefiles_lock);
+      }
+
+    if(_src_fd != -1)
+      fs::close(_src_fd);
+    if(_dst_fd != -1)
+      fs::close(_dst_fd);
+    if(!_dst_temp.empty())
+      fs::unlink(_dst_temp);
+
+    pthread_mutex_destroy(&_dirty_lock);
+  }
+
   int
-  movefile(const vector<string> &basepaths,
-           const string         &fusepath,
-           const size_t          additional_size,
-           int                  &origfd)
+  MoveFile::prepare(const vector<string> &basepaths_,
+                    const size_t          additional_size_,
+                    const int             origfd_)
   {
     int rv;
-    int fdin;
-    int fdout;
-    int fdin_flags;
     string fusedir;
-    string fdin_path;
-    string fdout_path;
-    string fdout_temp;
-    struct stat fdin_st;
+    struct stat st;
+
+    rv = fs::fstat(origfd_,&st);
+    if(rv == -1)
+      return -1;
 
-    fdin = origfd;
+    _flags = fs::getfl(origfd_);
+    if(_flags == -1)
+      return -1;
 
-    rv = fs::fstat(fdin,&fdin_st);
+    rv = fs::findonfs(basepaths_,_fusepath,origfd_,_src_path);
     if(rv == -1)
       return -1;
 
-    fdin_flags = fs::getfl(fdin);
+    rv = fs::mfs(basepaths_,st.st_size + additional_size_,_dst_path);
     if(rv == -1)
       return -1;
 
-    rv = fs::findonfs(basepaths,fusepath,fdin,fdin_path);
+    fusedir = fs::path::dirname(&_fusepath);
+
+    rv = fs::clonepath(_src_path,_dst_path,fusedir);
     if(rv == -1)
       return -1;
 
-    fdin_st.st_size += additional_size;
-    rv = fs::mfs(basepaths,fdin_st.st_size,fdout_path);
+    fs::path::append(_src_path,_fusepath);
+    _src_fd = fs::open(_src_path,O_RDONLY);
+    if(_src_fd == -1)
+      return -1;
+
+    fs::path::append(_dst_path,_fusepath);
+    _dst_temp = _dst_path;
+    _dst_fd = fs::mkstemp(_dst_temp);
+    if(_dst_fd == -1)
+      {
+        _dst_temp.clear();
+        return -1;
+      }
+
+    _size = st.st_size;
+
+    pthread_mutex_lock(&g_movefiles_lock);
+    _registered = g_movefiles.insert(std::make_pair(_fusepath,this)).second;
+    pthread_mutex_unlock(&g_movefiles_lock);
+
+    return 0;
+  }
+
+  int
+  MoveFile::copy_range(off_t         offset_,
+                       size_t        size_,
+                       vector<char> &buf_)
+  {
+    ssize_t rv;
+    int64_t off_in;
+    int64_t off_out;
+    bool    use_copy_file_range;
+
+    use_copy_file_range = true;
+    while(size_ > 0)
+      {
+        if(use_copy_file_range)
+          {
+            off_in  = offset_;
+            off_out = offset_;
+            rv = fs::copy_file_range(_src_fd,&off_in,_dst_fd,&off_out,size_,0);
+            if((rv == -1) && l::copy_file_range_unsupported(errno))
+              {
+                use_copy_file_range = false;
+                continue;
+              }
+          }
+        else
+          {
+            rv = l::copy_rw(_src_fd,_dst_fd,offset_,size_,buf_);
+          }
+
+        if((rv == -1) && (errno == EINTR))
+          continue;
+        if(rv == -1)
+          return -1;
+        if(rv == 0)
+          break;
+
+        offset_ += rv;
+        size_   -= rv;
+        __atomic_fetch_add(&_copied,(uint64_t)rv,__ATOMIC_RELAXED);
+      }
+
+    return 0;
+  }
+
+  int
+  MoveFile::copy_chunks(void)
+  {
+    int rv;
+    int error;
+    off_t offset;
+    vector<char> buf;
+
+    while(__atomic_load_n(&_error,__ATOMIC_RELAXED) == 0)
+      {
+        offset = __atomic_fetch_add(&_next,
+                                    (uint64_t)MOVEFILE_CHUNK_SIZE,
+                                    __ATOMIC_RELAXED);
+        if(offset >= _size)
+          break;
+
+        rv = copy_range(offset,
+                        std::min((off_t)MOVEFILE_CHUNK_SIZE,_size - offset),
+                        buf);
+        if(rv == -1)
+          {
+            error = 0;
+            __atomic_compare_exchange_n(&_error,&error,errno,false,
+                                        __ATOMIC_RELAXED,__ATOMIC_RELAXED);
+            return -1;
+          }
+      }
+
+    return 0;
+  }
+
+  void *
+  MoveFile::copy_worker(void *movefile_)
+  {
+    reinterpret_cast<MoveFile*>(movefile_)->copy_chunks();
+
+    return NULL;
+  }
+
+  int
+  MoveFile::copy(void)
+  {
+    int rv;
+    size_t nthreads;
+    pthread_t threads[MOVEFILE_MAX_THREADS];
+
+    fs::fadvise_willneed(_src_fd,0,_size);
+    fs::fadvise_sequential(_src_fd,0,_size);
+
+    rv = fs::ficlone(_src_fd,_dst_fd);
+    if(rv != -1)
+      {
+        __atomic_store_n(&_copied,(uint64_t)_size,__ATOMIC_RELAXED);
+        return 0;
+      }
+
+    fs::fallocate(_dst_fd,0,0,_size);
+    rv = fs::ftruncate(_dst_fd,_size);
     if(rv == -1)
       return -1;
 
-    fusedir = fs::path::dirname(&fusepath);
+    nthreads = 1;
+    while((nthreads < MOVEFILE_MAX_THREADS) &&
+          (((off_t)nthreads * MOVEFILE_CHUNK_SIZE) < _size))
+      {
+        rv = pthread_create(&threads[nthreads],NULL,MoveFile::copy_worker,this);
+        if(rv != 0)
+          break;
+        nthreads++;
+      }
+
+    copy_chunks();
+
+    for(size_t i = 1; i < nthreads; i++)
+      pthread_join(threads[i],NULL);
+
+    // the joins order the workers' stores before this
+    if(_error != 0)
+      return (errno=_error,-1);
+
+    return 0;
+  }
+
+  void
+  MoveFile::dirty(const off_t  offset_,
+                  const size_t size_)
+  {
+    pthread_mutex_lock(&_dirty_lock);
+    _dirty.push_back(Range(offset_,size_));
+    pthread_mutex_unlock(&_dirty_lock);
+  }
+
+  /*
+    Deferred writes are only accepted while the source is out of
+    space and are bounded so a stuck move can't consume unbounded
+    memory. Once there are any, every later write to the file must be
+    deferred as well or waits so that finish() can apply them in
+    order.
+  */
+  int
+  MoveFile::defer(const char   *buf_,
+                  const size_t  count_,
+                  const off_t   offset_)
+  {
+    int rv;
+
+    rv = -1;
+    pthread_mutex_lock(&_dirty_lock);
+    if((_deferred_size + count_) <= MOVEFILE_DEFER_MAX)
+      {
+        _deferred.push_back(Deferred());
+        _deferred.back().dirty  = _dirty.size();
+        _deferred.back().offset = offset_;
+        _deferred.back().data.assign(buf_,buf_ + count_);
+        _deferred_size += count_;
+        __atomic_store_n(&_deferring,true,__ATOMIC_RELEASE);
+        rv = count_;
+      }
+    pthread_mutex_unlock(&_dirty_lock);
 
-    rv = fs::clonepath(fdin_path,fdout_path,fusedir);
+    if(rv == -1)
+      return (errno=ENOSPC,-1);
+
+    return rv;
+  }
+
+  bool
+  MoveFile::deferred(void) const
+  {
+    return __atomic_load_n(&_deferring,__ATOMIC_ACQUIRE);
+  }
+
+  // for when the move fails and the data has to go somewhere
+  int
+  MoveFile::write_deferred(const int fd_)
+  {
+    int rv;
+
+    for(size_t i = 0, ei = _deferred.size(); i != ei; i++)
+      {
+        const Deferred &d = _deferred[i];
+
+        rv = l::pwrite_all(fd_,&d.data[0],d.data.size(),d.offset);
+        if(rv == -1)
+          return -1;
+      }
+
+    return 0;
+  }
+
+  int
+  MoveFile::recopy(const size_t  begin_,
+                   const size_t  end_,
+                   const off_t   size_,
+                   vector<char> &buf_)
+  {
+    int rv;
+    off_t end;
+
+    std::sort(_dirty.begin() + begin_,_dirty.begin() + end_);
+    end = 0;
+    for(size_t i = begin_; i != end_; i++)
+      {
+        off_t offset = std::max(_dirty[i].first,end);
+
+        end = std::max(end,(off_t)(_dirty[i].first + _dirty[i].second));
+        if(end > size_)
+          end = size_;
+        if(offset >= end)
+          continue;
+
+        rv = copy_range(offset,end - offset,buf_);
+        if(rv == -1)
+          return -1;
+      }
+
+    return 0;
+  }
+
+  int
+  MoveFile::finish(const int origfd_)
+  {
+    int rv;
+    size_t begin;
+    vector<char> buf;
+    struct stat st;
+
+    rv = fs::fstat(_src_fd,&st);
     if(rv == -1)
       return -1;
 
-    fs::path::append(fdin_path,fusepath);
-    fdin = fs::open(fdin_path,O_RDONLY);
-    if(fdin == -1)
+    rv = fs::ftruncate(_dst_fd,st.st_size);
+    if(rv == -1)
       return -1;
 
-    fs::path::append(fdout_path,fusepath);
-    fdout_temp = fdout_path;
-    fdout = fs::mkstemp(fdout_temp);
-    if(fdout == -1)
+    if(st.st_size > _size)
+      {
+        rv = copy_range(_size,st.st_size - _size,buf);
+        if(rv == -1)
+          return -1;
+      }
+
+    begin = 0;
+    for(size_t i = 0, ei = _deferred.size(); i != ei; i++)
+      {
+        const Deferred &d = _deferred[i];
+
+        rv = recopy(begin,d.dirty,st.st_size,buf);
+        if(rv == -1)
+          return -1;
+
+        rv = l::pwrite_all(_dst_fd,&d.data[0],d.data.size(),d.offset);
+        if(rv == -1)
+          return -1;
+
+        begin = d.dirty;
+      }
+
+    rv = recopy(begin,_dirty.size(),st.st_size,buf);
+    if(rv == -1)
       return -1;
 
-    rv = fs::clonefile(fdin,fdout);
+    rv = fs::clonemetadata(_src_fd,_dst_fd);
     if(rv == -1)
-      goto cleanup;
+      return -1;
 
-    rv = fs::setfl(fdout,fdin_flags);
+    rv = fs::setfl(_dst_fd,_flags);
     if(rv == -1)
-      goto cleanup;
+      return -1;
 
-    rv = fs::rename(fdout_temp,fdout_path);
+    rv = fs::rename(_dst_temp,_dst_path);
     if(rv == -1)
-      goto cleanup;
+      return -1;
+    _dst_temp.clear();
 
     // should we care if it fails?
-    fs::unlink(fdin_path);
+    fs::unlink(_src_path);
 
-    std::swap(origfd,fdout);
-    fs::close(fdin);
-    fs::close(fdout);
+    // keeps the descriptor number stable for concurrent readers
+    rv = fs::dup2(_dst_fd,origfd_);
+    if(rv == -1)
+      return -1;
 
     return 0;
+  }
+
+  uint64_t
+  MoveFile::copied(void) const
+  {
+    return std::min(__atomic_load_n(&_copied,__ATOMIC_RELAXED),total());
+  }
+
+  uint64_t
+  MoveFile::total(void) const
+  {
+    return _size;
+  }
+
+  int
+  movefile_progress(const string &fusepath_,
+                    uint64_t     *copied_,
+                    uint64_t     *total_)
+  {
+    int rv;
+    MoveFileMap::const_iterator i;
+
+    rv = -1;
+    pthread_mutex_lock(&g_movefiles_lock);
+    i = g_movefiles.find(fusepath_);
+    if(i != g_movefiles.end())
+      {
+        *copied_ = i->second->copied();
+        *total_  = i->second->total();
+        rv = 0;
+      }
+    pthread_mutex_unlock(&g_movefiles_lock);
 
-  cleanup:
-    rv = errno;
-    if(fdin != -1)
-      fs::close(fdin);
-    if(fdout != -1)
-      fs::close(fdout);
-    fs::unlink(fdout_temp);
-    errno = rv;
-    return -1;
+    if(rv == -1)
+      return (errno=ENOENT,-1);
+
+    return 0;
   }
 }
@@ -17,13 +17,101 @@
 #pragma once
 
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
 namespace fs
 {
+  /*
+    Moves an open file to the branch with the most free space.
+
+    prepare() picks the target and creates a temporary file
+    there. copy() moves the bulk of the data, reflinking if possible
+    otherwise copying large extents in parallel, and doesn't need
+    writes to the file to be paused. Writes which succeed against
+    the source in the meantime should be reported via dirty(). Writes
+    which can't be made to the source for lack of space can be handed
+    to defer() instead. With writes paused finish() recopies the dirty
+    ranges and any growth, applies the deferred writes in the order
+    they were made relative to the dirty ranges, renames the copy into
+    place, and points the original descriptor at it.
+  */
+  class MoveFile
+  {
+  public:
+    typedef std::pair<off_t,size_t> Range;
+
+  public:
+    MoveFile(const std::string &fusepath);
+    ~MoveFile();
+
+  public:
+    int  prepare(const std::vector<std::string> &basepaths,
+                 const size_t                    additional_size,
+                 const int                       origfd);
+    int  copy(void);
+    void dirty(const off_t  offset,
+               const size_t size);
+    int  defer(const char   *buf,
+               const size_t  count,
+               const off_t   offset);
+    bool deferred(void) const;
+    int  write_deferred(const int fd);
+    int  finish(const int origfd);
+
+  public:
+    uint64_t copied(void) const;
+    uint64_t total(void) const;
+
+  private:
+    static void *copy_worker(void *movefile);
+    int copy_chunks(void);
+    int copy_range(off_t              offset,
+                   size_t             size,
+                   std::vector<char> &buf);
+    int recopy(const size_t       begin,
+               const size_t       end,
+               const off_t        size,
+               std::vector<char> &buf);
+
+  private:
+    struct Deferred
+    {
+      size_t            dirty;
+      off_t             offset;
+      std::vector<char> data;
+    };
+
+  private:
+    MoveFile(const MoveFile&);
+    MoveFile &operator=(const MoveFile&);
+
+  private:
+    std::string        _fusepath;
+    std::string        _src_path;
+    std::string        _dst_path;
+    std::string        _dst_temp;
+    int                _src_fd;
+    int                _dst_fd;
+    int                _flags;
+    off_t              _size;
+    uint64_t           _copied;
+    uint64_t           _next;
+    int                _error;
+    bool               _registered;
+    pthread_mutex_t       _dirty_lock;
+    std::vector<Range>    _dirty;
+    std::vector<Deferred> _deferred;
+    size_t                _deferred_size;
+    bool                  _deferring;
+  };
+
   int
-  movefile(const std::vector<std::string> &basepaths,
-           const std::string              &fusepath,
-           const size_t                    additional_size,
-           int                            &origfd);
+  movefile_progress(const std::string &fusepath,
+                    uint64_t          *copied,
+                    uint64_t          *total);
 }
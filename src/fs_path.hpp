@@ -16,15 +16,92 @@
 
 #pragma once
 
+#include "errno.hpp"
+
 #include <string>
 #include <vector>
 
+#include <limits.h>
+#include <string.h>
+
 namespace fs
 {
   namespace path
   {
     using std::string;
 
+    /*
+      Path built in a fixed size buffer. Used on hot paths in place of
+      std::string which allocates once a path outgrows the small string
+      optimization. A path of PATH_MAX or longer fails with
+      ENAMETOOLONG just as the kernel would fail it.
+    */
+    class Buf
+    {
+    public:
+      Buf()
+        : _len(0)
+      {
+        _buf[0] = '\0';
+      }
+
+    public:
+      int
+      make(const string &base_,
+           const char   *suffix_)
+      {
+        size_t suffixlen;
+
+        suffixlen = ::strlen(suffix_);
+        if((base_.size() + suffixlen) >= sizeof(_buf))
+          return (errno=ENAMETOOLONG,-1);
+
+        ::memcpy(_buf,base_.data(),base_.size());
+        ::memcpy(&_buf[base_.size()],suffix_,suffixlen + 1);
+        _len = (base_.size() + suffixlen);
+
+        return 0;
+      }
+
+      /* same semantics as fs::path::dirname. path_ may be c_str() */
+      int
+      dirname(const char *path_)
+      {
+        size_t i;
+
+        i = ::strlen(path_);
+        if(i >= sizeof(_buf))
+          return (errno=ENAMETOOLONG,-1);
+
+        while((i > 0) && (path_[i-1] == '/'))
+          i--;
+        while((i > 0) && (path_[i-1] != '/'))
+          i--;
+        while((i > 0) && (path_[i-1] == '/'))
+          i--;
+
+        if(path_ != _buf)
+          ::memcpy(_buf,path_,i);
+        _buf[i] = '\0';
+        _len    = i;
+
+        return 0;
+      }
+
+    public:
+      const char *c_str(void) const { return _buf; }
+      size_t      size(void)  const { return _len; }
+      bool        empty(void) const { return (_len == 0); }
+
+    private:
+      Buf(const Buf&);
+      Buf &operator=(const Buf&);
+
+    private:
+      size_t _len;
+      char   _buf[PATH_MAX];
+    };
+
     string dirname(const char *path_);
     string dirname(const string *path_);
 
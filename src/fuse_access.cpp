@@ -21,7 +21,6 @@
 #include "errno.hpp"
 #include "fs_base_access.hpp"
 #include "fs_path.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 using std::string;
@@ -38,16 +37,16 @@ namespace l
          const int             mask)
   {
     int rv;
-    string fullpath;
-    vector<const string*> basepaths;
+    fs::path::Buf fullpath;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = searchFunc(branches_,fusepath,minfreespace,basepaths);
     if(rv == -1)
       return -errno;
 
-    fullpath = fs::path::make(basepaths[0],fusepath);
-
-    rv = fs::eaccess(fullpath,mask);
+    rv = fullpath.make(*basepaths[0],fusepath);
+    if(rv == 0)
+      rv = fs::eaccess(fullpath.c_str(),mask);
 
     return ((rv == -1) ? -errno : 0);
   }
@@ -62,10 +61,10 @@ namespace FUSE
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
 
     return l::access(config.access,
-                     config.branches,
+                     *branches,
                      config.minfreespace,
                      fusepath,
                      mask);
@@ -16,10 +16,10 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
 #include "fs_base_chmod.hpp"
 #include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -32,38 +32,41 @@ using std::vector;
 
 namespace l
 {
+  struct chmod_args
+  {
+    const char *fusepath;
+    mode_t      mode;
+  };
+
   static
   int
-  chmod_loop_core(const string *basepath_,
-                  const char   *fusepath_,
-                  const mode_t  mode_,
-                  const int     error_)
+  chmod_task(const string *basepath_,
+             const void   *data_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
+    const chmod_args *args = static_cast<const chmod_args*>(data_);
 
-    fullpath = fs::path::make(basepath_,fusepath_);
-
-    rv = fs::chmod(fullpath,mode_);
+    rv = fullpath.make(*basepath_,args->fusepath);
+    if(rv == -1)
+      return -1;
 
-    return error::calc(rv,error_,errno);
+    return fs::chmod(fullpath.c_str(),args->mode);
   }
 
   static
   int
-  chmod_loop(const vector<const string*> &basepaths_,
-             const char                  *fusepath_,
-             const mode_t                 mode_)
+  chmod_loop(const Policy::Func::cstrptrvec &basepaths_,
+             const char                     *fusepath_,
+             const mode_t                    mode_,
+             const uint64_t                  fanout_)
   {
-    int error;
+    chmod_args args;
 
-    error = -1;
-    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
-      {
-        error = l::chmod_loop_core(basepaths_[i],fusepath_,mode_,error);
-      }
+    args.fusepath = fusepath_;
+    args.mode     = mode_;
 
-    return -error;
+    return -fanout::run(basepaths_,l::chmod_task,&args,fanout_);
   }
 
   static
@@ -72,16 +75,17 @@ namespace l
         const Branches       &branches_,
         const uint64_t        minfreespace_,
         const char           *fusepath_,
-        const mode_t          mode_)
+        const mode_t          mode_,
+        const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::chmod_loop(basepaths,fusepath_,mode_);
+    return l::chmod_loop(basepaths,fusepath_,mode_,fanout_);
   }
 }
 
@@ -91,15 +95,22 @@ namespace FUSE
   chmod(const char *fusepath_,
         mode_t      mode_)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = l::chmod(config.chmod,
+                  *branches,
+                  config.minfreespace,
+                  fusepath_,
+                  mode_,
+                  config.fanout);
+
+    config.enoattr_cache.invalidate(fusepath_);
 
-    return l::chmod(config.chmod,
-                    config.branches,
-                    config.minfreespace,
-                    fusepath_,
-                    mode_);
+    return rv;
   }
 }
@@ -16,10 +16,10 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
 #include "fs_base_chown.hpp"
 #include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -32,40 +32,44 @@ using std::vector;
 
 namespace l
 {
+  struct chown_args
+  {
+    const char *fusepath;
+    uid_t       uid;
+    gid_t       gid;
+  };
+
   static
   int
-  chown_loop_core(const string *basepath_,
-                  const char   *fusepath_,
-                  const uid_t   uid_,
-                  const gid_t   gid_,
-                  const int     error_)
+  chown_task(const string *basepath_,
+             const void   *data_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
+    const chown_args *args = static_cast<const chown_args*>(data_);
 
-    fullpath = fs::path::make(basepath_,fusepath_);
-
-    rv = fs::lchown(fullpath,uid_,gid_);
+    rv = fullpath.make(*basepath_,args->fusepath);
+    if(rv == -1)
+      return -1;
 
-    return error::calc(rv,error_,errno);
+    return fs::lchown(fullpath.c_str(),args->uid,args->gid);
   }
 
   static
   int
-  chown_loop(const vector<const string*> &basepaths_,
-             const char                  *fusepath_,
-             const uid_t                  uid_,
-             const gid_t                  gid_)
+  chown_loop(const Policy::Func::cstrptrvec &basepaths_,
+             const char                     *fusepath_,
+             const uid_t                     uid_,
+             const gid_t                     gid_,
+             const uint64_t                  fanout_)
   {
-    int error;
+    chown_args args;
 
-    error = -1;
-    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
-      {
-        error = l::chown_loop_core(basepaths_[i],fusepath_,uid_,gid_,error);
-      }
+    args.fusepath = fusepath_;
+    args.uid      = uid_;
+    args.gid      = gid_;
 
-    return -error;
+    return -fanout::run(basepaths_,l::chown_task,&args,fanout_);
   }
 
   static
@@ -75,16 +79,17 @@ namespace l
         const uint64_t        minfreespace_,
         const char           *fusepath_,
         const uid_t           uid_,
-        const gid_t           gid_)
+        const gid_t           gid_,
+        const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::chown_loop(basepaths,fusepath_,uid_,gid_);
+    return l::chown_loop(basepaths,fusepath_,uid_,gid_,fanout_);
   }
 }
 
@@ -95,16 +100,23 @@ namespace FUSE
         uid_t       uid_,
         gid_t       gid_)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
-
-    return l::chown(config.chown,
-                    config.branches,
-                    config.minfreespace,
-                    fusepath_,
-                    uid_,
-                    gid_);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = l::chown(config.chown,
+                  *branches,
+                  config.minfreespace,
+                  fusepath_,
+                  uid_,
+                  gid_,
+                  config.fanout);
+
+    config.enoattr_cache.invalidate(fusepath_);
+
+    return rv;
   }
 }
@@ -0,0 +1,225 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "config.hpp"
+#include "errno.hpp"
+#include "fileinfo.hpp"
+#include "fs_base_stat.hpp"
+#include "fs_copy_file_range.hpp"
+#include "fs_ficlone.hpp"
+#include "fs_movefile.hpp"
+#include "fs_splice.hpp"
+#include "getattr_coalesce.hpp"
+#include "linkcow.hpp"
+#include "moveonenospc.hpp"
+#include "rwlock.hpp"
+#include "writecombine.hpp"
+
+#include <fuse.h>
+
+#include <stdint.h>
+
+namespace l
+{
+  static
+  bool
+  out_of_space(const int error_)
+  {
+    return ((error_ == ENOSPC) ||
+            (error_ == EDQUOT));
+  }
+
+  static
+  bool
+  fallback_error(const int err_)
+  {
+    switch(err_)
+      {
+      case EINVAL:
+      case ENOSYS:
+      case ENOTTY:
+      case EXDEV:
+      case EOPNOTSUPP:
+#if ENOTSUP != EOPNOTSUPP
+      case ENOTSUP:
+#endif
+        return true;
+      }
+
+    return false;
+  }
+
+  /*
+    Copying all of a file to the start of one no larger than it is the
+    same as cloning it. This is what `cp` ends up asking for and on
+    filesystems with reflinks it's instant.
+  */
+  static
+  ssize_t
+  clone(const int    fd_in_,
+        const off_t  offset_in_,
+        const int    fd_out_,
+        const off_t  offset_out_,
+        const size_t size_)
+  {
+    int rv;
+    struct stat st_in;
+    struct stat st_out;
+
+    if((offset_in_ != 0) || (offset_out_ != 0))
+      return (errno=EINVAL,-1);
+
+    rv = fs::fstat(fd_in_,&st_in);
+    if(rv == -1)
+      return -1;
+
+    rv = fs::fstat(fd_out_,&st_out);
+    if(rv == -1)
+      return -1;
+
+    if((st_in.st_size == 0)                 ||
+       ((uint64_t)st_in.st_size > size_)    ||
+       (st_out.st_size > st_in.st_size))
+      return (errno=EINVAL,-1);
+
+    rv = fs::ficlone(fd_in_,fd_out_);
+    if(rv == -1)
+      return -1;
+
+    return st_in.st_size;
+  }
+
+  /*
+    Reflink if possible, then copy_file_range which handles copies
+    within a filesystem, and last splice through a pipe which works
+    across branches on different filesystems. The data never leaves
+    the kernel.
+  */
+  static
+  ssize_t
+  copy_file_range(const int    fd_in_,
+                  const off_t  offset_in_,
+                  const int    fd_out_,
+                  const off_t  offset_out_,
+                  const size_t size_,
+                  const int    flags_)
+  {
+    ssize_t rv;
+    int64_t offset_in;
+    int64_t offset_out;
+
+    rv = l::clone(fd_in_,offset_in_,fd_out_,offset_out_,size_);
+    if((rv != -1) || !l::fallback_error(errno))
+      return rv;
+
+    offset_in  = offset_in_;
+    offset_out = offset_out_;
+
+    rv = fs::copy_file_range(fd_in_,&offset_in,
+                             fd_out_,&offset_out,
+                             size_,flags_);
+    if((rv != -1) || !l::fallback_error(errno))
+      return rv;
+
+    return fs::splice_copy(fd_in_,&offset_in,
+                           fd_out_,&offset_out,
+                           size_);
+  }
+
+  static
+  ssize_t
+  copy_file_range_tracked(FileInfo     *fi_in_,
+                          const off_t   offset_in_,
+                          FileInfo     *fi_out_,
+                          const off_t   offset_out_,
+                          const size_t  size_,
+                          const int     flags_,
+                          const bool    moveonenospc_)
+  {
+    ssize_t rv;
+    const rwlock::ReadGuard guard(moveonenospc::write_lock(moveonenospc_,fi_out_));
+
+    // keeps later writes behind those queued on a move
+    if(moveonenospc::deferring(fi_out_))
+      return -ENOSPC;
+
+    rv = l::copy_file_range(fi_in_->fd,offset_in_,
+                            fi_out_->fd,offset_out_,
+                            size_,flags_);
+    if(rv == -1)
+      return -errno;
+
+    if((rv > 0) && (fi_out_->movefile != NULL))
+      fi_out_->movefile->dirty(offset_out_,rv);
+
+    return rv;
+  }
+}
+
+namespace FUSE
+{
+  ssize_t
+  copy_file_range(const char     *fusepath_in_,
+                  fuse_file_info *ffi_in_,
+                  off_t           offset_in_,
+                  const char     *fusepath_out_,
+                  fuse_file_info *ffi_out_,
+                  off_t           offset_out_,
+                  size_t          size_,
+                  int             flags_)
+  {
+    int rv;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+    FileInfo *fi_in  = reinterpret_cast<FileInfo*>(ffi_in_->fh);
+    FileInfo *fi_out = reinterpret_cast<FileInfo*>(ffi_out_->fh);
+
+    rv = writecombine::flush(fi_in,offset_in_,size_);
+    if(rv < 0)
+      return rv;
+
+    rv = writecombine::flush(fi_out);
+    if(rv < 0)
+      return rv;
+
+    rv = linkcow::prepare_write(fi_out);
+    if(rv < 0)
+      return rv;
+
+    moveonenospc::wait_for_deferred(fi_in);
+
+    rv = l::copy_file_range_tracked(fi_in,offset_in_,
+                                    fi_out,offset_out_,
+                                    size_,flags_,
+                                    config.moveonenospc);
+    if(l::out_of_space(-rv) && (config.moveonenospc || (fi_out->movefile != NULL)))
+      {
+        rv = moveonenospc::move(config,fi_out,NULL,size_,offset_out_);
+        if(rv == -1)
+          return -ENOSPC;
+
+        rv = l::copy_file_range_tracked(fi_in,offset_in_,
+                                        fi_out,offset_out_,
+                                        size_,flags_,
+                                        config.moveonenospc);
+      }
+
+    return rv;
+  }
+}
@@ -17,11 +17,13 @@
 #include "config.hpp"
 #include "errno.hpp"
 #include "fileinfo.hpp"
-#include "fs_acl.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_open.hpp"
+#include "fs_branch.hpp"
 #include "fs_clonepath.hpp"
 #include "fs_path.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
+#include "passthrough.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -36,36 +38,46 @@ namespace l
 {
   static
   int
-  create_core(const string &fullpath_,
+  create_core(const Branch &branch_,
+              const char   *fusepath_,
               mode_t        mode_,
               const mode_t  umask_,
               const int     flags_)
   {
-    if(!fs::acl::dir_has_defaults(fullpath_))
+    if(!fs::acl::dir_has_defaults_cache(branch_.path,fusepath_))
       mode_ &= ~umask_;
 
-    return fs::open(fullpath_,flags_,mode_);
+    return fs::branch::open(branch_,fusepath_,flags_,mode_);
   }
 
   static
   int
-  create_core(const string &createpath_,
-              const char   *fusepath_,
-              const mode_t  mode_,
-              const mode_t  umask_,
-              const int     flags_,
-              uint64_t     *fh_)
+  create_core(const Branch    &branch_,
+              const char      *fusepath_,
+              const mode_t     mode_,
+              const mode_t     umask_,
+              const int        flags_,
+              const OpenRules &open_rules_,
+              fuse_file_info  *ffi_,
+              bool            *passthrough_)
   {
     int rv;
-    string fullpath;
+    bool prealloc;
+    FileInfo *fi;
 
-    fullpath = fs::path::make(createpath_,fusepath_);
-
-    rv = l::create_core(fullpath,mode_,umask_,flags_);
+    rv = l::create_core(branch_,fusepath_,mode_,umask_,flags_);
     if(rv == -1)
       return -errno;
 
-    *fh_ = reinterpret_cast<uint64_t>(new FileInfo(rv,fusepath_));
+    prealloc = true;
+    open_rules_.apply(fusepath_,branch_.path.c_str(),flags_,rv,ffi_,&prealloc,passthrough_);
+
+    fi = new FileInfo(rv,fusepath_);
+    fi->direct_io = ffi_->direct_io;
+    if(!prealloc)
+      fi->prealloc.disable();
+
+    ffi_->fh = reinterpret_cast<uint64_t>(fi);
 
     return 0;
   }
@@ -80,34 +92,44 @@ namespace l
          const mode_t          mode_,
          const mode_t          umask_,
          const int             flags_,
-         uint64_t             *fh_)
+         const OpenRules      &open_rules_,
+         fuse_file_info       *ffi_,
+         bool                 *passthrough_)
   {
     int rv;
-    string fullpath;
-    string fusedirpath;
-    vector<const string*> createpaths;
-    vector<const string*> existingpaths;
+    fs::path::Buf fusedirpath;
+    const Branch *branch;
+    Policy::Func::cstrptrvec createpaths;
+    Policy::Func::cstrptrvec existingpaths;
 
-    fusedirpath = fs::path::dirname(fusepath_);
+    rv = fusedirpath.dirname(fusepath_);
+    if(rv == -1)
+      return -errno;
 
-    rv = searchFunc_(branches_,fusedirpath,minfreespace_,existingpaths);
+    rv = searchFunc_(branches_,fusedirpath.c_str(),minfreespace_,existingpaths);
     if(rv == -1)
       return -errno;
 
-    rv = createFunc_(branches_,fusedirpath,minfreespace_,createpaths);
+    rv = createFunc_(branches_,fusedirpath.c_str(),minfreespace_,createpaths);
     if(rv == -1)
       return -errno;
 
-    rv = fs::clonepath_as_root(*existingpaths[0],*createpaths[0],fusedirpath);
+    rv = fs::clonepath_as_root(*existingpaths[0],*createpaths[0],fusedirpath.c_str());
     if(rv == -1)
       return -errno;
 
-    return l::create_core(*createpaths[0],
+    branch = branches_.find(*createpaths[0]);
+    if(branch == NULL)
+      return -ENOENT;
+
+    return l::create_core(*branch,
                           fusepath_,
                           mode_,
                           umask_,
                           flags_,
-                          fh_);
+                          open_rules_,
+                          ffi_,
+                          passthrough_);
   }
 }
 
@@ -118,20 +140,37 @@ namespace FUSE
          mode_t          mode_,
          fuse_file_info *ffi_)
   {
+    int rv;
+    bool passthrough;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
+    passthrough     = passthrough::enabled(config);
     ffi_->direct_io = config.direct_io;
-    return l::create(config.getattr,
-                     config.create,
-                     config.branches,
-                     config.minfreespace,
-                     fusepath_,
-                     mode_,
-                     fc->umask,
-                     ffi_->flags,
-                     &ffi_->fh);
+    rv = l::create(config.getattr,
+                   config.create,
+                   *branches,
+                   config.minfreespace,
+                   fusepath_,
+                   mode_,
+                   fc->umask,
+                   ffi_->flags,
+                   config.open_rules,
+                   ffi_,
+                   &passthrough);
+    if(rv == 0)
+      passthrough::open(config,
+                        fc->fuse,
+                        reinterpret_cast<FileInfo*>(ffi_->fh),
+                        ffi_,
+                        passthrough);
+
+    config.enoent_cache.invalidate(fusepath_);
+    config.enoattr_cache.invalidate(fusepath_);
+
+    return rv;
   }
 }
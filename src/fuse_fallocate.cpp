@@ -14,9 +14,13 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+#include "config.hpp"
 #include "errno.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_fallocate.hpp"
+#include "getattr_coalesce.hpp"
+#include "linkcow.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -46,7 +50,23 @@ namespace FUSE
             off_t           len_,
             fuse_file_info *ffi_)
   {
-    FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
+    int rv;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    FileInfo           *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = linkcow::prepare_write(fi);
+    if(rv < 0)
+      return rv;
+
+    rv = writecombine::flush(fi);
+    if(rv < 0)
+      return rv;
+
+    // the client is managing space itself
+    fi->prealloc.trim(fi->fd);
+    fi->prealloc.disable();
 
     return l::fallocate(fi->fd,
                         mode_,
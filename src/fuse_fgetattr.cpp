@@ -18,6 +18,7 @@
 #include "fileinfo.hpp"
 #include "fs_base_stat.hpp"
 #include "fs_inode.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -47,8 +48,13 @@ namespace FUSE
            struct stat    *st_,
            fuse_file_info *ffi_)
   {
+    int rv;
     FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
 
+    rv = writecombine::flush(fi);
+    if(rv < 0)
+      return rv;
+
     return l::fgetattr(fi->fd,st_);
   }
 }
@@ -15,6 +15,7 @@
 */
 
 #include "errno.hpp"
+#include "fdshare.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_flock.hpp"
 
@@ -22,6 +23,23 @@
 
 namespace l
 {
+  // flock locks belong to the open file description so a shared
+  // descriptor gets a private one to lock through
+  static
+  int
+  lockfd(FileInfo *fi_)
+  {
+    int fd;
+
+    pthread_rwlock_wrlock(&fi_->lock);
+    if(fi_->flockfd == -1)
+      fi_->flockfd = fdshare::reopen(fi_->shared);
+    fd = fi_->flockfd;
+    pthread_rwlock_unlock(&fi_->lock);
+
+    return fd;
+  }
+
   static
   int
   flock(const int fd_,
@@ -42,8 +60,17 @@ namespace FUSE
         fuse_file_info *ffi_,
         int             op_)
   {
+    int fd;
     FileInfo* fi = reinterpret_cast<FileInfo*>(ffi_->fh);
 
-    return l::flock(fi->fd,op_);
+    fd = fi->fd;
+    if(fi->shared != NULL)
+      {
+        fd = l::lockfd(fi);
+        if(fd == -1)
+          return -errno;
+      }
+
+    return l::flock(fd,op_);
   }
 }
@@ -14,10 +14,14 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+#include "config.hpp"
 #include "errno.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_close.hpp"
 #include "fs_base_dup.hpp"
+#include "getattr_coalesce.hpp"
+#include "moveonenospc.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -45,7 +49,20 @@ namespace FUSE
   flush(const char     *fusepath_,
         fuse_file_info *ffi_)
   {
-    FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
+    int rv;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    FileInfo           *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = writecombine::flush(fi);
+    if(rv < 0)
+      return rv;
+
+    moveonenospc::wait_for_deferred(fi);
+    rv = moveonenospc::error(fi);
+    if(rv < 0)
+      return rv;
 
     return l::flush(fi->fd);
   }
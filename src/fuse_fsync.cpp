@@ -17,6 +17,8 @@
 #include "errno.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_fsync.hpp"
+#include "moveonenospc.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -47,8 +49,18 @@ namespace FUSE
         int             isdatasync_,
         fuse_file_info *ffi_)
   {
+    int rv;
     FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
 
+    rv = writecombine::flush(fi);
+    if(rv < 0)
+      return rv;
+
+    moveonenospc::wait_for_deferred(fi);
+    rv = moveonenospc::error(fi);
+    if(rv < 0)
+      return rv;
+
     return l::fsync(fi->fd,isdatasync_);
   }
 }
@@ -14,9 +14,13 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+#include "config.hpp"
 #include "errno.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_ftruncate.hpp"
+#include "getattr_coalesce.hpp"
+#include "linkcow.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -42,8 +46,24 @@ namespace FUSE
             off_t           size_,
             fuse_file_info *ffi_)
   {
-    FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
+    int rv;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    FileInfo           *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = linkcow::prepare_write(fi);
+    if(rv < 0)
+      return rv;
+
+    rv = writecombine::flush(fi);
+    if(rv < 0)
+      return rv;
+
+    fi->prealloc.trim(fi->fd);
+    rv = l::ftruncate(fi->fd,size_);
+    fi->prealloc.reset();
 
-    return l::ftruncate(fi->fd,size_);
+    return rv;
   }
 }
@@ -17,11 +17,12 @@
 #include "config.hpp"
 #include "errno.hpp"
 #include "fs_base_stat.hpp"
+#include "fs_branch.hpp"
 #include "fs_inode.hpp"
-#include "fs_path.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "symlinkify.hpp"
 #include "ugid.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -69,19 +70,29 @@ namespace l
           const time_t          symlinkify_timeout_)
   {
     int rv;
-    string fullpath;
-    vector<const string*> basepaths;
+    const Branch *branch;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = searchFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    fullpath = fs::path::make(basepaths[0],fusepath_);
+    branch = branches_.find(*basepaths[0]);
+    if(branch == NULL)
+      return -ENOENT;
 
-    rv = fs::lstat(fullpath,st_);
+    rv = fs::branch::lstat(*branch,fusepath_,st_);
     if(rv == -1)
       return -errno;
 
+    // other handles may have writes buffered by writecombine
+    if(S_ISREG(st_->st_mode) && writecombine::flush(st_->st_dev,st_->st_ino))
+      {
+        rv = fs::branch::lstat(*branch,fusepath_,st_);
+        if(rv == -1)
+          return -errno;
+      }
+
     if(symlinkify_ && symlinkify::can_be_symlink(*st_,symlinkify_timeout_))
       st_->st_mode = symlinkify::convert(st_->st_mode);
 
@@ -103,15 +114,39 @@ namespace FUSE
     if(fusepath_ == config.controlfile)
       return l::getattr_controlfile(st_);
 
-    const ugid::Set         ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard readlock(&config.branches_lock);
+    int rv;
+    uint64_t generation;
+    coalesce::Flight flight;
+    const bool coalescing = config.getattr_coalesce;
+
+    if(config.enoent_cache.has(fusepath_,fc->uid,fc->gid))
+      return -ENOENT;
+
+    generation = config.enoent_cache.generation();
+
+    if(coalescing &&
+       coalesce::getattr_begin(flight,fusepath_,fc->uid,fc->gid,&rv,st_))
+      return rv;
 
-    return l::getattr(config.getattr,
-                      config.branches,
+    {
+      const ugid::Set          ugid(fc->uid,fc->gid);
+      const Branches::Snapshot branches(config.branches);
+
+      rv = l::getattr(config.getattr,
+                      *branches,
                       config.minfreespace,
                       fusepath_,
                       st_,
                       config.symlinkify,
                       config.symlinkify_timeout);
+    }
+
+    if(coalescing)
+      coalesce::getattr_end(flight,rv,st_);
+
+    if(rv == -ENOENT)
+      config.enoent_cache.insert(fusepath_,fc->uid,fc->gid,generation);
+
+    return rv;
   }
 }
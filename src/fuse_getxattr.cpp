@@ -15,11 +15,18 @@
 */
 
 #include "config.hpp"
+#include "dirinfo.hpp"
+#include "dropcache.hpp"
 #include "errno.hpp"
+#include "fdshare.hpp"
+#include "fileinfo.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_getxattr.hpp"
+#include "fs_movefile.hpp"
 #include "fs_path.hpp"
 #include "fs_statvfs_cache.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
+#include "gidcache.hpp"
 #include "str.hpp"
 #include "ugid.hpp"
 #include "version.hpp"
@@ -52,7 +59,7 @@ namespace l
 
   static
   int
-  lgetxattr(const string &path_,
+  lgetxattr(const char   *path_,
             const char   *attrname_,
             void         *value_,
             const size_t  size_)
@@ -107,7 +114,9 @@ namespace l
   getxattr_controlfile_srcmounts(const Config &config_,
                                  string       &attrvalue_)
   {
-    attrvalue_ = config_.branches.to_string();
+    const Branches::Snapshot branches(config_.branches);
+
+    attrvalue_ = branches->to_string();
   }
 
   static
@@ -115,7 +124,9 @@ namespace l
   getxattr_controlfile_branches(const Config &config_,
                                 string       &attrvalue_)
   {
-    attrvalue_ = config_.branches.to_string(true);
+    const Branches::Snapshot branches(config_.branches);
+
+    attrvalue_ = branches->to_string(true);
   }
 
   static
@@ -130,6 +141,48 @@ namespace l
     attrvalue_ = os.str();
   }
 
+  static
+  void
+  getxattr_controlfile_pool(const uint64_t  allocated_,
+                            const uint64_t  inuse_,
+                            const uint64_t  cached_,
+                            string         &attrvalue_)
+  {
+    std::ostringstream os;
+
+    os << "allocated=" << allocated_
+       << " inuse="    << inuse_
+       << " cached="   << cached_;
+
+    attrvalue_ = os.str();
+  }
+
+  static
+  void
+  getxattr_controlfile_pool(const Pool &pool_,
+                            string     &attrvalue_)
+  {
+    l::getxattr_controlfile_pool(pool_.allocated(),
+                                 pool_.inuse(),
+                                 pool_.cached(),
+                                 attrvalue_);
+  }
+
+  static
+  void
+  getxattr_controlfile_pool(const enum fuse_pool_type  type_,
+                            string                    &attrvalue_)
+  {
+    struct fuse_pool_stats stats;
+
+    fuse_pool_get_stats(type_,&stats);
+
+    l::getxattr_controlfile_pool(stats.allocated,
+                                 stats.inuse,
+                                 stats.cached,
+                                 attrvalue_);
+  }
+
   static
   void
   getxattr_controlfile_double(const double  d_,
@@ -318,8 +371,16 @@ namespace l
           l::getxattr_controlfile_uint64_t(config.minfreespace,attrvalue);
         else if(attr[2] == "moveonenospc")
           l::getxattr_controlfile_bool(config.moveonenospc,attrvalue);
+        else if(attr[2] == "branch_fds")
+          l::getxattr_controlfile_bool(config.branch_fds,attrvalue);
         else if(attr[2] == "dropcacheonclose")
           l::getxattr_controlfile_bool(config.dropcacheonclose,attrvalue);
+        else if(attr[2] == "dropcacheonclose_minsize")
+          l::getxattr_controlfile_uint64_t(config.dropcacheonclose_minsize,attrvalue);
+        else if(attr[2] == "dropcacheonclose_streamed")
+          l::getxattr_controlfile_bool(config.dropcacheonclose_streamed,attrvalue);
+        else if(attr[2] == "dropcacheonclose_budget")
+          l::getxattr_controlfile_uint64_t(config.dropcacheonclose_budget,attrvalue);
         else if(attr[2] == "symlinkify")
           l::getxattr_controlfile_bool(config.symlinkify,attrvalue);
         else if(attr[2] == "symlinkify_timeout")
@@ -330,10 +391,16 @@ namespace l
           l::getxattr_controlfile_bool(config.ignorepponrename,attrvalue);
         else if(attr[2] == "security_capability")
           l::getxattr_controlfile_bool(config.security_capability,attrvalue);
+        else if(attr[2] == "getattr_coalesce")
+          l::getxattr_controlfile_bool(config.getattr_coalesce,attrvalue);
         else if(attr[2] == "xattr")
           l::getxattr_controlfile_errno(config.xattr,attrvalue);
         else if(attr[2] == "link_cow")
           l::getxattr_controlfile_bool(config.link_cow,attrvalue);
+        else if(attr[2] == "link_cow_lazy")
+          l::getxattr_controlfile_bool(config.link_cow_lazy,attrvalue);
+        else if(attr[2] == "share_rdonly_fds")
+          l::getxattr_controlfile_bool(config.share_rdonly_fds,attrvalue);
         else if(attr[2] == "statfs")
           l::getxattr_controlfile_statfs(config.statfs,attrvalue);
         else if(attr[2] == "statfs_ignore")
@@ -346,6 +413,18 @@ namespace l
           l::getxattr_controlfile_pid(attrvalue);
         else if(attr[2] == "direct_io")
           l::getxattr_controlfile_bool(config.direct_io,attrvalue);
+        else if(attr[2] == "open_rules")
+          attrvalue = config.open_rules.to_string();
+        else if(attr[2] == "passthrough")
+          l::getxattr_controlfile_bool(config.passthrough,attrvalue);
+        else if(attr[2] == "readahead")
+          l::getxattr_controlfile_uint64_t(config.readahead,attrvalue);
+        else if(attr[2] == "writecombine")
+          l::getxattr_controlfile_uint64_t(config.writecombine,attrvalue);
+        else if(attr[2] == "fanout")
+          l::getxattr_controlfile_uint64_t(config.fanout,attrvalue);
+        else if(attr[2] == "prealloc")
+          l::getxattr_controlfile_uint64_t(config.prealloc,attrvalue);
         break;
 
       case 4:
@@ -357,12 +436,54 @@ namespace l
           l::getxattr_controlfile_uint64_t(config.open_cache.timeout,attrvalue);
         else if((attr[2] == "cache") && (attr[3] == "statfs"))
           l::getxattr_controlfile_uint64_t(fs::statvfs_cache_timeout(),attrvalue);
+        else if((attr[2] == "cache") && (attr[3] == "acl"))
+          l::getxattr_controlfile_uint64_t(fs::acl::cache_timeout(),attrvalue);
+        else if((attr[2] == "cache") && (attr[3] == "groups"))
+          l::getxattr_controlfile_uint64_t(gidcache::timeout,attrvalue);
+        else if((attr[2] == "cache") && (attr[3] == "enoent"))
+          l::getxattr_controlfile_uint64_t(config.enoent_cache.timeout,attrvalue);
+        else if((attr[2] == "cache") && (attr[3] == "enoattr"))
+          l::getxattr_controlfile_uint64_t(config.enoattr_cache.timeout,attrvalue);
+        else if((attr[2] == "cache") && (attr[3] == "enoattr_names"))
+          attrvalue = config.enoattr_cache.names();
+        else if((attr[2] == "cache") && (attr[3] == "clonepath"))
+          l::getxattr_controlfile_uint64_t(config.clonepath_cache.timeout,attrvalue);
         else if((attr[2] == "cache") && (attr[3] == "attr"))
           l::getxattr_controlfile_cache_attr(attrvalue);
         else if((attr[2] == "cache") && (attr[3] == "entry"))
           l::getxattr_controlfile_cache_entry(attrvalue);
         else if((attr[2] == "cache") && (attr[3] == "negative_entry"))
           l::getxattr_controlfile_cache_negative_entry(attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "getattr"))
+          l::getxattr_controlfile_uint64_t(coalesce::getattr_calls(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "getattr_coalesced"))
+          l::getxattr_controlfile_uint64_t(coalesce::getattr_coalesced(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "fdshare_open"))
+          l::getxattr_controlfile_uint64_t(fdshare::open_count(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "fdshare_hits"))
+          l::getxattr_controlfile_uint64_t(fdshare::hits(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "dropcache_retained"))
+          l::getxattr_controlfile_uint64_t(dropcache::retained(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "groups_hits"))
+          l::getxattr_controlfile_uint64_t(gidcache::hits(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "groups_misses"))
+          l::getxattr_controlfile_uint64_t(gidcache::misses(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "groups_expired"))
+          l::getxattr_controlfile_uint64_t(gidcache::expired(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "groups_evicted"))
+          l::getxattr_controlfile_uint64_t(gidcache::evicted(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "setgroups_skipped"))
+          l::getxattr_controlfile_uint64_t(gidcache::setgroups_skipped(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "pool_fileinfo"))
+          l::getxattr_controlfile_pool(FileInfo::pool(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "pool_dirinfo"))
+          l::getxattr_controlfile_pool(DirInfo::pool(),attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "pool_req"))
+          l::getxattr_controlfile_pool(FUSE_POOL_REQ,attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "pool_dh"))
+          l::getxattr_controlfile_pool(FUSE_POOL_DH,attrvalue);
+        else if((attr[2] == "stats") && (attr[3] == "pool_path"))
+          l::getxattr_controlfile_pool(FUSE_POOL_PATH,attrvalue);
         break;
       }
 
@@ -421,11 +542,31 @@ namespace l
     return l::getxattr_from_string(buf,count,concated);
   }
 
+  static
+  int
+  getxattr_user_mergerfs_moveprogress(const char   *fusepath,
+                                      char         *buf,
+                                      const size_t  count)
+  {
+    int rv;
+    uint64_t copied;
+    uint64_t total;
+    std::ostringstream os;
+
+    rv = fs::movefile_progress(fusepath,&copied,&total);
+    if(rv == -1)
+      return -ENOATTR;
+
+    os << copied << '/' << total;
+
+    return l::getxattr_from_string(buf,count,os.str());
+  }
+
   static
   int
   getxattr_user_mergerfs(const string         &basepath,
                          const char           *fusepath,
-                         const string         &fullpath,
+                         const char           *fullpath,
                          const Branches       &branches_,
                          const char           *attrname,
                          char                 *buf,
@@ -443,6 +584,8 @@ namespace l
       return l::getxattr_from_string(buf,count,fullpath);
     else if(attr[2] == "allpaths")
       return l::getxattr_user_mergerfs_allpaths(branches_,fusepath,buf,count);
+    else if(attr[2] == "moveprogress")
+      return l::getxattr_user_mergerfs_moveprogress(fusepath,buf,count);
 
     return -ENOATTR;
   }
@@ -458,25 +601,27 @@ namespace l
            const size_t          count)
   {
     int rv;
-    string fullpath;
-    vector<const string*> basepaths;
+    fs::path::Buf fullpath;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = searchFunc(branches_,fusepath,minfreespace,basepaths);
     if(rv == -1)
       return -errno;
 
-    fullpath = fs::path::make(basepaths[0],fusepath);
+    rv = fullpath.make(*basepaths[0],fusepath);
+    if(rv == -1)
+      return -errno;
 
     if(str::isprefix(attrname,"user.mergerfs."))
       return l::getxattr_user_mergerfs(*basepaths[0],
                                        fusepath,
-                                       fullpath,
+                                       fullpath.c_str(),
                                        branches_,
                                        attrname,
                                        buf,
                                        count);
 
-    return l::lgetxattr(fullpath,attrname,buf,count);
+    return l::lgetxattr(fullpath.c_str(),attrname,buf,count);
   }
 }
 
@@ -504,15 +649,30 @@ namespace FUSE
     if(config.xattr)
       return -config.xattr;
 
-    const ugid::Set         ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard readlock(&config.branches_lock);
+    int rv;
+    uint64_t generation;
 
-    return l::getxattr(config.getxattr,
-                       config.branches,
+    if(config.enoattr_cache.has(fusepath,attrname))
+      return -ENOATTR;
+
+    generation = config.enoattr_cache.generation();
+
+    {
+      const ugid::Set          ugid(fc->uid,fc->gid);
+      const Branches::Snapshot branches(config.branches);
+
+      rv = l::getxattr(config.getxattr,
+                       *branches,
                        config.minfreespace,
                        fusepath,
                        attrname,
                        buf,
                        count);
+    }
+
+    if(rv == -ENOATTR)
+      config.enoattr_cache.insert(fusepath,attrname,generation);
+
+    return rv;
   }
 }
@@ -24,14 +24,24 @@ namespace FUSE
   void *
   init(fuse_conn_info *conn_)
   {
+    Config &config = Config::get_writable();
+
     ugid::init();
 
+    if(!(conn_->capable & FUSE_CAP_PASSTHROUGH) ||
+       config.nullrw                            ||
+       config.moveonenospc                      ||
+       config.link_cow)
+      config.passthrough = false;
+
     conn_->want |= FUSE_CAP_ASYNC_READ;
     conn_->want |= FUSE_CAP_ATOMIC_O_TRUNC;
     conn_->want |= FUSE_CAP_BIG_WRITES;
     conn_->want |= FUSE_CAP_DONT_MASK;
     conn_->want |= FUSE_CAP_IOCTL_DIR;
+    if(config.passthrough)
+      conn_->want |= FUSE_CAP_PASSTHROUGH;
 
-    return &Config::get_writable();
+    return &config;
   }
 }
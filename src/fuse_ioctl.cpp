@@ -23,7 +23,6 @@
 #include "fs_base_ioctl.hpp"
 #include "fs_base_open.hpp"
 #include "fs_path.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -130,7 +129,7 @@ namespace l
     int fd;
     int rv;
     string fullpath;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = searchFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
@@ -161,10 +160,10 @@ namespace l
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
 
     return l::ioctl_dir_base(config.open,
-                             config.branches,
+                             *branches,
                              config.minfreespace,
                              di->fusepath.c_str(),
                              cmd_,
@@ -19,8 +19,8 @@
 #include "fs_base_link.hpp"
 #include "fs_clonepath.hpp"
 #include "fs_path.hpp"
+#include "getattr_coalesce.hpp"
 #include "rv.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -55,11 +55,11 @@ namespace l
 
   static
   int
-  link_create_path_loop(const vector<const string*> &oldbasepaths_,
-                        const string                &newbasepath_,
-                        const char                  *oldfusepath_,
-                        const char                  *newfusepath_,
-                        const string                &newfusedirpath_)
+  link_create_path_loop(const Policy::Func::cstrptrvec &oldbasepaths_,
+                        const string                   &newbasepath_,
+                        const char                     *oldfusepath_,
+                        const char                     *newfusepath_,
+                        const string                   &newfusedirpath_)
   {
     int rv;
     int error;
@@ -90,8 +90,8 @@ namespace l
   {
     int rv;
     string newfusedirpath;
-    vector<const string*> oldbasepaths;
-    vector<const string*> newbasepaths;
+    Policy::Func::cstrptrvec oldbasepaths;
+    Policy::Func::cstrptrvec newbasepaths;
 
     rv = actionFunc_(branches_,oldfusepath_,minfreespace_,oldbasepaths);
     if(rv == -1)
@@ -120,7 +120,7 @@ namespace l
   {
     int rv;
     string newfusedirpath;
-    vector<const string*> newbasepath;
+    Policy::Func::cstrptrvec newbasepath;
 
     newfusedirpath = fs::path::dirname(newfusepath_);
 
@@ -172,13 +172,13 @@ namespace l
 
   static
   int
-  link_preserve_path_loop(Policy::Func::Search         searchFunc_,
-                          Policy::Func::Create         createFunc_,
-                          const Branches              &branches_,
-                          const uint64_t               minfreespace_,
-                          const char                  *oldfusepath_,
-                          const char                  *newfusepath_,
-                          const vector<const string*> &oldbasepaths_)
+  link_preserve_path_loop(Policy::Func::Search            searchFunc_,
+                          Policy::Func::Create            createFunc_,
+                          const Branches                 &branches_,
+                          const uint64_t                  minfreespace_,
+                          const char                     *oldfusepath_,
+                          const char                     *newfusepath_,
+                          const Policy::Func::cstrptrvec &oldbasepaths_)
   {
     int error;
 
@@ -206,7 +206,7 @@ namespace l
                      const char           *newfusepath_)
   {
     int rv;
-    vector<const string*> oldbasepaths;
+    Policy::Func::cstrptrvec oldbasepaths;
 
     rv = actionFunc_(branches_,oldfusepath_,minfreespace_,oldbasepaths);
     if(rv == -1)
@@ -225,25 +225,32 @@ namespace FUSE
   link(const char *from_,
        const char *to_)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     if(config.create->path_preserving() && !config.ignorepponrename)
-      return l::link_preserve_path(config.getattr,
-                                   config.link,
-                                   config.create,
-                                   config.branches,
-                                   config.minfreespace,
-                                   from_,
-                                   to_);
-
-    return l::link_create_path(config.link,
+      rv = l::link_preserve_path(config.getattr,
+                                 config.link,
+                                 config.create,
+                                 *branches,
+                                 config.minfreespace,
+                                 from_,
+                                 to_);
+    else
+      rv = l::link_create_path(config.link,
                                config.create,
-                               config.branches,
+                               *branches,
                                config.minfreespace,
                                from_,
                                to_);
+
+    config.enoent_cache.invalidate(to_);
+    config.enoattr_cache.invalidate(to_);
+
+    return rv;
   }
 }
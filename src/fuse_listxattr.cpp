@@ -20,7 +20,6 @@
 #include "errno.hpp"
 #include "fs_base_listxattr.hpp"
 #include "fs_path.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 #include "xattr.hpp"
 
@@ -44,28 +43,62 @@ namespace l
     string xattrs;
     const vector<string> strs =
       buildvector<string>
+      ("user.mergerfs.branch_fds")
       ("user.mergerfs.branches")
+      ("user.mergerfs.cache.acl")
       ("user.mergerfs.cache.attr")
+      ("user.mergerfs.cache.clonepath")
+      ("user.mergerfs.cache.enoattr")
+      ("user.mergerfs.cache.enoattr_names")
+      ("user.mergerfs.cache.enoent")
       ("user.mergerfs.cache.entry")
+      ("user.mergerfs.cache.groups")
       ("user.mergerfs.cache.negative_entry")
       ("user.mergerfs.cache.open")
       ("user.mergerfs.cache.statfs")
       ("user.mergerfs.direct_io")
       ("user.mergerfs.dropcacheonclose")
+      ("user.mergerfs.dropcacheonclose_budget")
+      ("user.mergerfs.dropcacheonclose_minsize")
+      ("user.mergerfs.dropcacheonclose_streamed")
+      ("user.mergerfs.fanout")
+      ("user.mergerfs.getattr_coalesce")
       ("user.mergerfs.ignorepponrename")
       ("user.mergerfs.link_cow")
+      ("user.mergerfs.link_cow_lazy")
       ("user.mergerfs.minfreespace")
       ("user.mergerfs.moveonenospc")
       ("user.mergerfs.nullrw")
+      ("user.mergerfs.open_rules")
+      ("user.mergerfs.passthrough")
       ("user.mergerfs.pid")
       ("user.mergerfs.policies")
+      ("user.mergerfs.prealloc")
+      ("user.mergerfs.readahead")
       ("user.mergerfs.security_capability")
+      ("user.mergerfs.share_rdonly_fds")
       ("user.mergerfs.srcmounts")
       ("user.mergerfs.statfs")
       ("user.mergerfs.statfs_ignore")
+      ("user.mergerfs.stats.dropcache_retained")
+      ("user.mergerfs.stats.fdshare_hits")
+      ("user.mergerfs.stats.fdshare_open")
+      ("user.mergerfs.stats.getattr")
+      ("user.mergerfs.stats.getattr_coalesced")
+      ("user.mergerfs.stats.groups_evicted")
+      ("user.mergerfs.stats.groups_expired")
+      ("user.mergerfs.stats.groups_hits")
+      ("user.mergerfs.stats.groups_misses")
+      ("user.mergerfs.stats.pool_dh")
+      ("user.mergerfs.stats.pool_dirinfo")
+      ("user.mergerfs.stats.pool_fileinfo")
+      ("user.mergerfs.stats.pool_path")
+      ("user.mergerfs.stats.pool_req")
+      ("user.mergerfs.stats.setgroups_skipped")
       ("user.mergerfs.symlinkify")
       ("user.mergerfs.symlinkify_timeout")
       ("user.mergerfs.version")
+      ("user.mergerfs.writecombine")
       ("user.mergerfs.xattr")
       ;
 
@@ -98,16 +131,16 @@ namespace l
             const size_t          size_)
   {
     int rv;
-    string fullpath;
-    vector<const string*> basepaths;
+    fs::path::Buf fullpath;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = searchFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    fullpath = fs::path::make(basepaths[0],fusepath_);
-
-    rv = fs::llistxattr(fullpath,list_,size_);
+    rv = fullpath.make(*basepaths[0],fusepath_);
+    if(rv == 0)
+      rv = fs::llistxattr(fullpath.c_str(),list_,size_);
 
     return ((rv == -1) ? -errno : rv);
   }
@@ -136,11 +169,11 @@ namespace FUSE
         return -config.xattr;
       }
 
-    const ugid::Set         ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard readlock(&config.branches_lock);
+    const ugid::Set          ugid(fc->uid,fc->gid);
+    const Branches::Snapshot branches(config.branches);
 
     return l::listxattr(config.listxattr,
-                        config.branches,
+                        *branches,
                         config.minfreespace,
                         fusepath_,
                         list_,
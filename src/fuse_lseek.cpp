@@ -0,0 +1,65 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "errno.hpp"
+#include "fileinfo.hpp"
+#include "fs_base_lseek.hpp"
+#include "writecombine.hpp"
+
+#include <fuse.h>
+
+namespace l
+{
+  static
+  off_t
+  lseek(const int   fd_,
+        const off_t offset_,
+        const int   whence_)
+  {
+    off_t rv;
+
+    rv = fs::lseek(fd_,offset_,whence_);
+
+    return ((rv == -1) ? -errno : rv);
+  }
+}
+
+namespace FUSE
+{
+  /*
+    The kernel handles SEEK_SET, SEEK_CUR, and SEEK_END itself and only
+    asks about SEEK_DATA and SEEK_HOLE. Those are answered by the
+    branch file. The handle's own offset is irrelevant as all IO is
+    done with explicit offsets.
+  */
+  off_t
+  lseek(const char     *fusepath_,
+        off_t           offset_,
+        int             whence_,
+        fuse_file_info *ffi_)
+  {
+    int rv;
+    FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
+
+    rv = writecombine::flush(fi);
+    if(rv < 0)
+      return rv;
+
+    return l::lseek(fi->fd,offset_,whence_);
+  }
+}
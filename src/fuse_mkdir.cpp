@@ -21,12 +21,13 @@
 
 #include "config.hpp"
 #include "errno.hpp"
-#include "fs_acl.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_mkdir.hpp"
+#include "fs_branch.hpp"
 #include "fs_clonepath.hpp"
 #include "fs_path.hpp"
+#include "getattr_coalesce.hpp"
 #include "rv.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 using std::string;
@@ -36,42 +37,44 @@ namespace l
 {
   static
   int
-  mkdir_core(const string &fullpath_,
+  mkdir_core(const Branch &branch_,
+             const char   *fusepath_,
              mode_t        mode_,
              const mode_t  umask_)
   {
-    if(!fs::acl::dir_has_defaults(fullpath_))
+    if(!fs::acl::dir_has_defaults_cache(branch_.path,fusepath_))
       mode_ &= ~umask_;
 
-    return fs::mkdir(fullpath_,mode_);
+    return fs::branch::mkdir(branch_,fusepath_,mode_);
   }
 
   static
   int
-  mkdir_loop_core(const string &createpath_,
+  mkdir_loop_core(const Branch *branch_,
                   const char   *fusepath_,
                   const mode_t  mode_,
                   const mode_t  umask_,
                   const int     error_)
   {
     int rv;
-    string fullpath;
 
-    fullpath = fs::path::make(createpath_,fusepath_);
+    if(branch_ == NULL)
+      return error::calc(-1,error_,ENOENT);
 
-    rv = l::mkdir_core(fullpath,mode_,umask_);
+    rv = l::mkdir_core(*branch_,fusepath_,mode_,umask_);
 
     return error::calc(rv,error_,errno);
   }
 
   static
   int
-  mkdir_loop(const string                &existingpath_,
-             const vector<const string*> &createpaths_,
-             const char                  *fusepath_,
-             const string                &fusedirpath_,
-             const mode_t                 mode_,
-             const mode_t                 umask_)
+  mkdir_loop(const Branches                 &branches_,
+             const string                   &existingpath_,
+             const Policy::Func::cstrptrvec &createpaths_,
+             const char                     *fusepath_,
+             const char                     *fusedirpath_,
+             const mode_t                    mode_,
+             const mode_t                    umask_)
   {
     int rv;
     int error;
@@ -83,7 +86,7 @@ namespace l
         if(rv == -1)
           error = error::calc(rv,error,errno);
         else
-          error = l::mkdir_loop_core(*createpaths_[i],
+          error = l::mkdir_loop_core(branches_.find(*createpaths_[i]),
                                      fusepath_,
                                      mode_,
                                      umask_,
@@ -104,24 +107,27 @@ namespace l
         const mode_t          umask_)
   {
     int rv;
-    string fusedirpath;
-    vector<const string*> createpaths;
-    vector<const string*> existingpaths;
+    fs::path::Buf fusedirpath;
+    Policy::Func::cstrptrvec createpaths;
+    Policy::Func::cstrptrvec existingpaths;
 
-    fusedirpath = fs::path::dirname(fusepath_);
+    rv = fusedirpath.dirname(fusepath_);
+    if(rv == -1)
+      return -errno;
 
-    rv = searchFunc_(branches_,fusedirpath,minfreespace_,existingpaths);
+    rv = searchFunc_(branches_,fusedirpath.c_str(),minfreespace_,existingpaths);
     if(rv == -1)
       return -errno;
 
-    rv = createFunc_(branches_,fusedirpath,minfreespace_,createpaths);
+    rv = createFunc_(branches_,fusedirpath.c_str(),minfreespace_,createpaths);
     if(rv == -1)
       return -errno;
 
-    return l::mkdir_loop(*existingpaths[0],
+    return l::mkdir_loop(branches_,
+                         *existingpaths[0],
                          createpaths,
                          fusepath_,
-                         fusedirpath,
+                         fusedirpath.c_str(),
                          mode_,
                          umask_);
   }
@@ -133,17 +139,24 @@ namespace FUSE
   mkdir(const char *fusepath_,
         mode_t      mode_)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
-
-    return l::mkdir(config.getattr,
-                    config.mkdir,
-                    config.branches,
-                    config.minfreespace,
-                    fusepath_,
-                    mode_,
-                    fc->umask);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = l::mkdir(config.getattr,
+                  config.mkdir,
+                  *branches,
+                  config.minfreespace,
+                  fusepath_,
+                  mode_,
+                  fc->umask);
+
+    config.enoent_cache.invalidate(fusepath_);
+    config.enoattr_cache.invalidate(fusepath_);
+
+    return rv;
   }
 }
@@ -16,12 +16,12 @@
 
 #include "config.hpp"
 #include "errno.hpp"
-#include "fs_acl.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_mknod.hpp"
 #include "fs_clonepath.hpp"
 #include "fs_path.hpp"
+#include "getattr_coalesce.hpp"
 #include "rv.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -37,12 +37,14 @@ namespace l
   static
   inline
   int
-  mknod_core(const string &fullpath_,
+  mknod_core(const string &createpath_,
+             const char   *fusepath_,
+             const char   *fullpath_,
              mode_t        mode_,
              const mode_t  umask_,
              const dev_t   dev_)
   {
-    if(!fs::acl::dir_has_defaults(fullpath_))
+    if(!fs::acl::dir_has_defaults_cache(createpath_,fusepath_))
       mode_ &= ~umask_;
 
     return fs::mknod(fullpath_,mode_,dev_);
@@ -58,24 +60,24 @@ namespace l
                   const int     error_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
 
-    fullpath = fs::path::make(&createpath_,fusepath_);
-
-    rv = l::mknod_core(fullpath,mode_,umask_,dev_);
+    rv = fullpath.make(createpath_,fusepath_);
+    if(rv == 0)
+      rv = l::mknod_core(createpath_,fusepath_,fullpath.c_str(),mode_,umask_,dev_);
 
     return error::calc(rv,error_,errno);
   }
 
   static
   int
-  mknod_loop(const string                &existingpath_,
-             const vector<const string*> &createpaths_,
-             const char                  *fusepath_,
-             const string                &fusedirpath_,
-             const mode_t                 mode_,
-             const mode_t                 umask_,
-             const dev_t                  dev_)
+  mknod_loop(const string                   &existingpath_,
+             const Policy::Func::cstrptrvec &createpaths_,
+             const char                     *fusepath_,
+             const char                     *fusedirpath_,
+             const mode_t                    mode_,
+             const mode_t                    umask_,
+             const dev_t                     dev_)
   {
     int rv;
     int error;
@@ -107,22 +109,24 @@ namespace l
         const dev_t           dev_)
   {
     int rv;
-    string fusedirpath;
-    vector<const string*> createpaths;
-    vector<const string*> existingpaths;
+    fs::path::Buf fusedirpath;
+    Policy::Func::cstrptrvec createpaths;
+    Policy::Func::cstrptrvec existingpaths;
 
-    fusedirpath = fs::path::dirname(fusepath_);
+    rv = fusedirpath.dirname(fusepath_);
+    if(rv == -1)
+      return -errno;
 
-    rv = searchFunc_(branches_,fusedirpath,minfreespace_,existingpaths);
+    rv = searchFunc_(branches_,fusedirpath.c_str(),minfreespace_,existingpaths);
     if(rv == -1)
       return -errno;
 
-    rv = createFunc_(branches_,fusedirpath,minfreespace_,createpaths);
+    rv = createFunc_(branches_,fusedirpath.c_str(),minfreespace_,createpaths);
     if(rv == -1)
       return -errno;
 
     return l::mknod_loop(*existingpaths[0],createpaths,
-                         fusepath_,fusedirpath,
+                         fusepath_,fusedirpath.c_str(),
                          mode_,umask_,dev_);
   }
 }
@@ -134,18 +138,25 @@ namespace FUSE
         mode_t      mode_,
         dev_t       rdev_)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
-
-    return l::mknod(config.getattr,
-                    config.mknod,
-                    config.branches,
-                    config.minfreespace,
-                    fusepath_,
-                    mode_,
-                    fc->umask,
-                    rdev_);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = l::mknod(config.getattr,
+                  config.mknod,
+                  *branches,
+                  config.minfreespace,
+                  fusepath_,
+                  mode_,
+                  fc->umask,
+                  rdev_);
+
+    config.enoent_cache.invalidate(fusepath_);
+    config.enoattr_cache.invalidate(fusepath_);
+
+    return rv;
   }
 }
@@ -16,12 +16,15 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fdshare.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_open.hpp"
+#include "fs_branch.hpp"
 #include "fs_cow.hpp"
 #include "fs_path.hpp"
+#include "getattr_coalesce.hpp"
+#include "passthrough.hpp"
 #include "policy_cache.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -36,25 +39,57 @@ namespace l
 {
   static
   int
-  open_core(const string &basepath_,
-            const char   *fusepath_,
-            const int     flags_,
-            const bool    link_cow_,
-            uint64_t     *fh_)
+  open_core(const Branch    &branch_,
+            const char      *fusepath_,
+            const int        flags_,
+            const bool       link_cow_,
+            const bool       link_cow_lazy_,
+            const bool       share_rdonly_fds_,
+            const OpenRules &open_rules_,
+            fuse_file_info  *ffi_,
+            bool            *passthrough_)
   {
     int fd;
+    bool prealloc;
+    bool deferred;
     string fullpath;
-
-    fullpath = fs::path::make(basepath_,fusepath_);
-
-    if(link_cow_ && fs::cow::is_eligible(fullpath.c_str(),flags_))
-      fs::cow::break_link(fullpath.c_str());
-
-    fd = fs::open(fullpath,flags_);
+    FileInfo *fi;
+    fdshare::Entry *shared;
+
+    deferred = false;
+    if(link_cow_ && fs::cow::is_eligible(flags_))
+      {
+        fullpath = fs::path::make(branch_.path,fusepath_);
+        if(fs::cow::is_eligible(fullpath.c_str(),flags_))
+          {
+            // O_TRUNC modifies the file on open so can't wait
+            if(link_cow_lazy_ && !(flags_ & O_TRUNC))
+              deferred = true;
+            else
+              fs::cow::break_link(fullpath.c_str());
+          }
+      }
+
+    shared = NULL;
+    if(share_rdonly_fds_ && ((flags_ & O_ACCMODE) == O_RDONLY))
+      fd = fdshare::open(branch_,fusepath_,flags_,&shared);
+    else
+      fd = fs::branch::open(branch_,fusepath_,flags_);
     if(fd == -1)
       return -errno;
 
-    *fh_ = reinterpret_cast<uint64_t>(new FileInfo(fd,fusepath_));
+    prealloc = true;
+    open_rules_.apply(fusepath_,branch_.path.c_str(),flags_,fd,ffi_,&prealloc,passthrough_);
+
+    fi = new FileInfo(fd,fusepath_);
+    fi->direct_io = ffi_->direct_io;
+    fi->shared    = shared;
+    if(!prealloc)
+      fi->prealloc.disable();
+    if(deferred)
+      fi->cow = new fs::cow::Deferred(fullpath,flags_);
+
+    ffi_->fh = reinterpret_cast<uint64_t>(fi);
 
     return 0;
   }
@@ -68,16 +103,33 @@ namespace l
        const char           *fusepath_,
        const int             flags_,
        const bool            link_cow_,
-       uint64_t             *fh_)
+       const bool            link_cow_lazy_,
+       const bool            share_rdonly_fds_,
+       const OpenRules      &open_rules_,
+       fuse_file_info       *ffi_,
+       bool                 *passthrough_)
   {
     int rv;
-    string basepath;
+    const Branch *branch;
+    const string *basepath;
 
     rv = cache(searchFunc_,branches_,fusepath_,minfreespace_,&basepath);
     if(rv == -1)
       return -errno;
 
-    return l::open_core(basepath,fusepath_,flags_,link_cow_,fh_);
+    branch = branches_.find(*basepath);
+    if(branch == NULL)
+      return -ENOENT;
+
+    return l::open_core(*branch,
+                        fusepath_,
+                        flags_,
+                        link_cow_,
+                        link_cow_lazy_,
+                        share_rdonly_fds_,
+                        open_rules_,
+                        ffi_,
+                        passthrough_);
   }
 }
 
@@ -87,19 +139,37 @@ namespace FUSE
   open(const char     *fusepath_,
        fuse_file_info *ffi_)
   {
+    int rv;
+    bool passthrough;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    // O_TRUNC changes the size
+    const coalesce::Mutation mutation(config.getattr_coalesce &&
+                                      (ffi_->flags & O_TRUNC));
 
+    passthrough     = passthrough::enabled(config);
     ffi_->direct_io = config.direct_io;
-    return l::open(config.open,
-                   config.open_cache,
-                   config.branches,
-                   config.minfreespace,
-                   fusepath_,
-                   ffi_->flags,
-                   config.link_cow,
-                   &ffi_->fh);
+    rv = l::open(config.open,
+                 config.open_cache,
+                 *branches,
+                 config.minfreespace,
+                 fusepath_,
+                 ffi_->flags,
+                 config.link_cow,
+                 config.link_cow_lazy,
+                 config.share_rdonly_fds,
+                 config.open_rules,
+                 ffi_,
+                 &passthrough);
+    if(rv == 0)
+      passthrough::open(config,
+                        fc->fuse,
+                        reinterpret_cast<FileInfo*>(ffi_->fh),
+                        ffi_,
+                        passthrough);
+
+    return rv;
   }
 }
@@ -14,9 +14,12 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+#include "config.hpp"
 #include "errno.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_read.hpp"
+#include "moveonenospc.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -68,10 +71,22 @@ namespace FUSE
        off_t           offset_,
        fuse_file_info *ffi_)
   {
+    int rv;
     FileInfo *fi;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
 
     fi = reinterpret_cast<FileInfo*>(ffi_->fh);
 
+    moveonenospc::wait_for_deferred(fi);
+
+    rv = writecombine::flush(fi,offset_,count_);
+    if(rv < 0)
+      return rv;
+
+    fi->readahead.read(fi->fd,offset_,count_,config.readahead);
+    fi->cachetracker.read(offset_,count_);
+
     if(ffi_->direct_io)
       return l::read_direct_io(fi->fd,buf_,count_,offset_);
     return l::read_regular(fi->fd,buf_,count_,offset_);
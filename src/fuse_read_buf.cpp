@@ -14,8 +14,11 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+#include "config.hpp"
 #include "errno.hpp"
 #include "fileinfo.hpp"
+#include "moveonenospc.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -60,7 +63,19 @@ namespace FUSE
            off_t            offset_,
            fuse_file_info  *ffi_)
   {
-    FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
+    int rv;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    FileInfo           *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+
+    moveonenospc::wait_for_deferred(fi);
+
+    rv = writecombine::flush(fi,offset_,size_);
+    if(rv < 0)
+      return rv;
+
+    fi->readahead.read(fi->fd,offset_,size_,config.readahead);
+    fi->cachetracker.read(offset_,size_);
 
     return l::read_buf(fi->fd,
                      bufp_,
@@ -28,7 +28,6 @@
 #include "fs_inode.hpp"
 #include "fs_path.hpp"
 #include "hashset.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -108,9 +107,9 @@ namespace FUSE
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
 
-    return l::readdir(config.branches,
+    return l::readdir(*branches,
                       di->fusepath.c_str(),
                       buf_,
                       filler_);
@@ -19,7 +19,6 @@
 #include "fs_base_readlink.hpp"
 #include "fs_base_stat.hpp"
 #include "fs_path.hpp"
-#include "rwlock.hpp"
 #include "symlinkify.hpp"
 #include "ugid.hpp"
 
@@ -34,7 +33,7 @@ namespace l
 {
   static
   int
-  readlink_core_standard(const string &fullpath_,
+  readlink_core_standard(const char   *fullpath_,
                          char         *buf_,
                          const size_t  size_)
 
@@ -52,7 +51,7 @@ namespace l
 
   static
   int
-  readlink_core_symlinkify(const string &fullpath_,
+  readlink_core_symlinkify(const char   *fullpath_,
                            char         *buf_,
                            const size_t  size_,
                            const time_t  symlinkify_timeout_)
@@ -67,7 +66,7 @@ namespace l
     if(!symlinkify::can_be_symlink(st,symlinkify_timeout_))
       return l::readlink_core_standard(fullpath_,buf_,size_);
 
-    strncpy(buf_,fullpath_.c_str(),size_);
+    strncpy(buf_,fullpath_,size_);
 
     return 0;
   }
@@ -81,14 +80,17 @@ namespace l
                 const bool    symlinkify_,
                 const time_t  symlinkify_timeout_)
   {
-    string fullpath;
+    int rv;
+    fs::path::Buf fullpath;
 
-    fullpath = fs::path::make(basepath_,fusepath_);
+    rv = fullpath.make(*basepath_,fusepath_);
+    if(rv == -1)
+      return -errno;
 
     if(symlinkify_)
-      return l::readlink_core_symlinkify(fullpath,buf_,size_,symlinkify_timeout_);
+      return l::readlink_core_symlinkify(fullpath.c_str(),buf_,size_,symlinkify_timeout_);
 
-    return l::readlink_core_standard(fullpath,buf_,size_);
+    return l::readlink_core_standard(fullpath.c_str(),buf_,size_);
   }
 
   static
@@ -103,7 +105,7 @@ namespace l
            const time_t          symlinkify_timeout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = searchFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
@@ -124,10 +126,10 @@ namespace FUSE
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
 
     return l::readlink(config.readlink,
-                       config.branches,
+                       *branches,
                        config.minfreespace,
                        fusepath_,
                        buf_,
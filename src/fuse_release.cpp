@@ -15,10 +15,15 @@
 */
 
 #include "config.hpp"
+#include "dropcache.hpp"
 #include "errno.hpp"
+#include "fdshare.hpp"
 #include "fileinfo.hpp"
 #include "fs_base_close.hpp"
-#include "fs_base_fadvise.hpp"
+#include "getattr_coalesce.hpp"
+#include "moveonenospc.hpp"
+#include "passthrough.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
@@ -28,22 +33,39 @@ namespace l
 {
   static
   int
-  release(FileInfo   *fi_,
-          const bool  dropcacheonclose_)
+  release(const Config &config_,
+          FileInfo     *fi_,
+          const int     flags_)
   {
-    // according to Feh of nocache calling it once doesn't always work
-    // https://github.com/Feh/nocache
-    if(dropcacheonclose_)
+    int rv;
+
+    // nothing more can be done with the data if this fails
+    rv = writecombine::flush(fi_);
+    writecombine::release(fi_);
+
+    moveonenospc::wait(fi_);
+    if(rv == 0)
+      rv = moveonenospc::error(fi_);
+
+    fi_->prealloc.trim(fi_->fd);
+
+    if(fi_->flockfd != -1)
+      fs::close(fi_->flockfd);
+
+    // other opens are still reading through it
+    if((fi_->shared != NULL) && !fdshare::release(fi_->shared))
       {
-        fs::fadvise_dontneed(fi_->fd);
-        fs::fadvise_dontneed(fi_->fd);
+        delete fi_;
+        return rv;
       }
 
+    dropcache::release(config_,fi_,flags_);
+
     fs::close(fi_->fd);
 
     delete fi_;
 
-    return 0;
+    return rv;
   }
 }
 
@@ -53,12 +75,16 @@ namespace FUSE
   release(const char     *fusepath_,
           fuse_file_info *ffi_)
   {
-    const Config &config = Config::get();
-    FileInfo     *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    FileInfo           *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     if(config.open_cache.timeout)
       config.open_cache.cleanup(10);
 
-    return l::release(fi,config.dropcacheonclose);
+    passthrough::release(fc->fuse,fi);
+
+    return l::release(config,fi,ffi_->flags);
   }
 }
@@ -16,10 +16,11 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_removexattr.hpp"
 #include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -32,39 +33,41 @@ using std::vector;
 
 namespace l
 {
+  struct removexattr_args
+  {
+    const char *fusepath;
+    const char *attrname;
+  };
+
   static
   int
-  removexattr_loop_core(const string *basepath_,
-                        const char   *fusepath_,
-                        const char   *attrname_,
-                        const int     error_)
+  removexattr_task(const string *basepath_,
+                   const void   *data_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
+    const removexattr_args *args = static_cast<const removexattr_args*>(data_);
 
-    fullpath = fs::path::make(basepath_,fusepath_);
-
-    rv = fs::lremovexattr(fullpath,attrname_);
+    rv = fullpath.make(*basepath_,args->fusepath);
+    if(rv == -1)
+      return -1;
 
-    return error::calc(rv,error_,errno);
+    return fs::lremovexattr(fullpath.c_str(),args->attrname);
   }
 
   static
   int
-  removexattr_loop(const vector<const string*> &basepaths_,
-                   const char                  *fusepath_,
-                   const char                  *attrname_)
+  removexattr_loop(const Policy::Func::cstrptrvec &basepaths_,
+                   const char                     *fusepath_,
+                   const char                     *attrname_,
+                   const uint64_t                  fanout_)
   {
-    int error;
+    removexattr_args args;
 
-    error = -1;
+    args.fusepath = fusepath_;
+    args.attrname = attrname_;
 
-    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
-      {
-        error = l::removexattr_loop_core(basepaths_[i],fusepath_,attrname_,error);
-      }
-
-    return -error;
+    return -fanout::run(basepaths_,l::removexattr_task,&args,fanout_);
   }
 
   static
@@ -73,16 +76,17 @@ namespace l
               const Branches       &branches_,
               const uint64_t        minfreespace_,
               const char           *fusepath_,
-              const char           *attrname_)
+              const char           *attrname_,
+              const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::removexattr_loop(basepaths,fusepath_,attrname_);
+    return l::removexattr_loop(basepaths,fusepath_,attrname_,fanout_);
   }
 }
 
@@ -94,19 +98,27 @@ namespace FUSE
   {
     const fuse_context *fc     = fuse_get_context();
     const Config       &config = Config::get(fc);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     if(fusepath_ == config.controlfile)
       return -ENOATTR;
     if(config.xattr)
       return -config.xattr;
 
-    const ugid::Set         ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard readlock(&config.branches_lock);
+    int rv;
+    const ugid::Set          ugid(fc->uid,fc->gid);
+    const Branches::Snapshot branches(config.branches);
+
+    rv = l::removexattr(config.removexattr,
+                        *branches,
+                        config.minfreespace,
+                        fusepath_,
+                        attrname_,
+                        config.fanout);
+
+    fs::acl::cache_invalidate_xattr(fusepath_,attrname_);
+    config.enoattr_cache.invalidate(fusepath_);
 
-    return l::removexattr(config.removexattr,
-                          config.branches,
-                          config.minfreespace,
-                          fusepath_,
-                          attrname_);
+    return rv;
   }
 }
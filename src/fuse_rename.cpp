@@ -21,22 +21,23 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_remove.hpp"
 #include "fs_base_rename.hpp"
+#include "fs_branch.hpp"
 #include "fs_clonepath.hpp"
 #include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 
 using std::string;
 using std::vector;
-using std::set;
 
 static
 bool
-member(const vector<const string*> &haystack,
-       const string                &needle)
+member(const Policy::Func::cstrptrvec &haystack,
+       const string                   &needle)
 {
   for(size_t i = 0, ei = haystack.size(); i != ei; i++)
     {
@@ -47,52 +48,150 @@ member(const vector<const string*> &haystack,
   return false;
 }
 
+/*
+  Rename is planned up front from the single search of where the
+  source exists: branches which have it are renamed, those which
+  don't have any existing destination removed. The renames run
+  concurrently via fanout and, only if at least one succeeded, the
+  removals (plus the sources on branches where the rename failed) are
+  done concurrently as well. The result is the same as the serial
+  loop: success if any branch was renamed, otherwise the last error.
+*/
+
+struct rename_args
+{
+  const Policy::Func::Search     *searchfunc;
+  const Policy::Func::Create     *createfunc;
+  const Branches                 *branches;
+  uint64_t                        minfreespace;
+  const Policy::Func::cstrptrvec *basepaths;
+  const string                   *newbasepath;
+  string                          newfusedirpath;
+  const char                     *oldfusepath;
+  const char                     *newfusepath;
+  vector<char>                   *failed;
+};
+
 static
 void
-_remove(const vector<string> &toremove)
+_set_failed(const rename_args *args,
+            const string      *basepath)
+{
+  for(size_t i = 0, ei = args->basepaths->size(); i != ei; i++)
+    {
+      if((*args->basepaths)[i] == basepath)
+        (*args->failed)[i] = true;
+    }
+}
+
+static
+int
+_remove_task(const string *basepath,
+             const void   *data)
 {
-  for(size_t i = 0, ei = toremove.size(); i != ei; i++)
-    fs::remove(toremove[i]);
+  string fullpath;
+  const char *fusepath = static_cast<const char*>(data);
+
+  fullpath = fs::path::make(*basepath,fusepath);
+
+  fs::remove(fullpath);
+
+  return 0;
 }
 
 static
 void
-_rename_create_path_core(const vector<const string*> &oldbasepaths,
-                         const string                &oldbasepath,
-                         const string                &newbasepath,
-                         const char                  *oldfusepath,
-                         const char                  *newfusepath,
-                         const string                &newfusedirpath,
-                         int                         &error,
-                         vector<string>              &tounlink)
+_remove(const rename_args              *args,
+        const Policy::Func::cstrptrvec &newpaths,
+        const uint64_t                  fanout_)
 {
-  int rv;
-  bool ismember;
-  string oldfullpath;
-  string newfullpath;
+  Policy::Func::cstrptrvec oldpaths;
 
-  ismember = member(oldbasepaths,oldbasepath);
-  if(ismember)
+  for(size_t i = 0, ei = args->basepaths->size(); i != ei; i++)
     {
-      rv = fs::clonepath_as_root(newbasepath,oldbasepath,newfusedirpath);
-      if(rv != -1)
-        {
-          oldfullpath = fs::path::make(oldbasepath,oldfusepath);
-          newfullpath = fs::path::make(oldbasepath,newfusepath);
-
-          rv = fs::rename(oldfullpath,newfullpath);
-        }
-
-      error = error::calc(rv,error,errno);
-      if(rv == -1)
-        tounlink.push_back(oldfullpath);
+      if((*args->failed)[i])
+        oldpaths.push_back((*args->basepaths)[i]);
     }
-  else
+
+  fanout::run(newpaths,_remove_task,args->newfusepath,fanout_);
+  fanout::run(oldpaths,_remove_task,args->oldfusepath,fanout_);
+}
+
+static
+int
+_rename(const Branches             &branches_,
+        const uint64_t              minfreespace,
+        const char                 *oldfusepath,
+        const char                 *newfusepath,
+        const string               *newbasepath,
+        const Policy::Func::Search *searchFunc,
+        const Policy::Func::Create *createFunc,
+        Policy::Func::cstrptrvec   &oldbasepaths,
+        fanout::Func                task,
+        const uint64_t              fanout_)
+{
+  int error;
+  vector<char> failed;
+  rename_args args;
+  Policy::Func::cstrptrvec torename;
+  Policy::Func::cstrptrvec toremove;
+
+  for(size_t i = 0, ei = branches_.size(); i != ei; i++)
     {
-      newfullpath = fs::path::make(oldbasepath,newfusepath);
+      const string *basepath = &branches_[i].path;
 
-      tounlink.push_back(newfullpath);
+      if(member(oldbasepaths,*basepath))
+        torename.push_back(basepath);
+      else
+        toremove.push_back(basepath);
     }
+
+  if(torename.empty())
+    return -ENOENT;
+
+  failed.resize(torename.size(),false);
+
+  args.searchfunc     = searchFunc;
+  args.createfunc     = createFunc;
+  args.branches       = &branches_;
+  args.minfreespace   = minfreespace;
+  args.basepaths      = &torename;
+  args.newbasepath    = newbasepath;
+  args.newfusedirpath = fs::path::dirname(newfusepath);
+  args.oldfusepath    = oldfusepath;
+  args.newfusepath    = newfusepath;
+  args.failed         = &failed;
+
+  error = fanout::run(torename,task,&args,fanout_);
+  if(error == 0)
+    _remove(&args,toremove,fanout_);
+
+  return -error;
+}
+
+static
+int
+_rename_create_path_task(const string *oldbasepath,
+                         const void   *data)
+{
+  int rv;
+  const Branch *oldbranch;
+  const rename_args *args = static_cast<const rename_args*>(data);
+
+  oldbranch = args->branches->find(*oldbasepath);
+  if(oldbranch == NULL)
+    return (errno=ENOENT,-1);
+
+  // the source is left alone if the rename was never attempted
+  rv = fs::clonepath_as_root(*args->newbasepath,*oldbasepath,args->newfusedirpath);
+  if(rv == -1)
+    return -1;
+
+  rv = fs::branch::rename(*oldbranch,args->oldfusepath,args->newfusepath);
+  if(rv == -1)
+    _set_failed(args,oldbasepath);
+
+  return rv;
 }
 
 static
@@ -102,14 +201,13 @@ _rename_create_path(Policy::Func::Search  searchFunc,
                     const Branches       &branches_,
                     const uint64_t        minfreespace,
                     const char           *oldfusepath,
-                    const char           *newfusepath)
+                    const char           *newfusepath,
+                    const uint64_t        fanout_)
 {
   int rv;
-  int error;
   string newfusedirpath;
-  vector<string> toremove;
-  vector<const string*> newbasepath;
-  vector<const string*> oldbasepaths;
+  Policy::Func::cstrptrvec newbasepath;
+  Policy::Func::cstrptrvec oldbasepaths;
 
   rv = actionFunc(branches_,oldfusepath,minfreespace,oldbasepaths);
   if(rv == -1)
@@ -121,23 +219,12 @@ _rename_create_path(Policy::Func::Search  searchFunc,
   if(rv == -1)
     return -errno;
 
-  error = -1;
-  for(size_t i = 0, ei = branches_.size(); i != ei; i++)
-    {
-      const string &oldbasepath = branches_[i].path;
-
-      _rename_create_path_core(oldbasepaths,
-                               oldbasepath,*newbasepath[0],
-                               oldfusepath,newfusepath,
-                               newfusedirpath,
-                               error,toremove);
-    }
-
-
-  if(error == 0)
-    _remove(toremove);
-
-  return -error;
+  return _rename(branches_,minfreespace,
+                 oldfusepath,newfusepath,
+                 newbasepath[0],&searchFunc,NULL,
+                 oldbasepaths,
+                 _rename_create_path_task,
+                 fanout_);
 }
 
 static
@@ -149,7 +236,7 @@ _clonepath(Policy::Func::Search  searchFunc,
            const string         &fusedirpath)
 {
   int rv;
-  vector<const string*> srcbasepath;
+  Policy::Func::cstrptrvec srcbasepath;
 
   rv = searchFunc(branches_,fusedirpath,minfreespace,srcbasepath);
   if(rv == -1)
@@ -172,7 +259,7 @@ _clonepath_if_would_create(Policy::Func::Search  searchFunc,
 {
   int rv;
   string newfusedirpath;
-  vector<const string*> newbasepath;
+  Policy::Func::cstrptrvec newbasepath;
 
   newfusedirpath = fs::path::dirname(newfusepath);
 
@@ -187,49 +274,33 @@ _clonepath_if_would_create(Policy::Func::Search  searchFunc,
 }
 
 static
-void
-_rename_preserve_path_core(Policy::Func::Search         searchFunc,
-                           Policy::Func::Create         createFunc,
-                           const Branches              &branches_,
-                           const uint64_t               minfreespace,
-                           const vector<const string*> &oldbasepaths,
-                           const string                &oldbasepath,
-                           const char                  *oldfusepath,
-                           const char                  *newfusepath,
-                           int                         &error,
-                           vector<string>              &toremove)
+int
+_rename_preserve_path_task(const string *oldbasepath,
+                           const void   *data)
 {
   int rv;
-  bool ismember;
+  string oldfullpath;
   string newfullpath;
+  const rename_args *args = static_cast<const rename_args*>(data);
 
-  newfullpath = fs::path::make(oldbasepath,newfusepath);
+  oldfullpath = fs::path::make(*oldbasepath,args->oldfusepath);
+  newfullpath = fs::path::make(*oldbasepath,args->newfusepath);
 
-  ismember = member(oldbasepaths,oldbasepath);
-  if(ismember)
+  rv = fs::rename(oldfullpath,newfullpath);
+  if((rv == -1) && (errno == ENOENT))
     {
-      string oldfullpath;
-
-      oldfullpath = fs::path::make(oldbasepath,oldfusepath);
-
-      rv = fs::rename(oldfullpath,newfullpath);
-      if((rv == -1) && (errno == ENOENT))
-        {
-          rv = _clonepath_if_would_create(searchFunc,createFunc,
-                                          branches_,minfreespace,
-                                          oldbasepath,oldfusepath,newfusepath);
-          if(rv == 0)
-            rv = fs::rename(oldfullpath,newfullpath);
-        }
-
-      error = error::calc(rv,error,errno);
-      if(rv == -1)
-        toremove.push_back(oldfullpath);
-    }
-  else
-    {
-      toremove.push_back(newfullpath);
+      rv = _clonepath_if_would_create(*args->searchfunc,*args->createfunc,
+                                      *args->branches,args->minfreespace,
+                                      *oldbasepath,
+                                      args->oldfusepath,args->newfusepath);
+      if(rv == 0)
+        rv = fs::rename(oldfullpath,newfullpath);
     }
+
+  if(rv == -1)
+    _set_failed(args,oldbasepath);
+
+  return rv;
 }
 
 static
@@ -240,33 +311,22 @@ _rename_preserve_path(Policy::Func::Search  searchFunc,
                       const Branches       &branches_,
                       const uint64_t        minfreespace,
                       const char           *oldfusepath,
-                      const char           *newfusepath)
+                      const char           *newfusepath,
+                      const uint64_t        fanout_)
 {
   int rv;
-  int error;
-  vector<string> toremove;
-  vector<const string*> oldbasepaths;
+  Policy::Func::cstrptrvec oldbasepaths;
 
   rv = actionFunc(branches_,oldfusepath,minfreespace,oldbasepaths);
   if(rv == -1)
     return -errno;
 
-  error = -1;
-  for(size_t i = 0, ei = branches_.size(); i != ei; i++)
-    {
-      const string &oldbasepath = branches_[i].path;
-
-      _rename_preserve_path_core(searchFunc,createFunc,
-                                 branches_,minfreespace,
-                                 oldbasepaths,oldbasepath,
-                                 oldfusepath,newfusepath,
-                                 error,toremove);
-    }
-
-  if(error == 0)
-    _remove(toremove);
-
-  return -error;
+  return _rename(branches_,minfreespace,
+                 oldfusepath,newfusepath,
+                 NULL,&searchFunc,&createFunc,
+                 oldbasepaths,
+                 _rename_preserve_path_task,
+                 fanout_);
 }
 
 namespace FUSE
@@ -275,27 +335,41 @@ namespace FUSE
   rename(const char *oldpath,
          const char *newpath)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     config.open_cache.erase(oldpath);
 
     if(config.create->path_preserving() && !config.ignorepponrename)
-      return _rename_preserve_path(config.getattr,
-                                   config.rename,
-                                   config.create,
-                                   config.branches,
-                                   config.minfreespace,
-                                   oldpath,
-                                   newpath);
-
-    return _rename_create_path(config.getattr,
+      rv = _rename_preserve_path(config.getattr,
+                                 config.rename,
+                                 config.create,
+                                 *branches,
+                                 config.minfreespace,
+                                 oldpath,
+                                 newpath,
+                                 config.fanout);
+    else
+      rv = _rename_create_path(config.getattr,
                                config.rename,
-                               config.branches,
+                               *branches,
                                config.minfreespace,
                                oldpath,
-                               newpath);
+                               newpath,
+                               config.fanout);
+
+    config.enoent_cache.invalidate_tree(newpath);
+    config.clonepath_cache.invalidate_tree(oldpath);
+    config.clonepath_cache.invalidate_tree(newpath);
+    fs::acl::cache_invalidate_tree(oldpath);
+    fs::acl::cache_invalidate_tree(newpath);
+    config.enoattr_cache.invalidate_tree(oldpath);
+    config.enoattr_cache.invalidate_tree(newpath);
+
+    return rv;
   }
 }
@@ -16,10 +16,11 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_rmdir.hpp"
 #include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -35,35 +36,27 @@ namespace l
 {
   static
   int
-  rmdir_loop_core(const string *basepath_,
-                  const char   *fusepath_,
-                  const int     error_)
+  rmdir_task(const string *basepath_,
+             const void   *data_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
+    const char *fusepath = static_cast<const char*>(data_);
 
-    fullpath = fs::path::make(basepath_,fusepath_);
-
-    rv = fs::rmdir(fullpath);
+    rv = fullpath.make(*basepath_,fusepath);
+    if(rv == -1)
+      return -1;
 
-    return error::calc(rv,error_,errno);
+    return fs::rmdir(fullpath.c_str());
   }
 
-
   static
   int
-  rmdir_loop(const vector<const string*> &basepaths_,
-             const char                  *fusepath_)
+  rmdir_loop(const Policy::Func::cstrptrvec &basepaths_,
+             const char                     *fusepath_,
+             const uint64_t                  fanout_)
   {
-    int error;
-
-    error = -1;
-    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
-      {
-        error = l::rmdir_loop_core(basepaths_[i],fusepath_,error);
-      }
-
-    return -error;
+    return -fanout::run(basepaths_,l::rmdir_task,fusepath_,fanout_);
   }
 
   static
@@ -71,16 +64,17 @@ namespace l
   rmdir(Policy::Func::Action  actionFunc_,
         const Branches       &branches_,
         const uint64_t        minfreespace_,
-        const char           *fusepath_)
+        const char           *fusepath_,
+        const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::rmdir_loop(basepaths,fusepath_);
+    return l::rmdir_loop(basepaths,fusepath_,fanout_);
   }
 }
 
@@ -89,14 +83,23 @@ namespace FUSE
   int
   rmdir(const char *fusepath_)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readguard(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = l::rmdir(config.rmdir,
+                  *branches,
+                  config.minfreespace,
+                  fusepath_,
+                  config.fanout);
+
+    config.clonepath_cache.invalidate_tree(fusepath_);
+    fs::acl::cache_invalidate_tree(fusepath_);
+    config.enoattr_cache.invalidate_tree(fusepath_);
 
-    return l::rmdir(config.rmdir,
-                    config.branches,
-                    config.minfreespace,
-                    fusepath_);
+    return rv;
   }
 }
@@ -16,13 +16,15 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_base_setxattr.hpp"
 #include "fs_glob.hpp"
 #include "fs_path.hpp"
 #include "fs_statvfs_cache.hpp"
+#include "getattr_coalesce.hpp"
+#include "gidcache.hpp"
 #include "num.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
 #include "str.hpp"
 #include "ugid.hpp"
 
@@ -64,39 +66,81 @@ namespace l
 
   static
   int
-  setxattr_srcmounts(const string     &attrval,
-                     const int         flags,
-                     Branches         &branches_,
-                     pthread_rwlock_t &branches_lock)
+  update_branches(Branches     *branches_,
+                  const string &instruction_,
+                  const string &values_)
   {
-    const rwlock::WriteGuard wrg(&branches_lock);
+    if(instruction_ == "+")
+      branches_->add_end(values_);
+    else if(instruction_ == "+<")
+      branches_->add_begin(values_);
+    else if(instruction_ == "+>")
+      branches_->add_end(values_);
+    else if(instruction_ == "-")
+      branches_->erase_fnmatch(values_);
+    else if(instruction_ == "-<")
+      branches_->erase_begin();
+    else if(instruction_ == "->")
+      branches_->erase_end();
+    else if(instruction_ == "=")
+      branches_->set(values_);
+    else if(instruction_.empty())
+      branches_->set(values_);
+    else
+      return -EINVAL;
+
+    return 0;
+  }
 
+  /*
+    Readers are never blocked. The change is made to a copy of the
+    current branches which is then published. Only concurrent changes
+    are serialized.
+  */
+  static
+  int
+  setxattr_srcmounts(const string       &attrval,
+                     const int           flags,
+                     rcu::Ptr<Branches> &branches_,
+                     pthread_mutex_t    &branches_lock,
+                     const bool          branch_fds_,
+                     ENOENTCache        &enoent_cache_,
+                     ENOATTRCache       &enoattr_cache_)
+  {
+    int rv;
     string instruction;
     string values;
+    Branches *branches;
 
     if((flags & XATTR_CREATE) == XATTR_CREATE)
       return -EEXIST;
 
     l::split_attrval(attrval,instruction,values);
 
-    if(instruction == "+")
-      branches_.add_end(values);
-    else if(instruction == "+<")
-      branches_.add_begin(values);
-    else if(instruction == "+>")
-      branches_.add_end(values);
-    else if(instruction == "-")
-      branches_.erase_fnmatch(values);
-    else if(instruction == "-<")
-      branches_.erase_begin();
-    else if(instruction == "->")
-      branches_.erase_end();
-    else if(instruction == "=")
-      branches_.set(values);
-    else if(instruction.empty())
-      branches_.set(values);
+    pthread_mutex_lock(&branches_lock);
+
+    branches = new Branches(*branches_.load());
+    rv = l::update_branches(branches,instruction,values);
+    if(rv < 0)
+      {
+        delete branches;
+      }
     else
-      return -EINVAL;
+      {
+        if(branch_fds_)
+          branches->open_fds();
+        Branches::publish(branches_,branches);
+      }
+
+    pthread_mutex_unlock(&branches_lock);
+
+    if(rv < 0)
+      return rv;
+
+    enoent_cache_.clear();
+    enoattr_cache_.clear();
+    ClonePathCache::instance().clear();
+    fs::acl::cache_clear();
 
     return 0;
   }
@@ -174,6 +218,25 @@ namespace l
     return 0;
   }
 
+  /*
+    Options which need mergerfs to see the reads and writes. Files
+    already in passthrough can't be taken out of it and the kernel
+    fails any other open of them so they can't change while
+    passthrough is negotiated.
+  */
+  static
+  int
+  setxattr_rw_bool(const Config &config_,
+                   const string &attrval_,
+                   const int     flags_,
+                   bool         &value_)
+  {
+    if(config_.passthrough)
+      return -EBUSY;
+
+    return l::setxattr_bool(attrval_,flags_,value_);
+  }
+
   static
   int
   setxattr_xattr(const string &attrval_,
@@ -249,6 +312,8 @@ namespace l
 
     if(funcname == "open")
       config.open_cache.clear();
+    else if(funcname == "getattr")
+      config.enoent_cache.clear();
 
     rv = config.set_func_policy(funcname,attrval);
     if(rv == -1)
@@ -270,7 +335,10 @@ namespace l
       return -EEXIST;
 
     if(categoryname == "search")
-      config.open_cache.clear();
+      {
+        config.open_cache.clear();
+        config.enoent_cache.clear();
+      }
 
     rv = config.set_category_policy(categoryname,attrval);
     if(rv == -1)
@@ -294,6 +362,24 @@ namespace l
     return rv;
   }
 
+  static
+  int
+  setxattr_acl_cache_timeout(const string &attrval_,
+                             const int     flags_)
+  {
+    int rv;
+    uint64_t timeout;
+
+    rv = l::setxattr_uint64_t(attrval_,flags_,timeout);
+    if(rv >= 0)
+      {
+        fs::acl::cache_timeout(timeout);
+        fs::acl::cache_clear();
+      }
+
+    return rv;
+  }
+
   static
   int
   setxattr_controlfile_cache_attr(const string &attrval_,
@@ -339,6 +425,83 @@ namespace l
     return rv;
   }
 
+  static
+  int
+  setxattr_controlfile_cache_enoent(Config       &config_,
+                                    const string &attrval_,
+                                    const int     flags_)
+  {
+    int rv;
+
+    rv = l::setxattr_uint64_t(attrval_,flags_,config_.enoent_cache.timeout);
+    if(rv >= 0)
+      config_.enoent_cache.clear();
+
+    return rv;
+  }
+
+  static
+  int
+  setxattr_controlfile_cache_enoattr(Config       &config_,
+                                     const string &attrval_,
+                                     const int     flags_)
+  {
+    int rv;
+
+    rv = l::setxattr_uint64_t(attrval_,flags_,config_.enoattr_cache.timeout);
+    if(rv >= 0)
+      config_.enoattr_cache.clear();
+
+    return rv;
+  }
+
+  static
+  int
+  setxattr_controlfile_cache_enoattr_names(Config       &config_,
+                                           const string &attrval_,
+                                           const int     flags_)
+  {
+    if((flags_ & XATTR_CREATE) == XATTR_CREATE)
+      return -EEXIST;
+
+    config_.enoattr_cache.names(attrval_);
+
+    return 0;
+  }
+
+  static
+  int
+  setxattr_controlfile_cache_clonepath(Config       &config_,
+                                       const string &attrval_,
+                                       const int     flags_)
+  {
+    int rv;
+
+    rv = l::setxattr_uint64_t(attrval_,flags_,config_.clonepath_cache.timeout);
+    if(rv >= 0)
+      config_.clonepath_cache.clear();
+
+    return rv;
+  }
+
+  static
+  int
+  setxattr_open_rules(const string &attrval_,
+                      const int     flags_,
+                      OpenRules    &open_rules_)
+  {
+    int rv;
+
+    if((flags_ & XATTR_CREATE) == XATTR_CREATE)
+      return -EEXIST;
+
+    rv = open_rules_.from_string(attrval_);
+    if(rv == -1)
+      return -errno;
+
+    return 0;
+  }
+
   static
   int
   setxattr_controlfile(Config       &config,
@@ -357,24 +520,43 @@ namespace l
           return l::setxattr_srcmounts(attrval,
                                        flags,
                                        config.branches,
-                                       config.branches_lock);
+                                       config.branches_lock,
+                                       config.branch_fds,
+                                       config.enoent_cache,
+                                       config.enoattr_cache);
         else if(attr[2] == "branches")
           return l::setxattr_srcmounts(attrval,
                                        flags,
                                        config.branches,
-                                       config.branches_lock);
+                                       config.branches_lock,
+                                       config.branch_fds,
+                                       config.enoent_cache,
+                                       config.enoattr_cache);
         else if(attr[2] == "minfreespace")
           return l::setxattr_uint64_t(attrval,
                                       flags,
                                       config.minfreespace);
         else if(attr[2] == "moveonenospc")
-          return l::setxattr_bool(attrval,
-                                  flags,
-                                  config.moveonenospc);
+          return l::setxattr_rw_bool(config,
+                                     attrval,
+                                     flags,
+                                     config.moveonenospc);
         else if(attr[2] == "dropcacheonclose")
           return l::setxattr_bool(attrval,
                                   flags,
                                   config.dropcacheonclose);
+        else if(attr[2] == "dropcacheonclose_minsize")
+          return l::setxattr_uint64_t(attrval,
+                                      flags,
+                                      config.dropcacheonclose_minsize);
+        else if(attr[2] == "dropcacheonclose_streamed")
+          return l::setxattr_bool(attrval,
+                                  flags,
+                                  config.dropcacheonclose_streamed);
+        else if(attr[2] == "dropcacheonclose_budget")
+          return l::setxattr_uint64_t(attrval,
+                                      flags,
+                                      config.dropcacheonclose_budget);
         else if(attr[2] == "symlinkify")
           return l::setxattr_bool(attrval,
                                   flags,
@@ -391,14 +573,27 @@ namespace l
           return l::setxattr_bool(attrval,
                                   flags,
                                   config.security_capability);
+        else if(attr[2] == "getattr_coalesce")
+          return l::setxattr_bool(attrval,
+                                  flags,
+                                  config.getattr_coalesce);
         else if(attr[2] == "xattr")
           return l::setxattr_xattr(attrval,
                                    flags,
                                    config.xattr);
         else if(attr[2] == "link_cow")
+          return l::setxattr_rw_bool(config,
+                                     attrval,
+                                     flags,
+                                     config.link_cow);
+        else if(attr[2] == "link_cow_lazy")
           return l::setxattr_bool(attrval,
                                   flags,
-                                  config.link_cow);
+                                  config.link_cow_lazy);
+        else if(attr[2] == "share_rdonly_fds")
+          return l::setxattr_bool(attrval,
+                                  flags,
+                                  config.share_rdonly_fds);
         else if(attr[2] == "statfs")
           return l::setxattr_statfs(attrval,
                                     flags,
@@ -411,6 +606,26 @@ namespace l
           return l::setxattr_bool(attrval,
                                   flags,
                                   config.direct_io);
+        else if(attr[2] == "open_rules")
+          return l::setxattr_open_rules(attrval,
+                                        flags,
+                                        config.open_rules);
+        else if(attr[2] == "readahead")
+          return l::setxattr_uint64_t(attrval,
+                                      flags,
+                                      config.readahead);
+        else if(attr[2] == "fanout")
+          return l::setxattr_uint64_t(attrval,
+                                      flags,
+                                      config.fanout);
+        else if(attr[2] == "prealloc")
+          return l::setxattr_uint64_t(attrval,
+                                      flags,
+                                      config.prealloc);
+        else if(attr[2] == "writecombine")
+          return l::setxattr_uint64_t(attrval,
+                                      flags,
+                                      config.writecombine);
         break;
 
       case 4:
@@ -430,6 +645,18 @@ namespace l
                                       config.open_cache.timeout);
         else if((attr[2] == "cache") && (attr[3] == "statfs"))
           return l::setxattr_statfs_timeout(attrval,flags);
+        else if((attr[2] == "cache") && (attr[3] == "acl"))
+          return l::setxattr_acl_cache_timeout(attrval,flags);
+        else if((attr[2] == "cache") && (attr[3] == "groups"))
+          return l::setxattr_uint64_t(attrval,flags,gidcache::timeout);
+        else if((attr[2] == "cache") && (attr[3] == "enoent"))
+          return l::setxattr_controlfile_cache_enoent(config,attrval,flags);
+        else if((attr[2] == "cache") && (attr[3] == "enoattr"))
+          return l::setxattr_controlfile_cache_enoattr(config,attrval,flags);
+        else if((attr[2] == "cache") && (attr[3] == "enoattr_names"))
+          return l::setxattr_controlfile_cache_enoattr_names(config,attrval,flags);
+        else if((attr[2] == "cache") && (attr[3] == "clonepath"))
+          return l::setxattr_controlfile_cache_clonepath(config,attrval,flags);
         else if((attr[2] == "cache") && (attr[3] == "attr"))
           return l::setxattr_controlfile_cache_attr(attrval,flags);
         else if((attr[2] == "cache") && (attr[3] == "entry"))
@@ -445,46 +672,54 @@ namespace l
     return -EINVAL;
   }
 
+  struct setxattr_args
+  {
+    const char *fusepath;
+    const char *attrname;
+    const char *attrval;
+    size_t      attrvalsize;
+    int         flags;
+  };
+
   static
   int
-  setxattr_loop_core(const string *basepath,
-                     const char   *fusepath,
-                     const char   *attrname,
-                     const char   *attrval,
-                     const size_t  attrvalsize,
-                     const int     flags,
-                     const int     error)
+  setxattr_task(const string *basepath_,
+                const void   *data_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
+    const setxattr_args *args = static_cast<const setxattr_args*>(data_);
 
-    fullpath = fs::path::make(basepath,fusepath);
-
-    rv = fs::lsetxattr(fullpath,attrname,attrval,attrvalsize,flags);
+    rv = fullpath.make(*basepath_,args->fusepath);
+    if(rv == -1)
+      return -1;
 
-    return error::calc(rv,error,errno);
+    return fs::lsetxattr(fullpath.c_str(),
+                         args->attrname,
+                         args->attrval,
+                         args->attrvalsize,
+                         args->flags);
   }
 
   static
   int
-  setxattr_loop(const vector<const string*> &basepaths,
-                const char                  *fusepath,
-                const char                  *attrname,
-                const char                  *attrval,
-                const size_t                 attrvalsize,
-                const int                    flags)
+  setxattr_loop(const Policy::Func::cstrptrvec &basepaths,
+                const char                     *fusepath,
+                const char                     *attrname,
+                const char                     *attrval,
+                const size_t                    attrvalsize,
+                const int                       flags,
+                const uint64_t                  fanout_)
   {
-    int error;
+    setxattr_args args;
 
-    error = -1;
-    for(size_t i = 0, ei = basepaths.size(); i != ei; i++)
-      {
-        error = l::setxattr_loop_core(basepaths[i],fusepath,
-                                      attrname,attrval,attrvalsize,flags,
-                                      error);
-      }
+    args.fusepath    = fusepath;
+    args.attrname    = attrname;
+    args.attrval     = attrval;
+    args.attrvalsize = attrvalsize;
+    args.flags       = flags;
 
-    return -error;
+    return -fanout::run(basepaths,l::setxattr_task,&args,fanout_);
   }
 
   static
@@ -496,16 +731,17 @@ namespace l
            const char           *attrname,
            const char           *attrval,
            const size_t          attrvalsize,
-           const int             flags)
+           const int             flags,
+           const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc(branches_,fusepath,minfreespace,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::setxattr_loop(basepaths,fusepath,attrname,attrval,attrvalsize,flags);
+    return l::setxattr_loop(basepaths,fusepath,attrname,attrval,attrvalsize,flags,fanout_);
   }
 }
 
@@ -520,6 +756,7 @@ namespace FUSE
   {
     const fuse_context *fc     = fuse_get_context();
     const Config       &config = Config::get(fc);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     if(fusepath == config.controlfile)
       return l::setxattr_controlfile(Config::get_writable(),
@@ -534,16 +771,23 @@ namespace FUSE
     if(config.xattr)
       return -config.xattr;
 
-    const ugid::Set         ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard readlock(&config.branches_lock);
-
-    return l::setxattr(config.setxattr,
-                       config.branches,
-                       config.minfreespace,
-                       fusepath,
-                       attrname,
-                       attrval,
-                       attrvalsize,
-                       flags);
+    int rv;
+    const ugid::Set          ugid(fc->uid,fc->gid);
+    const Branches::Snapshot branches(config.branches);
+
+    rv = l::setxattr(config.setxattr,
+                     *branches,
+                     config.minfreespace,
+                     fusepath,
+                     attrname,
+                     attrval,
+                     attrvalsize,
+                     flags,
+                     config.fanout);
+
+    fs::acl::cache_invalidate_xattr(fusepath,attrname);
+    config.enoattr_cache.invalidate(fusepath);
+
+    return rv;
   }
 }
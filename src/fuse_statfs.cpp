@@ -19,7 +19,6 @@
 #include "fs_base_stat.hpp"
 #include "fs_base_statvfs.hpp"
 #include "fs_path.hpp"
-#include "rwlock.hpp"
 #include "statvfs_util.hpp"
 #include "ugid.hpp"
 
@@ -156,9 +155,9 @@ namespace FUSE
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
 
-    return l::statfs(config.branches,
+    return l::statfs(*branches,
                      fusepath_,
                      config.statfs,
                      config.statfs_ignore,
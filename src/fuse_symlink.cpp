@@ -19,8 +19,8 @@
 #include "fs_base_symlink.hpp"
 #include "fs_clonepath.hpp"
 #include "fs_path.hpp"
+#include "getattr_coalesce.hpp"
 #include "rv.hpp"
-#include "rwlock.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -43,22 +43,22 @@ namespace l
                     const int     error_)
   {
     int rv;
-    string fullnewpath;
+    fs::path::Buf fullnewpath;
 
-    fullnewpath = fs::path::make(&newbasepath_,newpath_);
-
-    rv = fs::symlink(oldpath_,fullnewpath);
+    rv = fullnewpath.make(newbasepath_,newpath_);
+    if(rv == 0)
+      rv = fs::symlink(oldpath_,fullnewpath.c_str());
 
     return error::calc(rv,error_,errno);
   }
 
   static
   int
-  symlink_loop(const string                &existingpath_,
-               const vector<const string*>  newbasepaths_,
-               const char                  *oldpath_,
-               const char                  *newpath_,
-               const string                &newdirpath_)
+  symlink_loop(const string                   &existingpath_,
+               const Policy::Func::cstrptrvec &newbasepaths_,
+               const char                     *oldpath_,
+               const char                     *newpath_,
+               const char                     *newdirpath_)
   {
     int rv;
     int error;
@@ -89,22 +89,24 @@ namespace l
           const char           *newpath_)
   {
     int rv;
-    string newdirpath;
-    vector<const string*> newbasepaths;
-    vector<const string*> existingpaths;
+    fs::path::Buf newdirpath;
+    Policy::Func::cstrptrvec newbasepaths;
+    Policy::Func::cstrptrvec existingpaths;
 
-    newdirpath = fs::path::dirname(newpath_);
+    rv = newdirpath.dirname(newpath_);
+    if(rv == -1)
+      return -errno;
 
-    rv = searchFunc_(branches_,newdirpath,minfreespace_,existingpaths);
+    rv = searchFunc_(branches_,newdirpath.c_str(),minfreespace_,existingpaths);
     if(rv == -1)
       return -errno;
 
-    rv = createFunc_(branches_,newdirpath,minfreespace_,newbasepaths);
+    rv = createFunc_(branches_,newdirpath.c_str(),minfreespace_,newbasepaths);
     if(rv == -1)
       return -errno;
 
     return l::symlink_loop(*existingpaths[0],newbasepaths,
-                           oldpath_,newpath_,newdirpath);
+                           oldpath_,newpath_,newdirpath.c_str());
   }
 }
 
@@ -114,16 +116,23 @@ namespace FUSE
   symlink(const char *oldpath_,
           const char *newpath_)
   {
+    int rv;
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
-
-    return l::symlink(config.getattr,
-                      config.symlink,
-                      config.branches,
-                      config.minfreespace,
-                      oldpath_,
-                      newpath_);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
+
+    rv = l::symlink(config.getattr,
+                    config.symlink,
+                    *branches,
+                    config.minfreespace,
+                    oldpath_,
+                    newpath_);
+
+    config.enoent_cache.invalidate(newpath_);
+    config.enoattr_cache.invalidate(newpath_);
+
+    return rv;
   }
 }
@@ -16,10 +16,10 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
 #include "fs_base_truncate.hpp"
 #include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -35,38 +35,41 @@ using std::vector;
 
 namespace l
 {
+  struct truncate_args
+  {
+    const char *fusepath;
+    off_t       size;
+  };
+
   static
   int
-  truncate_loop_core(const string *basepath_,
-                     const char   *fusepath_,
-                     const off_t   size_,
-                     const int     error_)
+  truncate_task(const string *basepath_,
+                const void   *data_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
+    const truncate_args *args = static_cast<const truncate_args*>(data_);
 
-    fullpath = fs::path::make(basepath_,fusepath_);
-
-    rv = fs::truncate(fullpath,size_);
+    rv = fullpath.make(*basepath_,args->fusepath);
+    if(rv == -1)
+      return -1;
 
-    return error::calc(rv,error_,errno);
+    return fs::truncate(fullpath.c_str(),args->size);
   }
 
   static
   int
-  truncate_loop(const vector<const string*> &basepaths_,
-                const char                  *fusepath_,
-                const off_t                  size_)
+  truncate_loop(const Policy::Func::cstrptrvec &basepaths_,
+                const char                     *fusepath_,
+                const off_t                     size_,
+                const uint64_t                  fanout_)
   {
-    int error;
+    truncate_args args;
 
-    error = -1;
-    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
-      {
-        error = l::truncate_loop_core(basepaths_[i],fusepath_,size_,error);
-      }
+    args.fusepath = fusepath_;
+    args.size     = size_;
 
-    return -error;
+    return -fanout::run(basepaths_,l::truncate_task,&args,fanout_);
   }
 
   static
@@ -75,16 +78,17 @@ namespace l
            const Branches       &branches_,
            const uint64_t        minfreespace_,
            const char           *fusepath_,
-           const off_t           size_)
+           const off_t           size_,
+           const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::truncate_loop(basepaths,fusepath_,size_);
+    return l::truncate_loop(basepaths,fusepath_,size_,fanout_);
   }
 }
 
@@ -97,12 +101,14 @@ namespace FUSE
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     return l::truncate(config.truncate,
-                       config.branches,
+                       *branches,
                        config.minfreespace,
                        fusepath_,
-                       size_);
+                       size_,
+                       config.fanout);
   }
 }
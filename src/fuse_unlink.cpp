@@ -16,10 +16,10 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
 #include "fs_base_unlink.hpp"
-#include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "fs_branch.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 
 #include <fuse.h>
@@ -34,36 +34,40 @@ using std::vector;
 
 namespace l
 {
+  struct unlink_args
+  {
+    const Branches *branches;
+    const char     *fusepath;
+  };
+
   static
   int
-  unlink_loop_core(const string *basepath_,
-                   const char   *fusepath_,
-                   const int     error_)
+  unlink_task(const string *basepath_,
+              const void   *data_)
   {
-    int rv;
-    string fullpath;
-
-    fullpath = fs::path::make(basepath_,fusepath_);
+    const Branch *branch;
+    const unlink_args *args = static_cast<const unlink_args*>(data_);
 
-    rv = fs::unlink(fullpath);
+    branch = args->branches->find(*basepath_);
+    if(branch == NULL)
+      return (errno=ENOENT,-1);
 
-    return error::calc(rv,error_,errno);
+    return fs::branch::unlink(*branch,args->fusepath);
   }
 
   static
   int
-  unlink_loop(const vector<const string*> &basepaths_,
-              const char                  *fusepath_)
+  unlink_loop(const Branches                 &branches_,
+              const Policy::Func::cstrptrvec &basepaths_,
+              const char                     *fusepath_,
+              const uint64_t                  fanout_)
   {
-    int error;
+    unlink_args args;
 
-    error = -1;
-    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
-      {
-        error = l::unlink_loop_core(basepaths_[i],fusepath_,error);
-      }
+    args.branches = &branches_;
+    args.fusepath = fusepath_;
 
-    return -error;
+    return -fanout::run(basepaths_,l::unlink_task,&args,fanout_);
   }
 
   static
@@ -71,16 +75,17 @@ namespace l
   unlink(Policy::Func::Action  actionFunc_,
          const Branches       &branches_,
          const uint64_t        minfreespace_,
-         const char           *fusepath_)
+         const char           *fusepath_,
+         const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::unlink_loop(basepaths,fusepath_);
+    return l::unlink_loop(branches_,basepaths,fusepath_,fanout_);
   }
 }
 
@@ -92,13 +97,16 @@ namespace FUSE
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     config.open_cache.erase(fusepath_);
+    config.enoattr_cache.invalidate(fusepath_);
 
     return l::unlink(config.unlink,
-                     config.branches,
+                     *branches,
                      config.minfreespace,
-                     fusepath_);
+                     fusepath_,
+                     config.fanout);
   }
 }
@@ -16,10 +16,10 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fanout.hpp"
 #include "fs_base_utime.hpp"
 #include "fs_path.hpp"
-#include "rv.hpp"
-#include "rwlock.hpp"
+#include "getattr_coalesce.hpp"
 #include "ugid.hpp"
 #include <fuse.h>
 
@@ -33,38 +33,41 @@ using std::vector;
 
 namespace l
 {
+  struct utimens_args
+  {
+    const char     *fusepath;
+    const timespec *ts;
+  };
+
   static
   int
-  utimens_loop_core(const string   *basepath_,
-                    const char     *fusepath_,
-                    const timespec  ts_[2],
-                    const int       error_)
+  utimens_task(const string *basepath_,
+               const void   *data_)
   {
     int rv;
-    string fullpath;
+    fs::path::Buf fullpath;
+    const utimens_args *args = static_cast<const utimens_args*>(data_);
 
-    fullpath = fs::path::make(basepath_,fusepath_);
-
-    rv = fs::lutime(fullpath,ts_);
+    rv = fullpath.make(*basepath_,args->fusepath);
+    if(rv == -1)
+      return -1;
 
-    return error::calc(rv,error_,errno);
+    return fs::lutime(fullpath.c_str(),args->ts);
   }
 
   static
   int
-  utimens_loop(const vector<const string*> &basepaths_,
-               const char                  *fusepath_,
-               const timespec               ts_[2])
+  utimens_loop(const Policy::Func::cstrptrvec &basepaths_,
+               const char                     *fusepath_,
+               const timespec                  ts_[2],
+               const uint64_t                  fanout_)
   {
-    int error;
+    utimens_args args;
 
-    error = -1;
-    for(size_t i = 0, ei = basepaths_.size(); i != ei; i++)
-      {
-        error = l::utimens_loop_core(basepaths_[i],fusepath_,ts_,error);
-      }
+    args.fusepath = fusepath_;
+    args.ts       = ts_;
 
-    return -error;
+    return -fanout::run(basepaths_,l::utimens_task,&args,fanout_);
   }
 
   static
@@ -73,16 +76,17 @@ namespace l
           const Branches       &branches_,
           const uint64_t        minfreespace_,
           const char           *fusepath_,
-          const timespec        ts_[2])
+          const timespec        ts_[2],
+          const uint64_t        fanout_)
   {
     int rv;
-    vector<const string*> basepaths;
+    Policy::Func::cstrptrvec basepaths;
 
     rv = actionFunc_(branches_,fusepath_,minfreespace_,basepaths);
     if(rv == -1)
       return -errno;
 
-    return l::utimens_loop(basepaths,fusepath_,ts_);
+    return l::utimens_loop(basepaths,fusepath_,ts_,fanout_);
   }
 }
 
@@ -95,12 +99,14 @@ namespace FUSE
     const fuse_context      *fc     = fuse_get_context();
     const Config            &config = Config::get(fc);
     const ugid::Set          ugid(fc->uid,fc->gid);
-    const rwlock::ReadGuard  readlock(&config.branches_lock);
+    const Branches::Snapshot branches(config.branches);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     return l::utimens(config.utimens,
-                      config.branches,
+                      *branches,
                       config.minfreespace,
                       fusepath_,
-                      ts_);
+                      ts_,
+                      config.fanout);
   }
 }
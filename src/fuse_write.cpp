@@ -19,17 +19,14 @@
 #include "fileinfo.hpp"
 #include "fs_base_write.hpp"
 #include "fs_movefile.hpp"
+#include "getattr_coalesce.hpp"
+#include "linkcow.hpp"
+#include "moveonenospc.hpp"
 #include "rwlock.hpp"
-#include "ugid.hpp"
-
-#include <string>
-#include <vector>
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
-using std::string;
-using std::vector;
-
 typedef int (*WriteFunc)(const int,const void*,const size_t,const off_t);
 
 namespace l
@@ -76,9 +73,38 @@ namespace l
     return rv;
   }
 
+  static
+  int
+  write_tracked(WriteFunc     func_,
+                FileInfo     *fi_,
+                const char   *buf_,
+                const size_t  count_,
+                const off_t   offset_,
+                const size_t  writecombine_,
+                const bool    moveonenospc_)
+  {
+    int rv;
+    const rwlock::ReadGuard guard(moveonenospc::write_lock(moveonenospc_,fi_));
+
+    // keeps later writes behind those queued on a move
+    if(moveonenospc::deferring(fi_))
+      return -ENOSPC;
+
+    if(writecombine_ || fi_->writebuf.data)
+      return writecombine::write(fi_,buf_,count_,offset_,writecombine_);
+
+    rv = func_(fi_->fd,buf_,count_,offset_);
+    if((rv > 0) && (fi_->movefile != NULL))
+      fi_->movefile->dirty(offset_,rv);
+
+    return rv;
+  }
+
   static
   int
   write(WriteFunc       func_,
+        const Config   &config_,
+        const size_t    writecombine_,
         const char     *buf_,
         const size_t    count_,
         const off_t     offset_,
@@ -89,26 +115,22 @@ namespace l
 
     fi = reinterpret_cast<FileInfo*>(ffi_->fh);
 
-    rv = func_(fi->fd,buf_,count_,offset_);
-    if(l::out_of_space(-rv))
-      {
-        const fuse_context *fc     = fuse_get_context();
-        const Config       &config = Config::get(fc);
-
-        if(config.moveonenospc)
-          {
-            vector<string> paths;
-            const ugid::Set ugid(0,0);
-            const rwlock::ReadGuard readlock(&config.branches_lock);
+    rv = linkcow::prepare_write(fi);
+    if(rv < 0)
+      return rv;
 
-            config.branches.to_paths(paths);
+    fi->prealloc.write(fi->fd,offset_,count_,config_.prealloc);
 
-            rv = fs::movefile(paths,fi->fusepath,count_,fi->fd);
-            if(rv == -1)
-              return -ENOSPC;
+    rv = l::write_tracked(func_,fi,buf_,count_,offset_,writecombine_,config_.moveonenospc);
+    if(l::out_of_space(-rv) && (config_.moveonenospc || (fi->movefile != NULL)))
+      {
+        rv = moveonenospc::move(config_,fi,buf_,count_,offset_);
+        if(rv == -1)
+          return -ENOSPC;
+        if(rv > 0)
+          return rv;
 
-            rv = func_(fi->fd,buf_,count_,offset_);
-          }
+        rv = l::write_tracked(func_,fi,buf_,count_,offset_,writecombine_,config_.moveonenospc);
       }
 
     return rv;
@@ -125,12 +147,20 @@ namespace FUSE
         fuse_file_info *ffi_)
   {
     WriteFunc wf;
+    size_t writecombine;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    const FileInfo     *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
     wf = ((ffi_->direct_io) ?
           l::write_direct_io :
           l::write_regular);
+    writecombine = ((fi->direct_io) ?
+                    config.writecombine :
+                    0);
 
-    return l::write(wf,buf_,count_,offset_,ffi_);
+    return l::write(wf,config,writecombine,buf_,count_,offset_,ffi_);
   }
 
   int
@@ -19,21 +19,19 @@
 #include "fileinfo.hpp"
 #include "fs_movefile.hpp"
 #include "fuse_write.hpp"
-#include "policy.hpp"
+#include "getattr_coalesce.hpp"
+#include "linkcow.hpp"
+#include "moveonenospc.hpp"
 #include "rwlock.hpp"
-#include "ugid.hpp"
+#include "writecombine.hpp"
 
 #include <fuse.h>
 
-#include <string>
 #include <vector>
 
 #include <stdlib.h>
 #include <unistd.h>
 
-using std::string;
-using std::vector;
-
 namespace l
 {
   static
@@ -61,6 +59,76 @@ namespace l
 
     return fuse_buf_copy(&dst,src_,cpflags);
   }
+
+  // only data already in memory can be queued on a move
+  static
+  const char *
+  mem(const fuse_bufvec *src_)
+  {
+    if((src_->count == 1) &&
+       (src_->idx == 0) &&
+       (src_->off == 0) &&
+       !(src_->buf[0].flags & FUSE_BUF_IS_FD))
+      return (const char*)src_->buf[0].mem;
+
+    return NULL;
+  }
+
+  static
+  int
+  write_buf_combined(FileInfo     *fi_,
+                     fuse_bufvec  *src_,
+                     const off_t   offset_,
+                     const size_t  writecombine_)
+  {
+    int rv;
+    size_t size;
+    fuse_bufvec dst;
+    std::vector<char> buf;
+
+    if(l::mem(src_) != NULL)
+      return writecombine::write(fi_,
+                                 l::mem(src_),
+                                 src_->buf[0].size,
+                                 offset_,
+                                 writecombine_);
+
+    size = fuse_buf_size(src_);
+    buf.resize(size);
+    dst = FUSE_BUFVEC_INIT(size);
+    dst.buf->mem = &buf[0];
+
+    rv = fuse_buf_copy(&dst,src_,(fuse_buf_copy_flags)0);
+    if(rv <= 0)
+      return rv;
+
+    return writecombine::write(fi_,&buf[0],rv,offset_,writecombine_);
+  }
+
+  static
+  int
+  write_buf_tracked(FileInfo     *fi_,
+                    fuse_bufvec  *src_,
+                    const off_t   offset_,
+                    const size_t  writecombine_,
+                    const bool    moveonenospc_)
+  {
+    int rv;
+    const rwlock::ReadGuard guard(moveonenospc::write_lock(moveonenospc_,fi_));
+
+    // keeps later writes behind those queued on a move
+    if(moveonenospc::deferring(fi_))
+      return -ENOSPC;
+
+    if(writecombine_ || fi_->writebuf.data)
+      return l::write_buf_combined(fi_,src_,offset_,writecombine_);
+
+    rv = l::write_buf(fi_->fd,src_,offset_);
+    if((rv > 0) && (fi_->movefile != NULL))
+      fi_->movefile->dirty(offset_,rv);
+
+    return rv;
+  }
 }
 
 namespace FUSE
@@ -72,30 +140,32 @@ namespace FUSE
             fuse_file_info *ffi_)
   {
     int rv;
-    FileInfo *fi = reinterpret_cast<FileInfo*>(ffi_->fh);
+    size_t writecombine;
+    const fuse_context *fc     = fuse_get_context();
+    const Config       &config = Config::get(fc);
+    FileInfo           *fi     = reinterpret_cast<FileInfo*>(ffi_->fh);
+    const coalesce::Mutation mutation(config.getattr_coalesce);
 
-    rv = l::write_buf(fi->fd,src_,offset_);
-    if(l::out_of_space(-rv))
-      {
-        const fuse_context *fc     = fuse_get_context();
-        const Config       &config = Config::get(fc);
+    writecombine = ((fi->direct_io) ?
+                    config.writecombine :
+                    0);
 
-        if(config.moveonenospc)
-          {
-            size_t extra;
-            vector<string> paths;
-            const ugid::Set ugid(0,0);
-            const rwlock::ReadGuard readlock(&config.branches_lock);
+    rv = linkcow::prepare_write(fi);
+    if(rv < 0)
+      return rv;
 
-            config.branches.to_paths(paths);
+    fi->prealloc.write(fi->fd,offset_,fuse_buf_size(src_),config.prealloc);
 
-            extra = fuse_buf_size(src_);
-            rv = fs::movefile(paths,fi->fusepath,extra,fi->fd);
-            if(rv == -1)
-              return -ENOSPC;
+    rv = l::write_buf_tracked(fi,src_,offset_,writecombine,config.moveonenospc);
+    if(l::out_of_space(-rv) && (config.moveonenospc || (fi->movefile != NULL)))
+      {
+        rv = moveonenospc::move(config,fi,l::mem(src_),fuse_buf_size(src_),offset_);
+        if(rv == -1)
+          return -ENOSPC;
+        if(rv > 0)
+          return rv;
 
-            rv = l::write_buf(fi->fd,src_,offset_);
-          }
+        rv = l::write_buf_tracked(fi,src_,offset_,writecombine,config.moveonenospc);
       }
 
     return rv;
@@ -0,0 +1,241 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "getattr_coalesce.hpp"
+
+#include "fasthash.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define SHARDS 64
+
+namespace l
+{
+  struct Shard
+  {
+    pthread_mutex_t   lock;
+    coalesce::Flight *flights;
+    uint64_t          calls;
+    uint64_t          coalesced;
+  } __attribute__((aligned(64)));
+
+  static Shard    g_shards[SHARDS];
+  static uint64_t g_generation = 0;
+
+  static
+  Shard&
+  shard(const uint64_t hash_)
+  {
+    return g_shards[hash_ % SHARDS];
+  }
+
+  static
+  coalesce::Flight*
+  find(const Shard       &shard_,
+       const coalesce::Flight &key_)
+  {
+    coalesce::Flight *flight;
+
+    for(flight = shard_.flights; flight != NULL; flight = flight->next)
+      {
+        if((flight->hash       == key_.hash) &&
+           (flight->generation == key_.generation) &&
+           (flight->uid        == key_.uid) &&
+           (flight->gid        == key_.gid) &&
+           !strcmp(flight->fusepath,key_.fusepath))
+          return flight;
+      }
+
+    return NULL;
+  }
+
+  static
+  void
+  unlink(Shard            &shard_,
+         coalesce::Flight *flight_)
+  {
+    coalesce::Flight **p;
+
+    for(p = &shard_.flights; *p != NULL; p = &(*p)->next)
+      {
+        if(*p != flight_)
+          continue;
+        *p = flight_->next;
+        return;
+      }
+  }
+
+  static
+  void
+  init(void)
+  {
+    for(int i = 0; i < SHARDS; i++)
+      {
+        pthread_mutex_init(&g_shards[i].lock,NULL);
+        g_shards[i].flights   = NULL;
+        g_shards[i].calls     = 0;
+        g_shards[i].coalesced = 0;
+      }
+  }
+
+  static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+}
+
+namespace coalesce
+{
+  Flight::Flight()
+    : next(NULL),
+      fusepath(NULL),
+      hash(0),
+      generation(0),
+      uid(0),
+      gid(0),
+      waiters(0),
+      done(false),
+      rv(0)
+  {
+    pthread_cond_init(&cond,NULL);
+  }
+
+  Flight::~Flight()
+  {
+    pthread_cond_destroy(&cond);
+  }
+
+  bool
+  getattr_begin(Flight      &flight_,
+                const char  *fusepath_,
+                const uid_t  uid_,
+                const gid_t  gid_,
+                int         *rv_,
+                struct stat *st_)
+  {
+    Flight *flight;
+
+    pthread_once(&l::g_once,l::init);
+
+    flight_.fusepath   = fusepath_;
+    flight_.hash       = fasthash64(fusepath_,strlen(fusepath_),uid_ ^ ((uint64_t)gid_ << 32));
+    flight_.generation = __atomic_load_n(&l::g_generation,__ATOMIC_ACQUIRE);
+    flight_.uid        = uid_;
+    flight_.gid        = gid_;
+
+    l::Shard &shard = l::shard(flight_.hash);
+
+    pthread_mutex_lock(&shard.lock);
+
+    flight = l::find(shard,flight_);
+    if(flight == NULL)
+      {
+        shard.calls++;
+        flight_.next  = shard.flights;
+        shard.flights = &flight_;
+
+        pthread_mutex_unlock(&shard.lock);
+
+        return false;
+      }
+
+    shard.coalesced++;
+    flight->waiters++;
+    while(!flight->done)
+      pthread_cond_wait(&flight->cond,&shard.lock);
+
+    *rv_ = flight->rv;
+    if(flight->rv == 0)
+      *st_ = flight->st;
+
+    // the leader waits for everyone to copy the result
+    flight->waiters--;
+    if(flight->waiters == 0)
+      pthread_cond_broadcast(&flight->cond);
+
+    pthread_mutex_unlock(&shard.lock);
+
+    return true;
+  }
+
+  void
+  getattr_end(Flight            &flight_,
+              const int          rv_,
+              const struct stat *st_)
+  {
+    l::Shard &shard = l::shard(flight_.hash);
+
+    pthread_mutex_lock(&shard.lock);
+
+    l::unlink(shard,&flight_);
+
+    flight_.done = true;
+    flight_.rv   = rv_;
+    if(rv_ == 0)
+      flight_.st = *st_;
+
+    pthread_cond_broadcast(&flight_.cond);
+    while(flight_.waiters > 0)
+      pthread_cond_wait(&flight_.cond,&shard.lock);
+
+    pthread_mutex_unlock(&shard.lock);
+  }
+
+  void
+  invalidate(void)
+  {
+    __atomic_add_fetch(&l::g_generation,1,__ATOMIC_RELEASE);
+  }
+
+  uint64_t
+  getattr_calls(void)
+  {
+    uint64_t rv;
+
+    pthread_once(&l::g_once,l::init);
+
+    rv = 0;
+    for(int i = 0; i < SHARDS; i++)
+      {
+        pthread_mutex_lock(&l::g_shards[i].lock);
+        rv += l::g_shards[i].calls;
+        pthread_mutex_unlock(&l::g_shards[i].lock);
+      }
+
+    return rv;
+  }
+
+  uint64_t
+  getattr_coalesced(void)
+  {
+    uint64_t rv;
+
+    pthread_once(&l::g_once,l::init);
+
+    rv = 0;
+    for(int i = 0; i < SHARDS; i++)
+      {
+        pthread_mutex_lock(&l::g_shards[i].lock);
+        rv += l::g_shards[i].coalesced;
+        pthread_mutex_unlock(&l::g_shards[i].lock);
+      }
+
+    return rv;
+  }
+}
@@ -0,0 +1,106 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/*
+  Single-flight coalescing of getattr, enabled with getattr_coalesce.
+  When a getattr for the same path and credentials is already in
+  progress later callers wait for it and share its result rather than
+  running the search policy and stat'ing branches again.
+
+  Requests which may change attributes bump a generation when they
+  finish. A getattr only joins a flight which started in the current
+  generation so it never sees attributes from before a change that
+  completed before it was issued.
+
+  Flights live on the leader's stack in a fixed number of shards so
+  no allocation is made and unrelated paths rarely share a lock.
+*/
+
+namespace coalesce
+{
+  struct Flight
+  {
+    Flight();
+    ~Flight();
+
+    Flight         *next;
+    const char     *fusepath;
+    uint64_t        hash;
+    uint64_t        generation;
+    uid_t           uid;
+    gid_t           gid;
+    int             waiters;
+    bool            done;
+    int             rv;
+    struct stat     st;
+    pthread_cond_t  cond;
+
+  private:
+    Flight(const Flight&);
+    Flight &operator=(const Flight&);
+  };
+
+  /*
+    Returns true if another thread computed the result, in which case
+    `rv_` and `st_` are filled in. Otherwise the caller leads
+    `flight_` and must hand it to getattr_end once done.
+  */
+  bool
+  getattr_begin(Flight      &flight_,
+                const char  *fusepath_,
+                const uid_t  uid_,
+                const gid_t  gid_,
+                int         *rv_,
+                struct stat *st_);
+
+  void
+  getattr_end(Flight            &flight_,
+              const int          rv_,
+              const struct stat *st_);
+
+  void invalidate(void);
+
+  // placed at the top of handlers which can change attributes
+  class Mutation
+  {
+  public:
+    Mutation(const bool enabled_)
+      : _enabled(enabled_)
+    {
+    }
+
+    ~Mutation()
+    {
+      if(_enabled)
+        coalesce::invalidate();
+    }
+
+  private:
+    const bool _enabled;
+  };
+
+  uint64_t getattr_calls(void);
+  uint64_t getattr_coalesced(void);
+}
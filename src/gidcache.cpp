@@ -14,9 +14,12 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+
 #include <grp.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <stdlib.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -26,70 +29,74 @@
 # include <sys/param.h>
 #endif
 
-#include <cstdlib>
-#include <algorithm>
+#include <vector>
 
 #include "gidcache.hpp"
 
-inline
-bool
-gid_t_rec::operator<(const struct gid_t_rec &b) const
+#define DEFAULT_TIMEOUT 60
+
+namespace gidcache
 {
-  return uid < b.uid;
+  uint64_t timeout = DEFAULT_TIMEOUT;
 }
 
+/*
+  Counters are kept per cache, and so per thread, and only written by
+  the owning thread. Live caches are linked so reading the stats can
+  sum them. Counts of caches whose threads exited are folded into
+  g_retired.
+*/
+static pthread_mutex_t     g_lock    = PTHREAD_MUTEX_INITIALIZER;
+static gid_t_cache        *g_caches  = NULL;
+static gid_t_cache::Stats  g_retired = {0,0,0,0,0};
+
+static
 inline
-gid_t_rec *
-gid_t_cache::begin(void)
+void
+inc(uint64_t *counter_)
 {
-  return recs;
+  __atomic_store_n(counter_,
+                   __atomic_load_n(counter_,__ATOMIC_RELAXED) + 1,
+                   __ATOMIC_RELAXED);
 }
 
+static
 inline
-gid_t_rec *
-gid_t_cache::end(void)
+void
+add(gid_t_cache::Stats       *dst_,
+    const gid_t_cache::Stats *src_)
 {
-  return recs + size;
+  dst_->hits              += __atomic_load_n(&src_->hits,__ATOMIC_RELAXED);
+  dst_->misses            += __atomic_load_n(&src_->misses,__ATOMIC_RELAXED);
+  dst_->expired           += __atomic_load_n(&src_->expired,__ATOMIC_RELAXED);
+  dst_->evicted           += __atomic_load_n(&src_->evicted,__ATOMIC_RELAXED);
+  dst_->setgroups_skipped += __atomic_load_n(&src_->setgroups_skipped,__ATOMIC_RELAXED);
 }
 
+static
 inline
-gid_t_rec *
-gid_t_cache::allocrec(void)
+uint64_t
+get_time(void)
 {
-  if(size == MAXRECS)
-    return &recs[rand() % MAXRECS];
-  else
-    return &recs[size++];
+  struct timeval now;
+
+  ::gettimeofday(&now,NULL);
+
+  return now.tv_sec;
 }
 
+static
 inline
-gid_t_rec *
-gid_t_cache::lower_bound(gid_t_rec   *begin,
-                         gid_t_rec   *end,
-                         const uid_t  uid)
+size_t
+hash(const uid_t uid,
+     const gid_t gid)
 {
-  int step;
-  int count;
-  gid_t_rec *iter;
+  uint64_t h;
 
-  count = std::distance(begin,end);
-  while(count > 0)
-    {
-      iter = begin;
-      step = count / 2;
-      std::advance(iter,step);
-      if(iter->uid < uid)
-        {
-          begin  = ++iter;
-          count -= step + 1;
-        }
-      else
-        {
-          count = step;
-        }
-    }
+  h  = ((uint64_t)uid << 32) | (uint64_t)gid;
+  h *= 0x9E3779B97F4A7C15ULL;
 
-  return begin;
+  return (size_t)(h >> 32);
 }
 
 static
@@ -106,49 +113,174 @@ _getgrouplist(const char  *user,
 #endif
 }
 
+/*
+  No limit on the number of groups. The first call sizes the list and
+  it's retried should membership grow in between.
+*/
+static
+void
+get_groups(const char         *user,
+           const gid_t         gid,
+           std::vector<gid_t> &gids)
+{
+  int rv;
+  int ngroups;
+
+  ngroups = 0;
+  ::_getgrouplist(user,gid,NULL,&ngroups);
+  do
+    {
+      if(ngroups < 1)
+        ngroups = 1;
+      gids.resize(ngroups);
+      rv = ::_getgrouplist(user,gid,&gids[0],&ngroups);
+    }
+  while((rv == -1) && (ngroups > (int)gids.size()));
+
+  if(rv == -1)
+    gids.assign(1,gid);
+  else
+    gids.resize(ngroups);
+}
+
+gid_t_cache::gid_t_cache()
+  : current_valid(false),
+    prev(NULL)
+{
+  for(size_t i = 0; i < (GIDCACHE_SETS * GIDCACHE_WAYS); i++)
+    recs[i].time = 0;
+
+  stats.hits              = 0;
+  stats.misses            = 0;
+  stats.expired           = 0;
+  stats.evicted           = 0;
+  stats.setgroups_skipped = 0;
+
+  pthread_mutex_lock(&g_lock);
+  next = g_caches;
+  if(next != NULL)
+    next->prev = this;
+  g_caches = this;
+  pthread_mutex_unlock(&g_lock);
+}
+
+gid_t_cache::~gid_t_cache()
+{
+  pthread_mutex_lock(&g_lock);
+  ::add(&g_retired,&stats);
+  if(prev != NULL)
+    prev->next = next;
+  else
+    g_caches = next;
+  if(next != NULL)
+    next->prev = prev;
+  pthread_mutex_unlock(&g_lock);
+}
+
+void
+gid_t_cache::sum(Stats *stats_)
+{
+  pthread_mutex_lock(&g_lock);
+  *stats_ = g_retired;
+  for(gid_t_cache *c = g_caches; c != NULL; c = c->next)
+    ::add(stats_,&c->stats);
+  pthread_mutex_unlock(&g_lock);
+}
+
 gid_t_rec *
-gid_t_cache::cache(const uid_t uid,
-                   const gid_t gid)
+gid_t_cache::lookup(const uid_t    uid,
+                    const gid_t    gid,
+                    const uint64_t now)
+{
+  gid_t_rec *set;
+
+  set = &recs[(hash(uid,gid) % GIDCACHE_SETS) * GIDCACHE_WAYS];
+  for(size_t i = 0; i < GIDCACHE_WAYS; i++)
+    {
+      gid_t_rec *rec = &set[i];
+
+      if((rec->time == 0) || (rec->uid != uid) || (rec->gid != gid))
+        continue;
+
+      if((gidcache::timeout != 0) && ((now - rec->time) >= gidcache::timeout))
+        {
+          ::inc(&stats.expired);
+          rec->time = 0;
+          return NULL;
+        }
+
+      return rec;
+    }
+
+  return NULL;
+}
+
+gid_t_rec *
+gid_t_cache::cache(const uid_t    uid,
+                   const gid_t    gid,
+                   const uint64_t now)
 {
   int rv;
   char buf[4096];
   struct passwd pwd;
   struct passwd *pwdrv;
+  gid_t_rec *set;
   gid_t_rec *rec;
 
-  rec = allocrec();
+  set = &recs[(hash(uid,gid) % GIDCACHE_SETS) * GIDCACHE_WAYS];
+  rec = &set[0];
+  for(size_t i = 0; i < GIDCACHE_WAYS; i++)
+    {
+      if(set[i].time < rec->time)
+        rec = &set[i];
+    }
+
+  if(rec->time != 0)
+    ::inc(&stats.evicted);
+
+  rec->uid  = uid;
+  rec->gid  = gid;
+  rec->time = now;
+  rec->gids.assign(1,gid);
 
-  rec->uid = uid;
   rv = ::getpwuid_r(uid,&pwd,buf,sizeof(buf),&pwdrv);
   if(pwdrv != NULL && rv == 0)
-    {
-      rec->size = 0;
-      ::_getgrouplist(pwd.pw_name,gid,NULL,&rec->size);
-      rec->size = std::min(MAXGIDS,rec->size);
-      rv = ::_getgrouplist(pwd.pw_name,gid,rec->gids,&rec->size);
-      if(rv == -1)
-        {
-          rec->gids[0] = gid;
-          rec->size    = 1;
-        }
-    }
+    ::get_groups(pwd.pw_name,gid,rec->gids);
 
   return rec;
 }
 
-static
-inline
+/*
+  With the raw syscall the groups belong to the calling thread alone
+  so if what was last set on it matches there is nothing to do. The
+  library call applies to every thread in the process so it can't be
+  skipped.
+*/
 int
-setgroups(const gid_t_rec *rec)
+gid_t_cache::setgroups(const gid_t_rec *rec)
 {
 #if defined __linux__ and UGID_USE_RWLOCK == 0
+  int rv;
+
+  if(current_valid && (current == rec->gids))
+    {
+      ::inc(&stats.setgroups_skipped);
+      return 0;
+    }
+
 # if defined SYS_setgroups32
-  return ::syscall(SYS_setgroups32,rec->size,rec->gids);
+  rv = ::syscall(SYS_setgroups32,rec->gids.size(),&rec->gids[0]);
 # else
-  return ::syscall(SYS_setgroups,rec->size,rec->gids);
+  rv = ::syscall(SYS_setgroups,rec->gids.size(),&rec->gids[0]);
 # endif
+
+  current_valid = (rv == 0);
+  if(current_valid)
+    current = rec->gids;
+
+  return rv;
 #else
-  return ::setgroups(rec->size,rec->gids);
+  return ::setgroups(rec->gids.size(),&rec->gids[0]);
 #endif
 }
 
@@ -156,20 +288,73 @@ int
 gid_t_cache::initgroups(const uid_t uid,
                         const gid_t gid)
 {
-  int rv;
+  uint64_t now;
   gid_t_rec *rec;
 
-  rec = lower_bound(begin(),end(),uid);
-  if(rec == end() || rec->uid != uid)
+  now = get_time();
+  rec = lookup(uid,gid,now);
+  if(rec == NULL)
     {
-      rec = cache(uid,gid);
-      rv = ::setgroups(rec);
-      std::sort(begin(),end());
+      ::inc(&stats.misses);
+      rec = cache(uid,gid,now);
     }
   else
     {
-      rv = ::setgroups(rec);
+      ::inc(&stats.hits);
     }
 
-  return rv;
+  return setgroups(rec);
+}
+
+namespace gidcache
+{
+  uint64_t
+  hits(void)
+  {
+    gid_t_cache::Stats stats;
+
+    gid_t_cache::sum(&stats);
+
+    return stats.hits;
+  }
+
+  uint64_t
+  misses(void)
+  {
+    gid_t_cache::Stats stats;
+
+    gid_t_cache::sum(&stats);
+
+    return stats.misses;
+  }
+
+  uint64_t
+  expired(void)
+  {
+    gid_t_cache::Stats stats;
+
+    gid_t_cache::sum(&stats);
+
+    return stats.expired;
+  }
+
+  uint64_t
+  evicted(void)
+  {
+    gid_t_cache::Stats stats;
+
+    gid_t_cache::sum(&stats);
+
+    return stats.evicted;
+  }
+
+  uint64_t
+  setgroups_skipped(void)
+  {
+    gid_t_cache::Stats stats;
+
+    gid_t_cache::sum(&stats);
+
+    return stats.setgroups_skipped;
+  }
 }
@@ -14,42 +14,82 @@
   OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+
 #pragma once
 
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#define MAXGIDS 32
-#define MAXRECS 256
+#define GIDCACHE_SETS 128
+#define GIDCACHE_WAYS 4
 
 struct gid_t_rec
 {
-  uid_t uid;
-  int   size;
-  gid_t gids[MAXGIDS];
-
-  bool
-  operator<(const struct gid_t_rec &b) const;
+  uid_t              uid;
+  gid_t              gid;
+  uint64_t           time;
+  std::vector<gid_t> gids;
 };
 
-struct gid_t_cache
+/*
+  Per thread cache of supplemental groups keyed by uid and primary
+  gid. Set associative: a user hashes to one set of GIDCACHE_WAYS
+  records and when the set is full the oldest record in it is
+  evicted. Records expire after gidcache::timeout seconds (0 = never)
+  so group changes are eventually picked up.
+*/
+class gid_t_cache
 {
 public:
-  size_t     size;
-  gid_t_rec  recs[MAXRECS];
-
-private:
-  gid_t_rec * begin(void);
-  gid_t_rec * end(void);
-  gid_t_rec * allocrec(void);
-  gid_t_rec * lower_bound(gid_t_rec   *begin,
-                          gid_t_rec   *end,
-                          const uid_t  uid);
-  gid_t_rec * cache(const uid_t uid,
-                    const gid_t gid);
+  gid_t_cache();
+  ~gid_t_cache();
 
 public:
   int
   initgroups(const uid_t uid,
              const gid_t gid);
+
+private:
+  gid_t_rec * lookup(const uid_t    uid,
+                     const gid_t    gid,
+                     const uint64_t now);
+  gid_t_rec * cache(const uid_t    uid,
+                    const gid_t    gid,
+                    const uint64_t now);
+  int         setgroups(const gid_t_rec *rec);
+
+public:
+  struct Stats
+  {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t expired;
+    uint64_t evicted;
+    uint64_t setgroups_skipped;
+  };
+
+  static void sum(Stats *stats);
+
+private:
+  gid_t_rec          recs[GIDCACHE_SETS * GIDCACHE_WAYS];
+  bool               current_valid;
+  std::vector<gid_t> current;
+  Stats              stats;
+  gid_t_cache       *prev;
+  gid_t_cache       *next;
 };
+
+namespace gidcache
+{
+  extern uint64_t timeout;
+
+  uint64_t hits(void);
+  uint64_t misses(void);
+  uint64_t expired(void);
+  uint64_t evicted(void);
+  uint64_t setgroups_skipped(void);
+}
@@ -0,0 +1,67 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "linkcow.hpp"
+
+#include "errno.hpp"
+#include "fileinfo.hpp"
+#include "fs_cow.hpp"
+#include "ugid.hpp"
+
+#include <fuse.h>
+
+#include <pthread.h>
+
+namespace linkcow
+{
+  /*
+    The handle was opened on a file with multiple links but breaking
+    the link was put off till now. Done with the handle locked
+    exclusively so no write lands on the shared file while the copy is
+    made. On failure the break stays pending so nothing gets written
+    through to the other links.
+  */
+  int
+  break_deferred(FileInfo *fi_)
+  {
+    int rv;
+    fs::cow::Deferred *cow;
+    const fuse_context *fc = fuse_get_context();
+    const ugid::Set     ugid(fc->uid,fc->gid);
+
+    rv = 0;
+    pthread_rwlock_wrlock(&fi_->lock);
+    if(fi_->cow != NULL)
+      {
+        rv = fs::cow::break_link(fi_->cow->fullpath.c_str(),
+                                 fi_->fd,
+                                 fi_->cow->flags);
+        if(rv == -1)
+          rv = -errno;
+        else
+          {
+            cow = fi_->cow;
+            __atomic_store_n(&fi_->cow,NULL,__ATOMIC_RELEASE);
+            delete cow;
+          }
+      }
+    pthread_rwlock_unlock(&fi_->lock);
+
+    return rv;
+  }
+}
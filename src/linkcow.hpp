@@ -0,0 +1,43 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "fileinfo.hpp"
+
+namespace linkcow
+{
+  int
+  break_deferred(FileInfo *fi);
+
+  /*
+    To be called before anything which modifies the file through the
+    handle. Returns 0 or -errno. The pointer is only tested here,
+    break_deferred() rechecks it under the handle's lock.
+  */
+  static
+  inline
+  int
+  prepare_write(FileInfo *fi_)
+  {
+    if(__atomic_load_n(&fi_->cow,__ATOMIC_ACQUIRE) == NULL)
+      return 0;
+
+    return linkcow::break_deferred(fi_);
+  }
+}
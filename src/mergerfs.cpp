@@ -22,6 +22,7 @@
 #include "fuse_access.hpp"
 #include "fuse_chmod.hpp"
 #include "fuse_chown.hpp"
+#include "fuse_copy_file_range.hpp"
 #include "fuse_create.hpp"
 #include "fuse_destroy.hpp"
 #include "fuse_fallocate.hpp"
@@ -37,6 +38,7 @@
 #include "fuse_ioctl.hpp"
 #include "fuse_link.hpp"
 #include "fuse_listxattr.hpp"
+#include "fuse_lseek.hpp"
 #include "fuse_mkdir.hpp"
 #include "fuse_mknod.hpp"
 #include "fuse_open.hpp"
@@ -81,6 +83,9 @@ namespace l
     ops.bmap        = NULL;
     ops.chmod       = FUSE::chmod;
     ops.chown       = FUSE::chown;
+    ops.copy_file_range = (nullrw ?
+                           NULL :
+                           FUSE::copy_file_range);
     ops.create      = FUSE::create;
     ops.destroy     = FUSE::destroy;
     ops.fallocate   = FUSE::fallocate;
@@ -98,6 +103,7 @@ namespace l
     ops.link        = FUSE::link;
     ops.listxattr   = FUSE::listxattr;
     ops.lock        = NULL;
+    ops.lseek       = FUSE::lseek;
     ops.mkdir       = FUSE::mkdir;
     ops.mknod       = FUSE::mknod;
     ops.open        = FUSE::open;
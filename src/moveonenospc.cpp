@@ -0,0 +1,273 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "config.hpp"
+#include "errno.hpp"
+#include "fileinfo.hpp"
+#include "fs_movefile.hpp"
+#include "moveonenospc.hpp"
+#include "ugid.hpp"
+
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <pthread.h>
+
+using std::string;
+using std::vector;
+
+/*
+  Guards FileInfo::movefile for those waiting on another thread's
+  move of the same file.
+*/
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_cond = PTHREAD_COND_INITIALIZER;
+
+namespace l
+{
+  static
+  void
+  set_movefile(FileInfo     *fi_,
+               fs::MoveFile *movefile_)
+  {
+    pthread_mutex_lock(&g_lock);
+    __atomic_store_n(&fi_->movefile,movefile_,__ATOMIC_RELEASE);
+    if(movefile_ == NULL)
+      pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+  }
+
+  static
+  void
+  wait_for_move(FileInfo *fi_)
+  {
+    pthread_mutex_lock(&g_lock);
+    while(fi_->movefile != NULL)
+      pthread_cond_wait(&g_cond,&g_lock);
+    pthread_mutex_unlock(&g_lock);
+  }
+
+  /*
+    Copies with no lock held then takes the FileInfo lock exclusively
+    only for the switchover. If the move fails the queued writes are
+    still attempted against the original and any error is kept for
+    flush, fsync, and release to report.
+  */
+  static
+  void
+  run(FileInfo     *fi_,
+      fs::MoveFile *movefile_)
+  {
+    int rv;
+
+    rv = movefile_->copy();
+
+    pthread_rwlock_wrlock(&fi_->lock);
+    if(rv != -1)
+      rv = movefile_->finish(fi_->fd);
+    if((rv == -1) && movefile_->deferred())
+      {
+        if(movefile_->write_deferred(fi_->fd) == -1)
+          __atomic_store_n(&fi_->moveerror,errno,__ATOMIC_RELEASE);
+      }
+    l::set_movefile(fi_,NULL);
+    pthread_rwlock_unlock(&fi_->lock);
+
+    delete movefile_;
+  }
+
+  struct Job
+  {
+    FileInfo     *fi;
+    fs::MoveFile *movefile;
+  };
+
+  static
+  void *
+  run_thread(void *job_)
+  {
+    Job *job = (Job*)job_;
+    const ugid::Set ugid(0,0);
+
+    l::run(job->fi,job->movefile);
+
+    delete job;
+
+    return NULL;
+  }
+
+  // runs the move in place if a thread can't be had
+  static
+  void
+  start(FileInfo     *fi_,
+        fs::MoveFile *movefile_)
+  {
+    int rv;
+    Job *job;
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    job = new Job();
+    job->fi       = fi_;
+    job->movefile = movefile_;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    rv = pthread_create(&thread,&attr,l::run_thread,job);
+    pthread_attr_destroy(&attr);
+    if(rv == 0)
+      return;
+
+    delete job;
+    l::run(fi_,movefile_);
+  }
+}
+
+namespace moveonenospc
+{
+  /*
+    Only the setup and the final switchover exclude writes to the
+    file. The bulk copy runs on a thread of its own. The write which
+    ran out of space, and any which follow while the move runs, have
+    their data queued on the move, applied by the switchover, and
+    return immediately. If the queue is full, or there is no data to
+    queue as with copy_file_range, they wait for the move to finish
+    and retry. Writes which got to the source before the first was
+    queued are recorded so they can be recopied.
+
+    Returns -1 on failure, 0 when the file was moved and the write
+    should be retried, and the count when the write was queued.
+  */
+  int
+  move(const Config &config_,
+       FileInfo     *fi_,
+       const char   *buf_,
+       const size_t  count_,
+       const off_t   offset_)
+  {
+    int rv;
+    int error;
+    bool queued;
+    vector<string> paths;
+    fs::MoveFile *movefile;
+    const ugid::Set ugid(0,0);
+
+    {
+      const Branches::Snapshot branches(config_.branches);
+
+      branches->to_paths(paths);
+    }
+
+    pthread_rwlock_wrlock(&fi_->lock);
+    if(fi_->movefile != NULL)
+      {
+        if(buf_ != NULL)
+          {
+            rv = fi_->movefile->defer(buf_,count_,offset_);
+            if(rv != -1)
+              {
+                pthread_rwlock_unlock(&fi_->lock);
+                return rv;
+              }
+          }
+
+        pthread_rwlock_unlock(&fi_->lock);
+        l::wait_for_move(fi_);
+        return 0;
+      }
+
+    movefile = new fs::MoveFile(fi_->fusepath.c_str());
+    rv = movefile->prepare(paths,count_,fi_->fd);
+    if(rv == -1)
+      {
+        error = errno;
+        pthread_rwlock_unlock(&fi_->lock);
+        delete movefile;
+        return (errno=error,-1);
+      }
+
+    queued = ((buf_ != NULL) && (movefile->defer(buf_,count_,offset_) != -1));
+
+    l::set_movefile(fi_,movefile);
+    pthread_rwlock_unlock(&fi_->lock);
+
+    l::start(fi_,movefile);
+    if(queued)
+      return count_;
+
+    l::wait_for_move(fi_);
+
+    return 0;
+  }
+
+  /*
+    The move may still be using the descriptor. The mover clears
+    movefile with the FileInfo lock held so taking it ensures the
+    mover is done with the FileInfo as well.
+  */
+  void
+  wait(FileInfo *fi_)
+  {
+    l::wait_for_move(fi_);
+    pthread_rwlock_wrlock(&fi_->lock);
+    pthread_rwlock_unlock(&fi_->lock);
+  }
+
+  /*
+    Writes hold the lock shared so the switchover can exclude them.
+    Without moveonenospc no move can start so unless one is already
+    running there is nothing to exclude.
+  */
+  pthread_rwlock_t *
+  write_lock(const bool  enabled_,
+             FileInfo   *fi_)
+  {
+    if(enabled_ || (__atomic_load_n(&fi_->movefile,__ATOMIC_ACQUIRE) != NULL))
+      return &fi_->lock;
+
+    return NULL;
+  }
+
+  // called with the FileInfo lock held
+  bool
+  deferring(FileInfo *fi_)
+  {
+    return ((fi_->movefile != NULL) && fi_->movefile->deferred());
+  }
+
+  // reads of queued data have to wait for it to land
+  void
+  wait_for_deferred(FileInfo *fi_)
+  {
+    if(__atomic_load_n(&fi_->movefile,__ATOMIC_ACQUIRE) == NULL)
+      return;
+
+    pthread_mutex_lock(&g_lock);
+    while((fi_->movefile != NULL) && fi_->movefile->deferred())
+      pthread_cond_wait(&g_cond,&g_lock);
+    pthread_mutex_unlock(&g_lock);
+  }
+
+  // queued data which couldn't be written after a failed move
+  int
+  error(FileInfo *fi_)
+  {
+    return -__atomic_exchange_n(&fi_->moveerror,0,__ATOMIC_ACQ_REL);
+  }
+}
@@ -0,0 +1,52 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.hpp"
+#include "fileinfo.hpp"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+namespace moveonenospc
+{
+  int
+  move(const Config   &config,
+       FileInfo       *fi,
+       const char     *buf,
+       const size_t    count,
+       const off_t     offset);
+
+  pthread_rwlock_t *
+  write_lock(const bool  enabled,
+             FileInfo   *fi);
+
+  bool
+  deferring(FileInfo *fi);
+
+  void
+  wait(FileInfo *fi);
+
+  void
+  wait_for_deferred(FileInfo *fi);
+
+  int
+  error(FileInfo *fi);
+}
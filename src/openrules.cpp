@@ -0,0 +1,285 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "errno.hpp"
+#include "fs_base_stat.hpp"
+#include "num.hpp"
+#include "openrules.hpp"
+#include "rwlock.hpp"
+#include "str.hpp"
+
+#include <fuse.h>
+
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+
+namespace l
+{
+  static
+  int
+  parse_access(const string &str_,
+               int          &access_)
+  {
+    if(str_ == "ro")
+      access_ = O_RDONLY;
+    else if(str_ == "wo")
+      access_ = O_WRONLY;
+    else if(str_ == "rw")
+      access_ = O_RDWR;
+    else
+      return (errno=EINVAL,-1);
+
+    return 0;
+  }
+
+  static
+  int
+  parse_condition(const string         &str_,
+                  OpenRules::Condition &cond_)
+  {
+    string key;
+    string val;
+    size_t i;
+
+    i = str_.find_first_of("~<>");
+    if((i == string::npos) || (i == 0))
+      return (errno=EINVAL,-1);
+
+    key = str_.substr(0,i);
+    val = str_.substr(i + 1);
+    if(val.empty())
+      return (errno=EINVAL,-1);
+
+    switch(str_[i])
+      {
+      case '~':
+        if(key == "path")
+          cond_.type = OpenRules::Condition::PATH;
+        else if(key == "branch")
+          cond_.type = OpenRules::Condition::BRANCH;
+        else if(key == "access")
+          {
+            cond_.type = OpenRules::Condition::ACCESS;
+            return l::parse_access(val,cond_.access);
+          }
+        else
+          return (errno=EINVAL,-1);
+        cond_.glob = val;
+        return 0;
+      case '>':
+      case '<':
+        if(key != "size")
+          return (errno=EINVAL,-1);
+        cond_.type = ((str_[i] == '>') ?
+                      OpenRules::Condition::SIZE_GT :
+                      OpenRules::Condition::SIZE_LT);
+        if(num::to_uint64_t(val,cond_.size) == -1)
+          return (errno=EINVAL,-1);
+        return 0;
+      }
+
+    return (errno=EINVAL,-1);
+  }
+
+  static
+  int
+  parse_action(const string    &str_,
+               OpenRules::Rule &rule_)
+  {
+    if(str_ == "direct_io")
+      rule_.direct_io = 1;
+    else if(str_ == "nodirect_io")
+      rule_.direct_io = 0;
+    else if(str_ == "keep_cache")
+      rule_.keep_cache = 1;
+    else if(str_ == "noprealloc")
+      rule_.prealloc = 0;
+    else
+      return (errno=EINVAL,-1);
+
+    return 0;
+  }
+
+  static
+  int
+  parse_rule(const string    &str_,
+             OpenRules::Rule &rule_)
+  {
+    int rv;
+    size_t i;
+    vector<string> conds;
+    vector<string> actions;
+
+    i = str_.rfind(':');
+    if(i == string::npos)
+      return (errno=EINVAL,-1);
+
+    str::split(conds,str_.substr(0,i),'&');
+    str::split(actions,str_.substr(i + 1),'&');
+    if(conds.empty() || actions.empty())
+      return (errno=EINVAL,-1);
+
+    rule_.direct_io  = -1;
+    rule_.keep_cache = -1;
+    rule_.prealloc   = -1;
+    rule_.conditions.resize(conds.size());
+    for(size_t j = 0; j < conds.size(); j++)
+      {
+        rv = l::parse_condition(conds[j],rule_.conditions[j]);
+        if(rv == -1)
+          return -1;
+      }
+
+    for(size_t j = 0; j < actions.size(); j++)
+      {
+        rv = l::parse_action(actions[j],rule_);
+        if(rv == -1)
+          return -1;
+      }
+
+    return 0;
+  }
+
+  static
+  bool
+  matches(const OpenRules::Condition &cond_,
+          const char                 *fusepath_,
+          const char                 *branch_,
+          const int                   flags_,
+          const int                   fd_,
+          struct stat                *st_)
+  {
+    int rv;
+
+    switch(cond_.type)
+      {
+      case OpenRules::Condition::PATH:
+        return (::fnmatch(cond_.glob.c_str(),fusepath_,0) == 0);
+      case OpenRules::Condition::BRANCH:
+        return (::fnmatch(cond_.glob.c_str(),branch_,0) == 0);
+      case OpenRules::Condition::ACCESS:
+        return ((flags_ & O_ACCMODE) == cond_.access);
+      case OpenRules::Condition::SIZE_GT:
+      case OpenRules::Condition::SIZE_LT:
+        if(st_->st_size == -1)
+          {
+            rv = fs::fstat(fd_,st_);
+            if(rv == -1)
+              return false;
+          }
+        if(cond_.type == OpenRules::Condition::SIZE_GT)
+          return ((uint64_t)st_->st_size > cond_.size);
+        return ((uint64_t)st_->st_size < cond_.size);
+      }
+
+    return false;
+  }
+}
+
+OpenRules::OpenRules()
+{
+  pthread_rwlock_init(&_lock,NULL);
+}
+
+OpenRules::~OpenRules()
+{
+  pthread_rwlock_destroy(&_lock);
+}
+
+int
+OpenRules::from_string(const string &str_)
+{
+  int rv;
+  vector<Rule> rules;
+  vector<string> strs;
+
+  str::split(strs,str_,';');
+
+  for(size_t i = 0; i < strs.size(); i++)
+    {
+      if(strs[i].empty())
+        continue;
+
+      rules.push_back(Rule());
+      rv = l::parse_rule(strs[i],rules.back());
+      if(rv == -1)
+        return -1;
+    }
+
+  {
+    const rwlock::WriteGuard guard(&_lock);
+
+    _str = str_;
+    _rules.swap(rules);
+  }
+
+  return 0;
+}
+
+string
+OpenRules::to_string(void) const
+{
+  const rwlock::ReadGuard guard(&_lock);
+
+  return _str;
+}
+
+void
+OpenRules::apply(const char     *fusepath_,
+                 const char     *branch_,
+                 const int       flags_,
+                 const int       fd_,
+                 fuse_file_info *ffi_,
+                 bool           *prealloc_,
+                 bool           *passthrough_) const
+{
+  bool match;
+  struct stat st;
+  const rwlock::ReadGuard guard(&_lock);
+
+  st.st_size = -1;
+  for(size_t i = 0, ei = _rules.size(); i != ei; i++)
+    {
+      const Rule &rule = _rules[i];
+
+      match = true;
+      for(size_t j = 0, ej = rule.conditions.size(); (j != ej) && match; j++)
+        match = l::matches(rule.conditions[j],fusepath_,branch_,flags_,fd_,&st);
+      if(!match)
+        continue;
+
+      if(rule.direct_io != -1)
+        ffi_->direct_io = rule.direct_io;
+      if(rule.direct_io == 1)
+        *passthrough_ = false;
+      if(rule.keep_cache != -1)
+        ffi_->keep_cache = rule.keep_cache;
+      if(rule.prealloc != -1)
+        *prealloc_ = rule.prealloc;
+
+      return;
+    }
+}
@@ -0,0 +1,93 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+
+struct fuse_file_info;
+
+/*
+  Ordered list of rules deciding direct_io, keep_cache, and
+  preallocation for each opened file. The first rule whose conditions all match applies.
+  A rule choosing direct_io also keeps the file out of passthrough.
+
+  rules      := rule[;rule...]
+  rule       := condition[&condition...]:action[&action...]
+  condition  := path~GLOB | branch~GLOB | access~ro|wo|rw
+              | size>BYTES | size<BYTES
+  action     := direct_io | nodirect_io | keep_cache | noprealloc
+*/
+class OpenRules
+{
+public:
+  struct Condition
+  {
+    enum Type
+      {
+        PATH,
+        BRANCH,
+        ACCESS,
+        SIZE_GT,
+        SIZE_LT
+      };
+
+    Type        type;
+    std::string glob;
+    int         access;
+    uint64_t    size;
+  };
+
+  struct Rule
+  {
+    std::vector<Condition> conditions;
+    int                    direct_io;
+    int                    keep_cache;
+    int                    prealloc;
+  };
+
+public:
+  OpenRules();
+  ~OpenRules();
+
+public:
+  int         from_string(const std::string &str);
+  std::string to_string(void) const;
+
+public:
+  void apply(const char     *fusepath,
+             const char     *branch,
+             const int       flags,
+             const int       fd,
+             fuse_file_info *ffi,
+             bool           *prealloc,
+             bool           *passthrough) const;
+
+private:
+  OpenRules(const OpenRules&);
+  OpenRules &operator=(const OpenRules&);
+
+private:
+  mutable pthread_rwlock_t _lock;
+  std::string              _str;
+  std::vector<Rule>        _rules;
+};
@@ -16,8 +16,10 @@
 
 #include "config.hpp"
 #include "errno.hpp"
+#include "fs_acl_cache.hpp"
 #include "fs_glob.hpp"
 #include "fs_statvfs_cache.hpp"
+#include "gidcache.hpp"
 #include "num.hpp"
 #include "policy.hpp"
 #include "str.hpp"
@@ -118,6 +120,19 @@ parse_and_process(const std::string &value_,
   return 0;
 }
 
+// branches may come before the option on the command line
+static
+void
+open_branch_fds(Config &config)
+{
+  Branches *branches;
+
+  branches = new Branches(*config.branches.load());
+  branches->open_fds();
+
+  Branches::publish(config.branches,branches);
+}
+
 static
 int
 parse_and_process(const std::string &value,
@@ -212,6 +227,22 @@ parse_and_process_statfs_cache(const std::string &value_)
   return 0;
 }
 
+static
+int
+parse_and_process_acl_cache(const std::string &value_)
+{
+  int rv;
+  uint64_t timeout;
+
+  rv = num::to_uint64_t(value_,timeout);
+  if(rv == -1)
+    return 1;
+
+  fs::acl::cache_timeout(timeout);
+
+  return 0;
+}
+
 static
 int
 parse_and_process_cache(Config       &config_,
@@ -221,8 +252,20 @@ parse_and_process_cache(Config       &config_,
 {
   if(func_ == "open")
     return parse_and_process(value_,config_.open_cache.timeout);
+  else if(func_ == "enoent")
+    return parse_and_process(value_,config_.enoent_cache.timeout);
+  else if(func_ == "enoattr")
+    return parse_and_process(value_,config_.enoattr_cache.timeout);
+  else if(func_ == "enoattr_names")
+    return (config_.enoattr_cache.names(value_),0);
+  else if(func_ == "clonepath")
+    return parse_and_process(value_,config_.clonepath_cache.timeout);
   else if(func_ == "statfs")
     return parse_and_process_statfs_cache(value_);
+  else if(func_ == "groups")
+    return parse_and_process(value_,gidcache::timeout);
+  else if(func_ == "acl")
+    return parse_and_process_acl_cache(value_);
   else if(func_ == "entry")
     return (set_kv_option(outargs,"entry_timeout",value_),0);
   else if(func_ == "negative_entry")
@@ -273,8 +316,16 @@ parse_and_process_kv_arg(Config            &config,
         rv = parse_and_process(value,config.minfreespace);
       else if(key == "moveonenospc")
         rv = parse_and_process(value,config.moveonenospc);
+      else if(key == "branch_fds")
+        rv = parse_and_process(value,config.branch_fds);
       else if(key == "dropcacheonclose")
         rv = parse_and_process(value,config.dropcacheonclose);
+      else if(key == "dropcacheonclose_minsize")
+        rv = parse_and_process(value,config.dropcacheonclose_minsize);
+      else if(key == "dropcacheonclose_streamed")
+        rv = parse_and_process(value,config.dropcacheonclose_streamed);
+      else if(key == "dropcacheonclose_budget")
+        rv = parse_and_process(value,config.dropcacheonclose_budget);
       else if(key == "symlinkify")
         rv = parse_and_process(value,config.symlinkify);
       else if(key == "symlinkify_timeout")
@@ -285,8 +336,26 @@ parse_and_process_kv_arg(Config            &config,
         rv = parse_and_process(value,config.ignorepponrename);
       else if(key == "security_capability")
         rv = parse_and_process(value,config.security_capability);
+      else if(key == "getattr_coalesce")
+        rv = parse_and_process(value,config.getattr_coalesce);
       else if(key == "link_cow")
         rv = parse_and_process(value,config.link_cow);
+      else if(key == "link_cow_lazy")
+        rv = parse_and_process(value,config.link_cow_lazy);
+      else if(key == "share_rdonly_fds")
+        rv = parse_and_process(value,config.share_rdonly_fds);
+      else if(key == "passthrough")
+        rv = parse_and_process(value,config.passthrough);
+      else if(key == "readahead")
+        rv = parse_and_process(value,config.readahead);
+      else if(key == "writecombine")
+        rv = parse_and_process(value,config.writecombine);
+      else if(key == "fanout")
+        rv = parse_and_process(value,config.fanout);
+      else if(key == "prealloc")
+        rv = parse_and_process(value,config.prealloc);
+      else if(key == "open_rules")
+        rv = config.open_rules.from_string(value);
       else if(key == "xattr")
         rv = parse_and_process_errno(value,config.xattr);
       else if(key == "statfs")
@@ -334,7 +403,12 @@ int
 process_branches(const char *arg,
                  Config     &config)
 {
-  config.branches.set(arg);
+  Branches *branches;
+
+  branches = new Branches();
+  branches->set(arg);
+
+  Branches::publish(config.branches,branches);
 
   return 0;
 }
@@ -369,6 +443,27 @@ usage(void)
     "                           default = 0 (disabled)\n"
     "    -o cache.statfs=<int>  'statfs' cache timeout in seconds. Used by\n"
     "                           policies. default = 0 (disabled)\n"
+    "    -o cache.enoent=<int>  timeout in seconds for mergerfs' own cache\n"
+    "                           of paths missing from all branches.\n"
+    "                           default = 0 (disabled)\n"
+    "    -o cache.enoattr=<int> timeout in seconds for mergerfs' own cache\n"
+    "                           of extended attributes missing from a path.\n"
+    "                           default = 0 (disabled)\n"
+    "    -o cache.enoattr_names=<names>\n"
+    "                           ':' separated attribute names the above\n"
+    "                           applies to. default = security.capability:\n"
+    "                           system.posix_acl_access:\n"
+    "                           system.posix_acl_default\n"
+    "    -o cache.clonepath=<int>\n"
+    "                           timeout in seconds for the cache of\n"
+    "                           directories known to exist on each branch\n"
+    "                           when cloning paths. default = 0 (disabled)\n"
+    "    -o cache.groups=<int>  timeout in seconds for the per thread cache\n"
+    "                           of users' supplemental groups. 0 = never\n"
+    "                           expire. default = 60\n"
+    "    -o cache.acl=<int>     timeout in seconds for the cache of whether\n"
+    "                           directories have a default ACL. Used when\n"
+    "                           creating files. default = 0 (disabled)\n"
     "    -o cache.attr=<int>    file attribute cache timeout in seconds.\n"
     "                           default = 1\n"
     "    -o cache.entry=<int>   file name lookup cache timeout in seconds.\n"
@@ -379,16 +474,31 @@ usage(void)
     "    -o direct_io           Bypass page caching, may increase write\n"
     "                           speeds at the cost of reads. Please read docs\n"
     "                           for more details as there are tradeoffs.\n"
+    "    -o handover=<path>     Unix socket used to hand the mount over to a\n"
+    "                           new mergerfs without unmounting.\n"
     "    -o use_ino             Have mergerfs generate inode values rather than\n"
     "                           autogenerated by libfuse. Suggested.\n"
     "    -o minfreespace=<int>  minimum free space needed for certain policies.\n"
     "                           default = 4G\n"
     "    -o moveonenospc=<bool> Try to move file to another drive when ENOSPC\n"
     "                           on write. default = false\n"
+    "    -o branch_fds=<bool>   Keep a descriptor to each branch's root and\n"
+    "                           resolve paths relative to it. Keeps branches\n"
+    "                           from being unmounted. default = false\n"
     "    -o dropcacheonclose=<bool>\n"
     "                           When a file is closed suggest to OS it drop\n"
     "                           the file's cache. This is useful when direct_io\n"
     "                           is disabled. default = false\n"
+    "    -o dropcacheonclose_minsize=<int>\n"
+    "                           Only drop the cache of files at least this\n"
+    "                           size. default = 0\n"
+    "    -o dropcacheonclose_streamed=<bool>\n"
+    "                           Also drop files smaller than the min size\n"
+    "                           which were read once sequentially.\n"
+    "                           default = false\n"
+    "    -o dropcacheonclose_budget=<int>\n"
+    "                           Estimated max page cache kept for files not\n"
+    "                           dropped. 0 is unlimited. default = 0\n"
     "    -o symlinkify=<bool>   Read-only files, after a timeout, will be turned\n"
     "                           into symlinks. Read docs for limitations and\n"
     "                           possible issues. default = false\n"
@@ -402,9 +512,36 @@ usage(void)
     "                           and links. default = false\n"
     "    -o link_cow=<bool>     delink/clone file on open to simulate CoW.\n"
     "                           default = false\n"
+    "    -o link_cow_lazy=<bool>\n"
+    "                           put off link_cow's copy until the first\n"
+    "                           write or truncate. default = false\n"
+    "    -o share_rdonly_fds=<bool>\n"
+    "                           read-only opens of the same file share one\n"
+    "                           branch file descriptor. default = false\n"
+    "    -o passthrough=<bool>  Have the kernel perform reads and writes\n"
+    "                           directly on the branch file. Ignored if\n"
+    "                           nullrw, moveonenospc, or link_cow are\n"
+    "                           enabled. default = false\n"
+    "    -o readahead=<int>     Max window to read ahead of sequential readers\n"
+    "                           of branch files. 0 disables. default = 0\n"
+    "    -o open_rules=<rules>  Per file direct_io and keep_cache decisions\n"
+    "                           based on path, branch, access mode, and size.\n"
+    "                           See README for syntax. default = none\n"
+    "    -o writecombine=<int>  With direct_io buffer up to this many bytes\n"
+    "                           of contiguous writes per file before writing\n"
+    "                           them to the branch. 0 disables. default = 0\n"
+    "    -o fanout=<int>        Threads used to apply action category\n"
+    "                           functions to multiple branches at once.\n"
+    "                           0 runs them one after another. default = 0\n"
+    "    -o prealloc=<int>      Max space to reserve past the end of files\n"
+    "                           being appended to. Released on close.\n"
+    "                           0 disables. default = 0\n"
     "    -o security_capability=<bool>\n"
     "                           When disabled return ENOATTR when the xattr\n"
     "                           security.capability is queried. default = true\n"
+    "    -o getattr_coalesce=<bool>\n"
+    "                           Concurrent identical getattr requests share\n"
+    "                           one result. default = false\n"
     "    -o xattr=passthrough|noattr|nosys\n"
     "                           Runtime control of xattrs. By default xattr\n"
     "                           requests will pass through to the underlying\n"
@@ -441,7 +578,7 @@ option_processor(void       *data,
       break;
 
     case FUSE_OPT_KEY_NONOPT:
-      rv = config.branches.empty() ?
+      rv = config.branches.load()->empty() ?
         process_branches(arg,config) :
         process_destmounts(arg,config);
       break;
@@ -488,8 +625,11 @@ namespace options
                    opts,
                    ::option_processor);
 
+    if(config->branch_fds)
+      open_branch_fds(*config);
+
     set_default_options(args);
-    set_fsname(args,config->branches);
+    set_fsname(args,*config->branches.load());
     set_subtype(args);
   }
 }
@@ -0,0 +1,202 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "fileinfo.hpp"
+#include "fs_base_stat.hpp"
+#include "passthrough.hpp"
+#include "ugid.hpp"
+
+#include <fuse.h>
+
+#include <map>
+#include <utility>
+
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+typedef std::pair<dev_t,ino_t> Key;
+
+struct Backing
+{
+  int id;
+  int refs;
+};
+
+typedef std::map<Key,Backing> BackingMap;
+typedef std::map<int,Key>     IdMap;
+
+static BackingMap      g_backing;
+static IdMap           g_ids;
+static pthread_mutex_t g_backing_lock = PTHREAD_MUTEX_INITIALIZER;
+
+namespace l
+{
+  /*
+    With register_ false only an already registered backing file is
+    shared, nothing new is registered.
+  */
+  static
+  int
+  backing_open(struct fuse *fuse_,
+               const int    fd_,
+               const bool   register_)
+  {
+    int rv;
+    Key key;
+    struct stat st;
+    BackingMap::iterator i;
+
+    rv = fs::fstat(fd_,&st);
+    if(rv == -1)
+      return 0;
+
+    key = Key(st.st_dev,st.st_ino);
+
+    pthread_mutex_lock(&g_backing_lock);
+
+    i = g_backing.find(key);
+    if(i != g_backing.end())
+      {
+        i->second.refs++;
+        rv = i->second.id;
+      }
+    else if(!register_)
+      {
+        rv = 0;
+      }
+    else
+      {
+        {
+          const ugid::SetRootGuard ugidGuard;
+
+          rv = fuse_passthrough_open(fuse_,fd_);
+        }
+
+        if(rv > 0)
+          {
+            Backing b = {rv,1};
+
+            g_backing.insert(BackingMap::value_type(key,b));
+            g_ids.insert(IdMap::value_type(rv,key));
+          }
+      }
+
+    pthread_mutex_unlock(&g_backing_lock);
+
+    return ((rv > 0) ? rv : 0);
+  }
+
+  static
+  void
+  backing_close(struct fuse *fuse_,
+                const int    id_)
+  {
+    IdMap::iterator i;
+    BackingMap::iterator b;
+
+    pthread_mutex_lock(&g_backing_lock);
+
+    i = g_ids.find(id_);
+    if(i != g_ids.end())
+      {
+        b = g_backing.find(i->second);
+        b->second.refs--;
+        if(b->second.refs == 0)
+          {
+            {
+              const ugid::SetRootGuard ugidGuard;
+
+              fuse_passthrough_close(fuse_,id_);
+            }
+
+            g_backing.erase(b);
+            g_ids.erase(i);
+          }
+      }
+
+    pthread_mutex_unlock(&g_backing_lock);
+  }
+}
+
+namespace passthrough
+{
+  /*
+    moveonenospc, link_cow, and nullrw all depend on mergerfs seeing
+    the reads and writes. nullrw can only be set at mount and the
+    others are refused at runtime while passthrough is negotiated (see
+    open() for why) but they're cheap enough to check on every open.
+  */
+  bool
+  enabled(const Config &config_)
+  {
+    return (config_.passthrough   &&
+            !config_.nullrw       &&
+            !config_.moveonenospc &&
+            !config_.link_cow);
+  }
+
+  /*
+    Failure to register a backing file is not an error. The open
+    simply falls back to the regular userspace read/write path.
+
+    The kernel fails (EIO) any open of an inode which has passthrough
+    opens that isn't itself passthrough and any passthrough open of an
+    inode which has page cached opens. So while passthrough is
+    negotiated an open kept out of it, as by an open_rules direct_io
+    action, still joins the inode's backing file if it has one and
+    otherwise is made direct_io so it doesn't block passthrough opens
+    which come later.
+  */
+  void
+  open(const Config   &config_,
+       struct fuse    *fuse_,
+       FileInfo       *fi_,
+       fuse_file_info *ffi_,
+       const bool      passthrough_)
+  {
+    int id;
+
+    id = 0;
+    if(config_.passthrough)
+      id = l::backing_open(fuse_,fi_->fd,passthrough_);
+    if(id == 0)
+      {
+        if(config_.passthrough)
+          {
+            fi_->direct_io  = true;
+            ffi_->direct_io = 1;
+          }
+        return;
+      }
+
+    fi_->backing_id  = id;
+    ffi_->backing_id = id;
+    ffi_->direct_io  = 0;
+  }
+
+  void
+  release(struct fuse *fuse_,
+          FileInfo    *fi_)
+  {
+    if(fi_->backing_id == 0)
+      return;
+
+    l::backing_close(fuse_,fi_->backing_id);
+  }
+}
@@ -0,0 +1,42 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include "config.hpp"
+#include "fileinfo.hpp"
+
+#include <fuse.h>
+
+/*
+  FUSE passthrough. The kernel requires every passthrough open of a
+  FUSE inode to use the same backing id so ids are shared between
+  opens of the same underlying file and refcounted.
+*/
+
+namespace passthrough
+{
+  bool enabled(const Config &config_);
+  void open(const Config   &config_,
+            struct fuse    *fuse_,
+            FileInfo       *fi_,
+            fuse_file_info *ffi_,
+            const bool      passthrough_);
+  void release(struct fuse *fuse_,
+               FileInfo    *fi_);
+}
@@ -0,0 +1,230 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "path_cache.hpp"
+
+#include <map>
+#include <string>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+using std::string;
+
+namespace l
+{
+  static
+  uint64_t
+  get_time(void)
+  {
+    uint64_t rv;
+    struct timeval now;
+
+    ::gettimeofday(&now,NULL);
+
+    rv = now.tv_sec;
+
+    return rv;
+  }
+}
+
+PathCache::PathCache(void)
+  : timeout(0),
+    _generation(0),
+    _next_expire(0)
+{
+  pthread_mutex_init(&_lock,NULL);
+}
+
+PathCache::~PathCache(void)
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+bool
+PathCache::get(const char *path_,
+               const char *name_,
+               uint64_t   *value_)
+{
+  bool found;
+  uint64_t now;
+  Paths::iterator p;
+  Names::iterator n;
+
+  if(timeout == 0)
+    return false;
+
+  found = false;
+  now   = l::get_time();
+
+  pthread_mutex_lock(&_lock);
+
+  p = _cache.find(path_);
+  if(p != _cache.end())
+    {
+      n = p->second.find(name_);
+      if(n != p->second.end())
+        {
+          found = ((now - n->second.time) < timeout);
+          if(found && value_)
+            *value_ = n->second.value;
+          if(!found)
+            p->second.erase(n);
+          if(p->second.empty())
+            _cache.erase(p);
+        }
+    }
+
+  pthread_mutex_unlock(&_lock);
+
+  return found;
+}
+
+/*
+  Read on every lookup so it is kept out of the lock. Only bumped
+  with the lock held.
+*/
+uint64_t
+PathCache::generation(void) const
+{
+  return __atomic_load_n(&_generation,__ATOMIC_ACQUIRE);
+}
+
+void
+PathCache::insert(const char     *path_,
+                  const char     *name_,
+                  const uint64_t  value_,
+                  const uint64_t  generation_)
+{
+  uint64_t now;
+
+  if(timeout == 0)
+    return;
+
+  now = l::get_time();
+
+  pthread_mutex_lock(&_lock);
+
+  if(generation_ == _generation)
+    {
+      Entry &e = _cache[path_][name_];
+
+      e.time  = now;
+      e.value = value_;
+    }
+
+  if(now >= _next_expire)
+    expire(now);
+
+  pthread_mutex_unlock(&_lock);
+}
+
+/*
+  Nothing is inserted while the timeout is 0 and changing it clears
+  the cache so there is nothing to drop.
+*/
+void
+PathCache::invalidate(const char *path_)
+{
+  if(timeout == 0)
+    return;
+
+  pthread_mutex_lock(&_lock);
+
+  __atomic_add_fetch(&_generation,1,__ATOMIC_RELEASE);
+  _cache.erase(path_);
+
+  pthread_mutex_unlock(&_lock);
+}
+
+/*
+  For removals and renames. Everything below the path moves or goes
+  away with it.
+*/
+void
+PathCache::invalidate_tree(const char *path_)
+{
+  string path;
+  string prefix;
+  Paths::iterator p;
+
+  if(timeout == 0)
+    return;
+
+  path = path_;
+  while((path.size() > 1) && (path[path.size() - 1] == '/'))
+    path.erase(path.size() - 1);
+  prefix = path;
+  if(prefix[prefix.size() - 1] != '/')
+    prefix += '/';
+
+  pthread_mutex_lock(&_lock);
+
+  __atomic_add_fetch(&_generation,1,__ATOMIC_RELEASE);
+  _cache.erase(path);
+
+  p = _cache.lower_bound(prefix);
+  while((p != _cache.end()) && (p->first.compare(0,prefix.size(),prefix) == 0))
+    _cache.erase(p++);
+
+  pthread_mutex_unlock(&_lock);
+}
+
+void
+PathCache::clear(void)
+{
+  pthread_mutex_lock(&_lock);
+
+  __atomic_add_fetch(&_generation,1,__ATOMIC_RELEASE);
+  _cache.clear();
+
+  pthread_mutex_unlock(&_lock);
+}
+
+/*
+  Expired entries are otherwise only dropped when looked up. Sweeping
+  at most once per timeout period bounds the cost of the full walk
+  regardless of how busy the cache is.
+*/
+void
+PathCache::expire(const uint64_t now_)
+{
+  Paths::iterator p;
+  Names::iterator n;
+
+  _next_expire = (now_ + timeout);
+
+  p = _cache.begin();
+  while(p != _cache.end())
+    {
+      n = p->second.begin();
+      while(n != p->second.end())
+        {
+          if((now_ - n->second.time) >= timeout)
+            p->second.erase(n++);
+          else
+            ++n;
+        }
+
+      if(p->second.empty())
+        _cache.erase(p++);
+      else
+        ++p;
+    }
+}
@@ -0,0 +1,81 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <pthread.h>
+#include <stdint.h>
+
+/*
+  Timed cache of values keyed by a FUSE path and a name under it.
+  Entries expire after `timeout` seconds and a timeout of 0 disables
+  the cache entirely. Invalidation works on whole paths or on a path
+  and everything below it.
+
+  Callers take generation() before asking the branches and hand it
+  back to insert. Any invalidation in between bumps the generation
+  and the now possibly stale result is dropped.
+*/
+class PathCache
+{
+public:
+  PathCache(void);
+  ~PathCache(void);
+
+public:
+  bool     get(const char *path_,
+               const char *name_,
+               uint64_t   *value_ = NULL);
+  uint64_t generation(void) const;
+  void     insert(const char     *path_,
+                  const char     *name_,
+                  const uint64_t  value_,
+                  const uint64_t  generation_);
+  void     invalidate(const char *path_);
+  void     invalidate_tree(const char *path_);
+  void     clear(void);
+
+public:
+  uint64_t timeout;
+
+private:
+  struct Entry
+  {
+    uint64_t time;
+    uint64_t value;
+  };
+
+  typedef std::map<std::string,Entry> Names;
+  typedef std::map<std::string,Names> Paths;
+
+private:
+  void expire(const uint64_t now_);
+
+private:
+  PathCache(const PathCache&);
+  PathCache& operator=(const PathCache&);
+
+private:
+  pthread_mutex_t _lock;
+  uint64_t        _generation;
+  uint64_t        _next_expire;
+  Paths           _cache;
+};
@@ -19,6 +19,7 @@
 #include "branch.hpp"
 #include "category.hpp"
 #include "fs.hpp"
+#include "smallvector.hpp"
 
 #include <map>
 #include <string>
@@ -58,7 +59,7 @@ public:
   {
     typedef std::string string;
     typedef std::vector<string> strvec;
-    typedef std::vector<const string*> cstrptrvec;
+    typedef SmallVector<const string*,16> cstrptrvec;
     typedef const string cstring;
     typedef const uint64_t cuint64_t;
     typedef const strvec cstrvec;
@@ -87,14 +88,14 @@ public:
       }
 
       int
-      operator()(const Branches &b,const char *c,cuint64_t d,string *e)
+      operator()(const Branches &b,const char *c,cuint64_t d,const string **e)
       {
         int rv;
         cstrptrvec v;
 
         rv = func(T,b,c,d,v);
         if(!v.empty())
-          *e = *v[0];
+          *e = v[0];
 
         return rv;
       }
@@ -88,17 +88,24 @@ PolicyCache::clear(void)
   pthread_mutex_unlock(&_lock);
 }
 
+/*
+  The cached value is the branch path. It is resolved back to the
+  branch's own string so the caller gets a pointer into the branch
+  list rather than a copy. If the branch has since been removed the
+  entry is treated as expired.
+*/
 int
-PolicyCache::operator()(Policy::Func::Search &func_,
-                        const Branches       &branches_,
-                        const char           *fusepath_,
-                        const uint64_t        minfreespace_,
-                        std::string          *branch_)
+PolicyCache::operator()(Policy::Func::Search  &func_,
+                        const Branches        &branches_,
+                        const char            *fusepath_,
+                        const uint64_t         minfreespace_,
+                        const std::string    **branch_)
 {
   int rv;
   Value *v;
   uint64_t now;
-  string branch;
+  const Branch *branch;
+  const string *basepath;
 
   if(timeout == 0)
     return func_(branches_,fusepath_,minfreespace_,branch_);
@@ -108,19 +115,29 @@ PolicyCache::operator()(Policy::Func::Search &func_,
   pthread_mutex_lock(&_lock);
   v = &_cache[fusepath_];
 
-  if((now - v->time) >= timeout)
+  branch   = NULL;
+  basepath = NULL;
+  if((now - v->time) < timeout)
+    branch = branches_.find(v->path);
+
+  if(branch == NULL)
     {
       pthread_mutex_unlock(&_lock);
-      rv = func_(branches_,fusepath_,minfreespace_,&branch);
+      rv = func_(branches_,fusepath_,minfreespace_,&basepath);
       if(rv == -1)
         return -1;
 
       pthread_mutex_lock(&_lock);
+      v = &_cache[fusepath_];
       v->time = now;
-      v->path = branch;
-    }
+      v->path = *basepath;
 
-  *branch_ = v->path;
+      *branch_ = basepath;
+    }
+  else
+    {
+      *branch_ = &branch->path;
+    }
 
   pthread_mutex_unlock(&_lock);
 
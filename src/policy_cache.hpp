@@ -46,11 +46,11 @@ public:
   void clear(void);
 
 public:
-  int operator()(Policy::Func::Search &func_,
-                 const Branches       &branches_,
-                 const char           *fusepath_,
-                 const uint64_t        minfreespace_,
-                 std::string          *branch_);
+  int operator()(Policy::Func::Search  &func_,
+                 const Branches        &branches_,
+                 const char            *fusepath_,
+                 const uint64_t         minfreespace_,
+                 const std::string    **branch_);
 
 public:
   uint64_t timeout;
@@ -33,10 +33,10 @@ namespace epall
 {
   static
   int
-  create(const Branches        &branches_,
-         const char            *fusepath,
-         const uint64_t         minfreespace,
-         vector<const string*> &paths)
+  create(const Branches           &branches_,
+         const char               *fusepath,
+         const uint64_t            minfreespace,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -48,7 +48,7 @@ namespace epall
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           error_and_continue(error,ENOENT);
         if(branch->ro_or_nc())
           error_and_continue(error,EROFS);
@@ -71,9 +71,9 @@ namespace epall
 
   static
   int
-  action(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  action(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -85,7 +85,7 @@ namespace epall
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           error_and_continue(error,ENOENT);
         if(branch->ro())
           error_and_continue(error,EROFS);
@@ -106,9 +106,9 @@ namespace epall
 
   static
   int
-  search(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  search(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     const Branch *branch;
 
@@ -116,7 +116,7 @@ namespace epall
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           continue;
 
         paths.push_back(&branch->path);
@@ -134,7 +134,7 @@ Policy::Func::epall(const Category::Enum::Type  type,
                     const Branches             &branches_,
                     const char                 *fusepath,
                     const uint64_t              minfreespace,
-                    vector<const string*>      &paths)
+                    Policy::Func::cstrptrvec   &paths)
 {
   switch(type)
     {
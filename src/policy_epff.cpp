@@ -33,10 +33,10 @@ namespace epff
 {
   static
   int
-  create(const Branches        &branches_,
-         const char            *fusepath,
-         const uint64_t         minfreespace,
-         vector<const string*> &paths)
+  create(const Branches           &branches_,
+         const char               *fusepath,
+         const uint64_t            minfreespace,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -48,7 +48,7 @@ namespace epff
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           error_and_continue(error,ENOENT);
         if(branch->ro_or_nc())
           error_and_continue(error,EROFS);
@@ -70,9 +70,9 @@ namespace epff
 
   static
   int
-  action(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  action(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -84,7 +84,7 @@ namespace epff
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           error_and_continue(error,ENOENT);
         if(branch->ro())
           error_and_continue(error,EROFS);
@@ -104,9 +104,9 @@ namespace epff
 
   static
   int
-  search(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  search(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     const Branch *branch;
 
@@ -114,7 +114,7 @@ namespace epff
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           continue;
 
         paths.push_back(&branch->path);
@@ -131,7 +131,7 @@ Policy::Func::epff(const Category::Enum::Type  type,
                    const Branches             &branches_,
                    const char                 *fusepath,
                    const uint64_t              minfreespace,
-                   vector<const string*>      &paths)
+                   Policy::Func::cstrptrvec   &paths)
 {
   switch(type)
     {
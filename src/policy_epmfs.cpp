@@ -34,10 +34,10 @@ namespace epmfs
 {
   static
   int
-  create(const Branches        &branches_,
-         const char            *fusepath,
-         const uint64_t         minfreespace,
-         vector<const string*> &paths)
+  create(const Branches           &branches_,
+         const char               *fusepath,
+         const uint64_t            minfreespace,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -53,7 +53,7 @@ namespace epmfs
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           error_and_continue(error,ENOENT);
         if(branch->ro_or_nc())
           error_and_continue(error,EROFS);
@@ -81,9 +81,9 @@ namespace epmfs
 
   static
   int
-  action(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  action(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -99,7 +99,7 @@ namespace epmfs
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           error_and_continue(error,ENOENT);
         if(branch->ro())
           error_and_continue(error,EROFS);
@@ -125,9 +125,9 @@ namespace epmfs
 
   static
   int
-  search(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  search(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     uint64_t epmfs;
@@ -141,7 +141,7 @@ namespace epmfs
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath))
+        if(!fs::exists(*branch,fusepath))
           continue;
         rv = fs::statvfs_cache_spaceavail(branch->path,&spaceavail);
         if(rv == -1)
@@ -167,7 +167,7 @@ Policy::Func::epmfs(const Category::Enum::Type  type,
                     const Branches             &branches_,
                     const char                 *fusepath,
                     const uint64_t              minfreespace,
-                    vector<const string*>      &paths)
+                    Policy::Func::cstrptrvec   &paths)
 {
   switch(type)
     {
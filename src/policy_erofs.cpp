@@ -28,7 +28,7 @@ Policy::Func::erofs(const Category::Enum::Type  type,
                     const Branches             &branches_,
                     const char                 *fusepath,
                     const uint64_t              minfreespace,
-                    vector<const string*>      &paths)
+                    Policy::Func::cstrptrvec   &paths)
 {
   return (errno=EROFS,-1);
 }
@@ -32,9 +32,9 @@ namespace ff
 {
   static
   int
-  create(const Branches        &branches_,
-         const uint64_t         minfreespace,
-         vector<const string*> &paths)
+  create(const Branches           &branches_,
+         const uint64_t            minfreespace,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -70,7 +70,7 @@ Policy::Func::ff(const Category::Enum::Type  type,
                  const Branches             &branches_,
                  const char                 *fusepath,
                  const uint64_t              minfreespace,
-                 vector<const string*>      &paths)
+                 Policy::Func::cstrptrvec   &paths)
 {
   if(type == Category::Enum::create)
     return ff::create(branches_,minfreespace,paths);
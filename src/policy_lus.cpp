@@ -33,9 +33,9 @@ namespace lus
 {
   static
   int
-  create(const Branches        &branches_,
-         const uint64_t         minfreespace,
-         vector<const string*> &paths)
+  create(const Branches           &branches_,
+         const uint64_t            minfreespace,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -81,7 +81,7 @@ Policy::Func::lus(const Category::Enum::Type  type,
                   const Branches             &branches_,
                   const char                 *fusepath,
                   const uint64_t              minfreespace,
-                  vector<const string*>      &paths)
+                  Policy::Func::cstrptrvec   &paths)
 {
   if(type == Category::Enum::create)
     return lus::create(branches_,minfreespace,paths);
@@ -36,10 +36,10 @@ namespace newest
 {
   static
   int
-  create(const Branches        &branches_,
-         const char            *fusepath,
-         const uint64_t         minfreespace,
-         vector<const string*> &paths)
+  create(const Branches           &branches_,
+         const char               *fusepath,
+         const uint64_t            minfreespace,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -56,7 +56,7 @@ namespace newest
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath,&st))
+        if(!fs::exists(*branch,fusepath,STATX_MTIME,&st))
           error_and_continue(error,ENOENT);
         if(branch->ro_or_nc())
           error_and_continue(error,EROFS);
@@ -84,9 +84,9 @@ namespace newest
 
   static
   int
-  action(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  action(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     int rv;
     int error;
@@ -103,7 +103,7 @@ namespace newest
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath,&st))
+        if(!fs::exists(*branch,fusepath,STATX_MTIME,&st))
           error_and_continue(error,ENOENT);
         if(branch->ro())
           error_and_continue(error,EROFS);
@@ -129,9 +129,9 @@ namespace newest
 
   static
   int
-  search(const Branches        &branches_,
-         const char            *fusepath,
-         vector<const string*> &paths)
+  search(const Branches           &branches_,
+         const char               *fusepath,
+         Policy::Func::cstrptrvec &paths)
   {
     time_t newest;
     struct stat st;
@@ -144,7 +144,7 @@ namespace newest
       {
         branch = &branches_[i];
 
-        if(!fs::exists(branch->path,fusepath,&st))
+        if(!fs::exists(*branch,fusepath,STATX_MTIME,&st))
           continue;
         if(st.st_mtime < newest)
           continue;
@@ -167,7 +167,7 @@ Policy::Func::newest(const Category::Enum::Type  type,
                      const Branches             &branches_,
                      const char                 *fusepath,
                      const uint64_t              minfreespace,
-                     vector<const string*>      &paths)
+                     Policy::Func::cstrptrvec   &paths)
 {
   switch(type)
     {
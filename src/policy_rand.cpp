@@ -29,7 +29,7 @@ Policy::Func::rand(const Category::Enum::Type  type,
                    const Branches             &branches_,
                    const char                 *fusepath,
                    const uint64_t              minfreespace,
-                   vector<const string*>      &paths)
+                   Policy::Func::cstrptrvec   &paths)
 {
   int rv;
 
@@ -0,0 +1,302 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "pool.hpp"
+
+#include <new>
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define POOL_MAX        8
+#define POOL_THREAD_MAX 64
+#define POOL_SHARED_MAX 1024
+
+namespace l
+{
+  /*
+    Only the owning thread writes its counts. Objects are often freed
+    by a different thread than allocated them so a thread's counts
+    can go negative. Counts of exited threads are kept in g_retired.
+  */
+  struct Thread
+  {
+    Pool::List    lists[POOL_MAX];
+    Pool::Counts  counts[POOL_MAX];
+    Thread       *prev;
+    Thread       *next;
+    bool          registered;
+  };
+
+  static pthread_once_t  g_once = PTHREAD_ONCE_INIT;
+  static pthread_key_t   g_key;
+  static Pool           *g_pools[POOL_MAX];
+  static int             g_count = 0;
+
+  static pthread_mutex_t g_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+  static Thread         *g_threads      = NULL;
+  static Pool::Counts    g_retired[POOL_MAX];
+
+  static __thread Thread t_thread;
+
+  static
+  inline
+  void
+  count(int64_t       *counter_,
+        const int64_t  n_)
+  {
+    __atomic_store_n(counter_,
+                     __atomic_load_n(counter_,__ATOMIC_RELAXED) + n_,
+                     __ATOMIC_RELAXED);
+  }
+
+  static
+  inline
+  Pool::Obj*
+  pop(Pool::List &list_)
+  {
+    Pool::Obj *obj;
+
+    obj        = list_.head;
+    list_.head = obj->next;
+    list_.count--;
+
+    return obj;
+  }
+
+  static
+  inline
+  void
+  push(Pool::List &list_,
+       void       *ptr_)
+  {
+    Pool::Obj *obj = (Pool::Obj*)ptr_;
+
+    obj->next  = list_.head;
+    list_.head = obj;
+    list_.count++;
+  }
+
+  static
+  void
+  thread_exit(void *thread_)
+  {
+    Thread *t = (Thread*)thread_;
+
+    for(int i = 0; i < POOL_MAX; i++)
+      {
+        if(__atomic_load_n(&g_pools[i],__ATOMIC_ACQUIRE) == NULL)
+          continue;
+        g_pools[i]->drain(t->lists[i],t->counts[i],t->lists[i].count);
+      }
+
+    pthread_mutex_lock(&g_threads_lock);
+    for(int i = 0; i < POOL_MAX; i++)
+      {
+        g_retired[i].allocated += t->counts[i].allocated;
+        g_retired[i].inuse     += t->counts[i].inuse;
+        t->counts[i].allocated  = 0;
+        t->counts[i].inuse      = 0;
+      }
+    if(t->prev != NULL)
+      t->prev->next = t->next;
+    else
+      g_threads = t->next;
+    if(t->next != NULL)
+      t->next->prev = t->prev;
+    t->registered = false;
+    pthread_mutex_unlock(&g_threads_lock);
+  }
+
+  static
+  void
+  create_key(void)
+  {
+    pthread_key_create(&g_key,l::thread_exit);
+  }
+
+  static
+  void
+  register_thread(Thread *t_)
+  {
+    pthread_once(&g_once,l::create_key);
+    pthread_setspecific(g_key,t_);
+
+    pthread_mutex_lock(&g_threads_lock);
+    t_->prev = NULL;
+    t_->next = g_threads;
+    if(t_->next != NULL)
+      t_->next->prev = t_;
+    g_threads = t_;
+    pthread_mutex_unlock(&g_threads_lock);
+
+    t_->registered = true;
+  }
+}
+
+Pool::Pool(const size_t size_)
+  : _size((size_ < sizeof(Obj)) ? sizeof(Obj) : size_),
+    _available(0)
+{
+  _shared.head  = NULL;
+  _shared.count = 0;
+  pthread_mutex_init(&_lock,NULL);
+
+  _id = __sync_fetch_and_add(&l::g_count,1);
+  assert(_id < POOL_MAX);
+  __atomic_store_n(&l::g_pools[_id],this,__ATOMIC_RELEASE);
+}
+
+void*
+Pool::alloc(void)
+{
+  Obj       *obj;
+  l::Thread &t    = l::t_thread;
+  List      &list = t.lists[_id];
+
+  if(!t.registered)
+    l::register_thread(&t);
+
+  if((list.head == NULL) && __atomic_load_n(&_available,__ATOMIC_RELAXED))
+    refill(list);
+
+  if(list.head != NULL)
+    {
+      obj = l::pop(list);
+    }
+  else
+    {
+      obj = (Obj*)::malloc(_size);
+      if(obj == NULL)
+        throw std::bad_alloc();
+      l::count(&t.counts[_id].allocated,1);
+    }
+
+  l::count(&t.counts[_id].inuse,1);
+
+  return obj;
+}
+
+void
+Pool::free(void *ptr_)
+{
+  l::Thread &t    = l::t_thread;
+  List      &list = t.lists[_id];
+
+  if(ptr_ == NULL)
+    return;
+
+  if(!t.registered)
+    l::register_thread(&t);
+
+  if(list.count >= POOL_THREAD_MAX)
+    drain(list,t.counts[_id],POOL_THREAD_MAX / 2);
+
+  l::push(list,ptr_);
+  l::count(&t.counts[_id].inuse,-1);
+}
+
+// moves up to count_ objects to the shared list, frees any which
+// don't fit
+void
+Pool::drain(List     &list_,
+            Counts   &counts_,
+            unsigned  count_)
+{
+  Obj *obj;
+
+  pthread_mutex_lock(&_lock);
+  while(count_-- && (list_.head != NULL))
+    {
+      obj = l::pop(list_);
+      if(_shared.count < POOL_SHARED_MAX)
+        {
+          l::push(_shared,obj);
+          continue;
+        }
+
+      ::free(obj);
+      l::count(&counts_.allocated,-1);
+    }
+  __atomic_store_n(&_available,_shared.count,__ATOMIC_RELAXED);
+  pthread_mutex_unlock(&_lock);
+}
+
+void
+Pool::refill(List &list_)
+{
+  pthread_mutex_lock(&_lock);
+  while((_shared.head != NULL) && (list_.count < (POOL_THREAD_MAX / 2)))
+    l::push(list_,l::pop(_shared));
+  __atomic_store_n(&_available,_shared.count,__ATOMIC_RELAXED);
+  pthread_mutex_unlock(&_lock);
+}
+
+/*
+  Threads are read one at a time so the sums can be slightly off
+  while objects are moving between threads. Clamped to be sane.
+*/
+void
+Pool::sum(Counts &counts_) const
+{
+  pthread_mutex_lock(&l::g_threads_lock);
+  counts_ = l::g_retired[_id];
+  for(l::Thread *t = l::g_threads; t != NULL; t = t->next)
+    {
+      counts_.allocated += __atomic_load_n(&t->counts[_id].allocated,__ATOMIC_RELAXED);
+      counts_.inuse     += __atomic_load_n(&t->counts[_id].inuse,__ATOMIC_RELAXED);
+    }
+  pthread_mutex_unlock(&l::g_threads_lock);
+
+  if(counts_.allocated < 0)
+    counts_.allocated = 0;
+  if(counts_.inuse < 0)
+    counts_.inuse = 0;
+  if(counts_.inuse > counts_.allocated)
+    counts_.inuse = counts_.allocated;
+}
+
+uint64_t
+Pool::allocated(void) const
+{
+  Counts counts;
+
+  sum(counts);
+
+  return counts.allocated;
+}
+
+uint64_t
+Pool::inuse(void) const
+{
+  Counts counts;
+
+  sum(counts);
+
+  return counts.inuse;
+}
+
+uint64_t
+Pool::cached(void) const
+{
+  Counts counts;
+
+  sum(counts);
+
+  return (counts.allocated - counts.inuse);
+}
@@ -0,0 +1,87 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+/*
+  Free-list pool of fixed size blocks for objects created and
+  destroyed once per open file or directory. Each thread keeps a
+  short list it can use without locking. Overflow goes to a shared
+  list which threads with an empty list refill from before falling
+  back to malloc. A thread's list is returned to the shared one when
+  it exits. Occupancy is also counted per thread and summed when
+  read. Meant to back class specific operator new/delete.
+*/
+
+class Pool
+{
+public:
+  struct Obj
+  {
+    Obj *next;
+  };
+
+  struct List
+  {
+    Obj      *head;
+    unsigned  count;
+  };
+
+  struct Counts
+  {
+    int64_t allocated;
+    int64_t inuse;
+  };
+
+public:
+  Pool(const size_t size_);
+
+public:
+  void *alloc(void);
+  void  free(void *ptr_);
+
+public:
+  uint64_t allocated(void) const;
+  uint64_t inuse(void) const;
+  uint64_t cached(void) const;
+
+public:
+  void drain(List     &list_,
+             Counts   &counts_,
+             unsigned  count_);
+
+private:
+  void refill(List &list_);
+  void sum(Counts &counts_) const;
+
+private:
+  Pool(const Pool&);
+  Pool &operator=(const Pool&);
+
+private:
+  int             _id;
+  size_t          _size;
+  pthread_mutex_t _lock;
+  List            _shared;
+  unsigned        _available;
+};
@@ -0,0 +1,217 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include "errno.hpp"
+#include "fs_base_fallocate.hpp"
+#include "fs_base_ftruncate.hpp"
+#include "fs_base_stat.hpp"
+#include "fs_base_utime.hpp"
+#include "prealloc.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <pthread.h>
+
+#define PREALLOC_MIN_WINDOW (1024 * 1024)
+
+#ifdef FALLOC_FL_KEEP_SIZE
+namespace l
+{
+  /*
+    Some filesystems (XFS) will punch blocks past EOF but others
+    (ext4) clamp the range to the file's size. Truncating to the
+    current size releases them everywhere but would lose data appended
+    through another handle in the meantime so it's only done if the
+    size didn't change and the punch freed nothing while blocks past
+    EOF remain. Punching and truncating both bump the times so
+    atime/mtime are put back to what the last write or a later
+    utimens (cp -p, tar, rsync) left. ctime can't be restored.
+  */
+  static
+  void
+  release(const int   fd_,
+          const off_t size_,
+          const off_t end_)
+  {
+    int rv;
+    off_t used;
+    struct stat st;
+    struct stat after;
+
+    rv = fs::fstat(fd_,&st);
+    if((rv == -1) || (st.st_size != size_))
+      return;
+
+    fs::fallocate(fd_,
+                  (FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE),
+                  size_,
+                  (end_ - size_));
+
+    rv = fs::fstat(fd_,&after);
+    if((rv == -1) || (after.st_size != size_))
+      return;
+
+    used = (((size_ + st.st_blksize - 1) / st.st_blksize) * st.st_blksize);
+    if((after.st_blocks == st.st_blocks) && ((after.st_blocks * 512) > used))
+      fs::ftruncate(fd_,size_);
+
+    fs::utime(fd_,st);
+  }
+}
+#endif
+
+Prealloc::Prealloc()
+  : _enabled(true),
+    _frontier(-1),
+    _end(0),
+    _window(0)
+{
+  pthread_mutex_init(&_lock,NULL);
+}
+
+Prealloc::~Prealloc()
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+// _enabled is also checked without the lock to skip it on every write
+void
+Prealloc::disable(void)
+{
+  __atomic_store_n(&_enabled,false,__ATOMIC_RELAXED);
+}
+
+/*
+  For when the file's size was changed by other than a write. The
+  frontier is picked up from the file's size on the next write.
+*/
+void
+Prealloc::reset(void)
+{
+  pthread_mutex_lock(&_lock);
+  _frontier = -1;
+  _end      = 0;
+  _window   = 0;
+  pthread_mutex_unlock(&_lock);
+}
+
+#ifdef FALLOC_FL_KEEP_SIZE
+void
+Prealloc::grow(const int      fd_,
+               const off_t    offset_,
+               const size_t   size_,
+               const uint64_t max_)
+{
+  int rv;
+  off_t end;
+  off_t start;
+  struct stat st;
+
+  if(_frontier == -1)
+    {
+      rv = fs::fstat(fd_,&st);
+      _frontier = ((rv == -1) ? 0 : st.st_size);
+    }
+
+  if(!__atomic_load_n(&_enabled,__ATOMIC_RELAXED) || (offset_ < _frontier))
+    return;
+
+  end = (offset_ + size_);
+  _frontier = end;
+  if((end + (off_t)(_window / 2)) < _end)
+    return;
+
+  if(_window == 0)
+    _window = std::min((uint64_t)PREALLOC_MIN_WINDOW,max_);
+  else
+    _window = std::min((uint64_t)(_window * 2),max_);
+
+  start = std::max(_end,end);
+  rv = fs::fallocate(fd_,FALLOC_FL_KEEP_SIZE,start,_window);
+  if(rv == 0)
+    _end = (start + _window);
+  else if((errno == EOPNOTSUPP) || (errno == ENOSYS))
+    __atomic_store_n(&_enabled,false,__ATOMIC_RELAXED);
+}
+
+void
+Prealloc::write(const int      fd_,
+                const off_t    offset_,
+                const size_t   size_,
+                const uint64_t max_)
+{
+  if((max_ == 0) || !__atomic_load_n(&_enabled,__ATOMIC_RELAXED))
+    return;
+
+  pthread_mutex_lock(&_lock);
+  grow(fd_,offset_,size_,max_);
+  pthread_mutex_unlock(&_lock);
+}
+
+void
+Prealloc::trim(const int fd_)
+{
+  int rv;
+  struct stat st;
+
+  pthread_mutex_lock(&_lock);
+  if(_end != 0)
+    {
+      rv = fs::fstat(fd_,&st);
+      if((rv == 0) && (st.st_size < _end))
+        l::release(fd_,st.st_size,_end);
+
+      _end    = 0;
+      _window = 0;
+    }
+  pthread_mutex_unlock(&_lock);
+}
+#else
+void
+Prealloc::grow(const int      fd_,
+               const off_t    offset_,
+               const size_t   size_,
+               const uint64_t max_)
+{
+
+}
+
+void
+Prealloc::write(const int      fd_,
+                const off_t    offset_,
+                const size_t   size_,
+                const uint64_t max_)
+{
+
+}
+
+void
+Prealloc::trim(const int fd_)
+{
+
+}
+#endif
@@ -0,0 +1,68 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <pthread.h>
+
+/*
+  Preallocates space past the end of files being grown so that
+  appends, which with many writers can interleave on the branch,
+  land in larger contiguous extents. Space is reserved with
+  FALLOC_FL_KEEP_SIZE ahead of the highest written offset in a window
+  which doubles, up to the configured max, while writes keep growing
+  the file. Writes within the existing data leave it alone. Whatever
+  wasn't used is released by trim() when the file is closed or
+  truncated.
+*/
+class Prealloc
+{
+public:
+  Prealloc();
+  ~Prealloc();
+
+public:
+  void write(const int      fd,
+             const off_t    offset,
+             const size_t   size,
+             const uint64_t max);
+  void trim(const int fd);
+  void reset(void);
+  void disable(void);
+
+private:
+  void grow(const int      fd,
+            const off_t    offset,
+            const size_t   size,
+            const uint64_t max);
+
+private:
+  Prealloc(const Prealloc&);
+  Prealloc &operator=(const Prealloc&);
+
+private:
+  pthread_mutex_t _lock;
+  bool            _enabled;
+  off_t           _frontier;
+  off_t           _end;
+  size_t          _window;
+};
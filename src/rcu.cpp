@@ -0,0 +1,198 @@
+/*
+  ISC License
+
+  Copyright (c) 2020, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "rcu.hpp"
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+
+#define RCU_YIELDS 16
+
+/*
+  Each thread which reads gets a slot on its own cache line so read
+  sections never write to memory shared with other threads. A slot
+  holds 0 when the thread is outside a read section and otherwise the
+  grace period counter as it was when the section began. Slots of
+  exited threads are reused.
+*/
+
+namespace l
+{
+  struct Slot
+  {
+    uint64_t  counter;
+    bool      used;
+    Slot     *next;
+  } __attribute__((aligned(64)));
+
+  static pthread_mutex_t g_lock    = PTHREAD_MUTEX_INITIALIZER;
+  static pthread_once_t  g_once    = PTHREAD_ONCE_INIT;
+  static pthread_key_t   g_key;
+  static Slot           *g_slots   = NULL;
+  static uint64_t        g_counter = 1;
+
+  static __thread Slot     *t_slot    = NULL;
+  static __thread uint64_t  t_nesting = 0;
+
+  static
+  void
+  release_slot(void *slot_)
+  {
+    Slot *slot = (Slot*)slot_;
+
+    pthread_mutex_lock(&g_lock);
+    slot->counter = 0;
+    slot->used    = false;
+    pthread_mutex_unlock(&g_lock);
+  }
+
+  static
+  void
+  create_key(void)
+  {
+    pthread_key_create(&g_key,l::release_slot);
+  }
+
+  static
+  Slot*
+  acquire_slot(void)
+  {
+    Slot *slot;
+
+    pthread_once(&g_once,l::create_key);
+
+    pthread_mutex_lock(&g_lock);
+    for(slot = g_slots; slot != NULL; slot = slot->next)
+      {
+        if(!slot->used)
+          break;
+      }
+
+    if(slot == NULL)
+      {
+        slot = new Slot();
+        slot->next = g_slots;
+        g_slots    = slot;
+      }
+
+    slot->counter = 0;
+    slot->used    = true;
+    pthread_mutex_unlock(&g_lock);
+
+    pthread_setspecific(g_key,slot);
+
+    return slot;
+  }
+
+  static
+  bool
+  in_old_section(const Slot     *slot_,
+                 const uint64_t  counter_)
+  {
+    uint64_t counter;
+
+    counter = __atomic_load_n(&slot_->counter,__ATOMIC_ACQUIRE);
+
+    return ((counter != 0) && (counter < counter_));
+  }
+}
+
+namespace l
+{
+  /*
+    Read sections are short so the first few checks only yield. A
+    section held across blocking I/O could otherwise keep the writer
+    spinning for as long as the I/O takes so after that it sleeps,
+    doubling from 1us up to 1ms.
+  */
+  static
+  void
+  backoff(const uint64_t attempt_)
+  {
+    struct timespec ts;
+
+    if(attempt_ < RCU_YIELDS)
+      {
+        sched_yield();
+        return;
+      }
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = (1000L << std::min(attempt_ - RCU_YIELDS,(uint64_t)10));
+    ::nanosleep(&ts,NULL);
+  }
+}
+
+namespace rcu
+{
+  void
+  read_lock(void)
+  {
+    if(l::t_nesting++ != 0)
+      return;
+
+    if(l::t_slot == NULL)
+      l::t_slot = l::acquire_slot();
+
+    __atomic_store_n(&l::t_slot->counter,
+                     __atomic_load_n(&l::g_counter,__ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+    // the store above must be visible before the protected pointer is loaded
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  }
+
+  void
+  read_unlock(void)
+  {
+    if(--l::t_nesting != 0)
+      return;
+
+    __atomic_store_n(&l::t_slot->counter,0,__ATOMIC_RELEASE);
+  }
+
+  /*
+    Must not be called from within a read section. The pointer swap
+    is ordered before the counter bump so any section starting after
+    the bump sees the new pointer. Sections which began earlier are
+    waited out.
+  */
+  void
+  synchronize(void)
+  {
+    uint64_t  counter;
+    l::Slot  *slots;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    counter = __atomic_add_fetch(&l::g_counter,1,__ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&l::g_lock);
+    slots = l::g_slots;
+    pthread_mutex_unlock(&l::g_lock);
+
+    for(l::Slot *slot = slots; slot != NULL; slot = slot->next)
+      {
+        for(uint64_t i = 0; l::in_old_section(slot,counter); i++)
+          l::backoff(i);
+      }
+  }
+}
@@ -0,0 +1,111 @@
+/*
+  ISC License
+
+  Copyright (c) 2020, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+/*
+  Minimal read-copy-update. Data which is read on every request but
+  rarely changed (the branch list) is published as an immutable
+  snapshot behind an rcu::Ptr. Readers enter a read section, which
+  only touches a per-thread counter, and load the pointer. Writers
+  copy the current snapshot, modify the copy, swap it in, and call
+  rcu::synchronize() before freeing the old one. synchronize()
+  returns once every read section which could have seen the old
+  pointer has ended. Read sections may nest.
+*/
+
+namespace rcu
+{
+  void read_lock(void);
+  void read_unlock(void);
+  void synchronize(void);
+
+  class ReadLock
+  {
+  public:
+    ReadLock()
+    {
+      rcu::read_lock();
+    }
+
+    ~ReadLock()
+    {
+      rcu::read_unlock();
+    }
+  };
+
+  template<typename T>
+  class Ptr
+  {
+  public:
+    Ptr(T *ptr_ = NULL)
+      : _ptr(ptr_)
+    {
+    }
+
+  public:
+    T *
+    load(void) const
+    {
+      return __atomic_load_n(&_ptr,__ATOMIC_ACQUIRE);
+    }
+
+    T *
+    exchange(T *ptr_)
+    {
+      return __atomic_exchange_n(&_ptr,ptr_,__ATOMIC_ACQ_REL);
+    }
+
+  private:
+    Ptr(const Ptr&);
+    Ptr &operator=(const Ptr&);
+
+  private:
+    T *_ptr;
+  };
+
+  /*
+    A read section holding one snapshot. Everything looked up through
+    it is consistent for the life of the object.
+  */
+  template<typename T>
+  class Snapshot
+  {
+  public:
+    Snapshot(const Ptr<T> &ptr_)
+      : _lock(),
+        _ptr(ptr_.load())
+    {
+    }
+
+  public:
+    const T &operator*(void)  const { return *_ptr; }
+    const T *operator->(void) const { return _ptr; }
+
+  private:
+    Snapshot();
+    Snapshot(const Snapshot&);
+    Snapshot &operator=(const Snapshot&);
+
+  private:
+    const ReadLock  _lock;
+    const T        *_ptr;
+  };
+}
@@ -0,0 +1,111 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "fs_base_fadvise.hpp"
+#include "readahead.hpp"
+
+#include <algorithm>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// _next starts out matching no offset so the first read never
+// counts as sequential and a window is only issued on the second
+ReadAhead::ReadAhead()
+  : _next(-1),
+    _end(0),
+    _window(0)
+{
+
+}
+
+/*
+  Reads from the kernel can arrive slightly out of order when
+  multiple threads service the same file so anything landing from
+  `behind_` bytes before the expected offset up to `end_` is still
+  considered sequential.
+*/
+bool
+ReadAhead::sequential(const off_t next_,
+                      const off_t offset_,
+                      const off_t behind_,
+                      const off_t end_)
+{
+  if(offset_ == next_)
+    return true;
+
+  return ((offset_ >= (next_ - behind_)) &&
+          (offset_ <= end_));
+}
+
+/*
+  Concurrent readers of the same handle update the state without a
+  lock. Losing an update only costs a hint so the fields are
+  accessed atomically but not kept consistent with each other. The
+  reader which moves `_end` forward is the one which issues the hint.
+*/
+void
+ReadAhead::read(const int      fd_,
+                const off_t    offset_,
+                const size_t   size_,
+                const uint64_t max_)
+{
+  off_t end;
+  off_t next;
+  off_t start;
+  size_t window;
+
+  if(max_ == 0)
+    return;
+
+  next   = __atomic_load_n(&_next,__ATOMIC_RELAXED);
+  end    = __atomic_load_n(&_end,__ATOMIC_RELAXED);
+  window = __atomic_load_n(&_window,__ATOMIC_RELAXED);
+
+  if(window == 0 ?
+     (offset_ != next) :
+     !ReadAhead::sequential(next,offset_,window,end))
+    {
+      __atomic_store_n(&_next,(off_t)(offset_ + size_),__ATOMIC_RELAXED);
+      __atomic_store_n(&_end,(off_t)0,__ATOMIC_RELAXED);
+      __atomic_store_n(&_window,(size_t)0,__ATOMIC_RELAXED);
+      return;
+    }
+
+  while((next < (off_t)(offset_ + size_)) &&
+        !__atomic_compare_exchange_n(&_next,&next,(off_t)(offset_ + size_),true,
+                                     __ATOMIC_RELAXED,__ATOMIC_RELAXED))
+    ;
+  next = std::max(next,(off_t)(offset_ + size_));
+  if((next + (off_t)(window / 2)) < end)
+    return;
+
+  if(window == 0)
+    window = std::min((uint64_t)READAHEAD_MIN_WINDOW,max_);
+  else
+    window = std::min((uint64_t)window * 2,max_);
+
+  start = std::max(end,next);
+  if(!__atomic_compare_exchange_n(&_end,&end,(off_t)(start + window),false,
+                                  __ATOMIC_RELAXED,__ATOMIC_RELAXED))
+    return;
+
+  __atomic_store_n(&_window,window,__ATOMIC_RELAXED);
+  fs::fadvise_willneed(fd_,start,window);
+}
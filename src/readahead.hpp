@@ -0,0 +1,54 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define READAHEAD_MIN_WINDOW (1024 * 1024)
+
+/*
+  Tracks the read pattern of an open file and hints the kernel to
+  read ahead of sequential readers on the underlying file. The window
+  starts small and doubles, up to the configured max, while reads
+  stay sequential. Any random access resets it.
+*/
+class ReadAhead
+{
+public:
+  ReadAhead();
+
+public:
+  void read(const int      fd,
+            const off_t    offset,
+            const size_t   size,
+            const uint64_t max);
+
+public:
+  static bool sequential(const off_t next,
+                         const off_t offset,
+                         const off_t behind,
+                         const off_t end);
+
+private:
+  off_t  _next;
+  off_t  _end;
+  size_t _window;
+};
@@ -23,15 +23,18 @@ namespace rwlock
   class ReadGuard
   {
   public:
+    // a NULL lock makes the guard a no-op
     ReadGuard(pthread_rwlock_t *lock_)
       : _lock(lock_)
     {
-      pthread_rwlock_rdlock(_lock);
+      if(_lock)
+        pthread_rwlock_rdlock(_lock);
     }
 
     ~ReadGuard()
     {
-      pthread_rwlock_unlock(_lock);
+      if(_lock)
+        pthread_rwlock_unlock(_lock);
     }
 
   private:
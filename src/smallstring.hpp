@@ -0,0 +1,58 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+  Immutable string with N bytes of inline storage. Only allocates when
+  the string and its terminator don't fit. Keeps objects which hold a
+  path, such as FileInfo, to a single allocation in the common case.
+*/
+template<size_t N>
+class SmallString
+{
+public:
+  SmallString(const char *str_)
+    : _size(::strlen(str_))
+  {
+    _data = ((_size < N) ? _inline : new char[_size + 1]);
+    ::memcpy(_data,str_,_size + 1);
+  }
+
+  ~SmallString()
+  {
+    if(_data != _inline)
+      delete[] _data;
+  }
+
+public:
+  const char *c_str(void) const { return _data; }
+  size_t      size(void) const { return _size; }
+
+private:
+  SmallString(const SmallString&);
+  SmallString &operator=(const SmallString&);
+
+private:
+  char   *_data;
+  size_t  _size;
+  char    _inline[N];
+};
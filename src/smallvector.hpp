@@ -0,0 +1,102 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+/*
+  Vector with N elements of inline storage. Only moves to the heap if
+  more than N elements are pushed. Meant for small, trivially
+  copyable values such as the branch pointers returned by policies.
+*/
+template<typename T, size_t N>
+class SmallVector
+{
+public:
+  typedef T       *iterator;
+  typedef const T *const_iterator;
+
+public:
+  SmallVector()
+    : _data(_inline),
+      _size(0),
+      _capacity(N)
+  {
+  }
+
+  ~SmallVector()
+  {
+    if(_data != _inline)
+      delete[] _data;
+  }
+
+public:
+  void
+  push_back(const T &val_)
+  {
+    if(_size == _capacity)
+      grow();
+
+    _data[_size++] = val_;
+  }
+
+  void
+  clear(void)
+  {
+    _size = 0;
+  }
+
+  size_t size(void) const { return _size; }
+  bool   empty(void) const { return (_size == 0); }
+
+  T       &operator[](const size_t i_)       { return _data[i_]; }
+  const T &operator[](const size_t i_) const { return _data[i_]; }
+
+  iterator       begin(void)       { return _data; }
+  iterator       end(void)         { return _data + _size; }
+  const_iterator begin(void) const { return _data; }
+  const_iterator end(void)   const { return _data + _size; }
+
+private:
+  void
+  grow(void)
+  {
+    T *data;
+
+    data = new T[_capacity * 2];
+    for(size_t i = 0; i < _size; i++)
+      data[i] = _data[i];
+
+    if(_data != _inline)
+      delete[] _data;
+
+    _data      = data;
+    _capacity *= 2;
+  }
+
+private:
+  SmallVector(const SmallVector&);
+  SmallVector &operator=(const SmallVector&);
+
+private:
+  T      *_data;
+  size_t  _size;
+  size_t  _capacity;
+  T       _inline[N];
+};
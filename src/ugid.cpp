@@ -16,20 +16,49 @@
 
 #include "gidcache.hpp"
 
+#include <pthread.h>
+
 #if defined __linux__ and UGID_USE_RWLOCK == 0
 #include "ugid_linux.icpp"
 #else
 #include "ugid_rwlock.icpp"
 #endif
 
+namespace l
+{
+  static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+  static pthread_key_t  g_key;
+
+  static
+  void
+  destroy_cache(void *cache_)
+  {
+    delete (gid_t_cache*)cache_;
+  }
+
+  static
+  void
+  create_key(void)
+  {
+    pthread_key_create(&g_key,l::destroy_cache);
+  }
+}
+
 namespace ugid
 {
   void
   initgroups(const uid_t uid,
              const gid_t gid)
   {
-    static __thread gid_t_cache cache = {0};
+    static __thread gid_t_cache *cache = NULL;
+
+    if(cache == NULL)
+      {
+        pthread_once(&l::g_once,l::create_key);
+        cache = new gid_t_cache();
+        pthread_setspecific(l::g_key,cache);
+      }
 
-    cache.initgroups(uid,gid);
+    cache->initgroups(uid,gid);
   }
 }
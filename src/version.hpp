@@ -0,0 +1,2 @@
+#pragma once
+static const char MERGERFS_VERSION[] = "8a82378-dirty";
@@ -0,0 +1,435 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "errno.hpp"
+#include "fileinfo.hpp"
+#include "fs_base_stat.hpp"
+#include "fs_base_write.hpp"
+#include "fs_movefile.hpp"
+#include "rwlock.hpp"
+#include "writecombine.hpp"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+typedef std::pair<dev_t,ino_t>       Key;
+typedef std::multimap<Key,FileInfo*> Tracked;
+
+static pthread_mutex_t g_tracked_lock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_tracked_cond  = PTHREAD_COND_INITIALIZER;
+static Tracked         g_tracked;
+static uint64_t        g_tracked_count = 0;
+
+namespace l
+{
+  static
+  void
+  track(FileInfo *fi_)
+  {
+    int rv;
+    struct stat st;
+    writecombine::Buffer &buf = fi_->writebuf;
+
+    rv = fs::fstat(fi_->fd,&st);
+    if(rv == -1)
+      return;
+
+    buf.dev = st.st_dev;
+    buf.ino = st.st_ino;
+
+    pthread_mutex_lock(&g_tracked_lock);
+    g_tracked.insert(std::make_pair(Key(buf.dev,buf.ino),fi_));
+    __atomic_add_fetch(&g_tracked_count,1,__ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_tracked_lock);
+  }
+
+  static
+  void
+  dirty(FileInfo     *fi_,
+        const off_t   offset_,
+        const size_t  size_)
+  {
+    if(fi_->movefile != NULL)
+      fi_->movefile->dirty(offset_,size_);
+  }
+
+  static
+  void
+  consume(writecombine::Buffer &buf_,
+          const size_t          size_)
+  {
+    buf_.size   -= size_;
+    buf_.offset += size_;
+    memmove(buf_.data,buf_.data + size_,buf_.size);
+  }
+
+  static
+  int
+  append(writecombine::Buffer &buf_,
+         const char           *data_,
+         const size_t          size_)
+  {
+    memcpy(buf_.data + buf_.size,data_,size_);
+    buf_.size += size_;
+
+    return size_;
+  }
+
+  static
+  int
+  flush_locked(FileInfo *fi_)
+  {
+    ssize_t rv;
+    writecombine::Buffer &buf = fi_->writebuf;
+
+    while(buf.size > 0)
+      {
+        rv = fs::pwrite(fi_->fd,buf.data,buf.size,buf.offset);
+        if((rv == -1) && (errno == EINTR))
+          continue;
+        if(rv == -1)
+          return -errno;
+        if(rv == 0)
+          return -EIO;
+
+        l::dirty(fi_,buf.offset,rv);
+        l::consume(buf,rv);
+      }
+
+    return 0;
+  }
+
+  static
+  int
+  flush_overlapping(FileInfo     *fi_,
+                    const off_t   offset_,
+                    const size_t  size_)
+  {
+    int rv;
+    writecombine::Buffer &buf = fi_->writebuf;
+
+    if(buf.data == NULL)
+      return 0;
+
+    const rwlock::ReadGuard guard(&fi_->lock);
+
+    rv = 0;
+    pthread_mutex_lock(&buf.lock);
+    if((offset_ < (off_t)(buf.offset + buf.size)) &&
+       ((off_t)(offset_ + size_) > buf.offset))
+      rv = l::flush_locked(fi_);
+    pthread_mutex_unlock(&buf.lock);
+
+    return rv;
+  }
+
+  /*
+    Handles are pinned while the global lock is dropped so the
+    flushes don't serialize every tracked file behind each other.
+    release() waits for the pins to go before the FileInfo is freed.
+  */
+  static
+  void
+  pin(const dev_t              dev_,
+      const ino_t              ino_,
+      std::vector<FileInfo*>  &fis_)
+  {
+    Tracked::iterator i;
+    std::pair<Tracked::iterator,Tracked::iterator> range;
+
+    pthread_mutex_lock(&g_tracked_lock);
+    range = g_tracked.equal_range(Key(dev_,ino_));
+    for(i = range.first; i != range.second; ++i)
+      {
+        i->second->writebuf.pins++;
+        fis_.push_back(i->second);
+      }
+    pthread_mutex_unlock(&g_tracked_lock);
+  }
+
+  static
+  void
+  unpin(const std::vector<FileInfo*> &fis_)
+  {
+    pthread_mutex_lock(&g_tracked_lock);
+    for(size_t i = 0; i < fis_.size(); i++)
+      fis_[i]->writebuf.pins--;
+    pthread_cond_broadcast(&g_tracked_cond);
+    pthread_mutex_unlock(&g_tracked_lock);
+  }
+
+  /*
+    Writes out whatever is buffered along with the new data, which
+    follows on from it, in one pwritev. Like a regular direct_io write
+    a short write of the new data is returned as such.
+  */
+  static
+  int
+  write_through(FileInfo     *fi_,
+                const char   *data_,
+                const size_t  size_,
+                const off_t   offset_)
+  {
+    ssize_t rv;
+    struct iovec iov[2];
+    writecombine::Buffer &buf = fi_->writebuf;
+
+    while(buf.size > 0)
+      {
+        iov[0].iov_base = buf.data;
+        iov[0].iov_len  = buf.size;
+        iov[1].iov_base = (void*)data_;
+        iov[1].iov_len  = size_;
+
+        rv = fs::pwritev(fi_->fd,iov,2,buf.offset);
+        if((rv == -1) && (errno == EINTR))
+          continue;
+        if(rv == -1)
+          return -errno;
+        if(rv == 0)
+          return -EIO;
+
+        l::dirty(fi_,buf.offset,rv);
+        if((size_t)rv <= buf.size)
+          {
+            l::consume(buf,rv);
+            continue;
+          }
+
+        rv -= buf.size;
+        buf.size = 0;
+
+        return rv;
+      }
+
+    rv = fs::pwrite(fi_->fd,data_,size_,offset_);
+    if(rv == -1)
+      return -errno;
+
+    l::dirty(fi_,offset_,rv);
+
+    return rv;
+  }
+
+  static
+  int
+  write_locked(FileInfo     *fi_,
+               const char   *data_,
+               const size_t  size_,
+               const off_t   offset_,
+               const size_t  max_)
+  {
+    int rv;
+    writecombine::Buffer &buf = fi_->writebuf;
+
+    if((buf.size > 0) && (offset_ == (off_t)(buf.offset + buf.size)))
+      {
+        if((buf.size + size_) <= std::min(buf.capacity,max_))
+          return l::append(buf,data_,size_);
+
+        return l::write_through(fi_,data_,size_,offset_);
+      }
+
+    rv = l::flush_locked(fi_);
+    if(rv < 0)
+      return rv;
+
+    if(size_ >= max_)
+      return l::write_through(fi_,data_,size_,offset_);
+
+    if(buf.data == NULL)
+      {
+        buf.data = (char*)malloc(max_);
+        if(buf.data == NULL)
+          return l::write_through(fi_,data_,size_,offset_);
+        buf.capacity = max_;
+      }
+
+    if(size_ >= buf.capacity)
+      return l::write_through(fi_,data_,size_,offset_);
+
+    buf.offset = offset_;
+
+    return l::append(buf,data_,size_);
+  }
+}
+
+namespace writecombine
+{
+  Buffer::Buffer()
+    : data(NULL),
+      size(0),
+      capacity(0),
+      offset(0),
+      dev(0),
+      ino(0),
+      pins(0)
+  {
+    pthread_mutex_init(&lock,NULL);
+  }
+
+  Buffer::~Buffer()
+  {
+    free(data);
+    pthread_mutex_destroy(&lock);
+  }
+
+  int
+  write(FileInfo     *fi_,
+        const char   *buf_,
+        const size_t  count_,
+        const off_t   offset_,
+        const size_t  max_)
+  {
+    int rv;
+    bool allocated;
+
+    pthread_mutex_lock(&fi_->writebuf.lock);
+    allocated = (fi_->writebuf.data != NULL);
+    rv = l::write_locked(fi_,buf_,count_,offset_,max_);
+    allocated = (!allocated && (fi_->writebuf.data != NULL));
+    pthread_mutex_unlock(&fi_->writebuf.lock);
+
+    if(allocated)
+      l::track(fi_);
+
+    return rv;
+  }
+
+  int
+  flush(FileInfo *fi_)
+  {
+    int rv;
+
+    if(fi_->writebuf.data == NULL)
+      return 0;
+
+    const rwlock::ReadGuard guard(&fi_->lock);
+
+    pthread_mutex_lock(&fi_->writebuf.lock);
+    rv = l::flush_locked(fi_);
+    pthread_mutex_unlock(&fi_->writebuf.lock);
+
+    return rv;
+  }
+
+  /*
+    Other handles to the same file may have the range buffered as
+    well. Their errors stay with them like with flush(dev,ino).
+  */
+  int
+  flush(FileInfo     *fi_,
+        const off_t   offset_,
+        const size_t  size_)
+  {
+    int rv;
+    struct stat st;
+    std::vector<FileInfo*> fis;
+    Buffer &buf = fi_->writebuf;
+
+    rv = l::flush_overlapping(fi_,offset_,size_);
+
+    if(__atomic_load_n(&g_tracked_count,__ATOMIC_ACQUIRE) <= ((buf.data != NULL) ? 1 : 0))
+      return rv;
+
+    if(buf.data != NULL)
+      {
+        st.st_dev = buf.dev;
+        st.st_ino = buf.ino;
+      }
+    else if(fs::fstat(fi_->fd,&st) == -1)
+      {
+        return rv;
+      }
+
+    l::pin(st.st_dev,st.st_ino,fis);
+    for(size_t i = 0; i < fis.size(); i++)
+      {
+        if(fis[i] != fi_)
+          l::flush_overlapping(fis[i],offset_,size_);
+      }
+    l::unpin(fis);
+
+    return rv;
+  }
+
+  /*
+    Returns true if any handle had data buffered for the file. Errors
+    stay with the handle's buffer to be returned by its own flush.
+  */
+  bool
+  flush(const dev_t dev_,
+        const ino_t ino_)
+  {
+    bool rv;
+    std::vector<FileInfo*> fis;
+
+    if(__atomic_load_n(&g_tracked_count,__ATOMIC_ACQUIRE) == 0)
+      return false;
+
+    rv = false;
+    l::pin(dev_,ino_,fis);
+    for(size_t i = 0; i < fis.size(); i++)
+      {
+        FileInfo *fi = fis[i];
+
+        pthread_mutex_lock(&fi->writebuf.lock);
+        rv |= (fi->writebuf.size > 0);
+        pthread_mutex_unlock(&fi->writebuf.lock);
+
+        writecombine::flush(fi);
+      }
+    l::unpin(fis);
+
+    return rv;
+  }
+
+  void
+  release(FileInfo *fi_)
+  {
+    Tracked::iterator i;
+    std::pair<Tracked::iterator,Tracked::iterator> range;
+    Buffer &buf = fi_->writebuf;
+
+    if(buf.data == NULL)
+      return;
+
+    pthread_mutex_lock(&g_tracked_lock);
+    range = g_tracked.equal_range(Key(buf.dev,buf.ino));
+    for(i = range.first; i != range.second; ++i)
+      {
+        if(i->second != fi_)
+          continue;
+
+        g_tracked.erase(i);
+        __atomic_sub_fetch(&g_tracked_count,1,__ATOMIC_RELEASE);
+        break;
+      }
+    while(buf.pins > 0)
+      pthread_cond_wait(&g_tracked_cond,&g_tracked_lock);
+    pthread_mutex_unlock(&g_tracked_lock);
+  }
+}
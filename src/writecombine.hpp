@@ -0,0 +1,90 @@
+/*
+  ISC License
+
+  Copyright (c) 2019, Antonio SJ Musumeci <trapexit@spawn.link>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <pthread.h>
+
+class FileInfo;
+
+/*
+  Optional combining of small, contiguous direct_io writes into larger
+  writes to the branch file. A write which extends the buffered range
+  is copied and reported as successful. The buffer is written out when
+  a write doesn't follow on from it, it would overflow, and on
+  flush/fsync/release or reads of the buffered range. Errors from
+  writing it out are returned by whichever of those triggered it and
+  the data is kept so it can be retried.
+
+  Handles with a buffer are tracked by the underlying file's device
+  and inode so a getattr by path, which has no handle, or a read
+  through another handle can write out what other handles have
+  buffered for the same file first.
+
+  write() must be called with FileInfo::lock held shared. The flush
+  functions take it themselves.
+*/
+
+namespace writecombine
+{
+  class Buffer
+  {
+  public:
+    Buffer();
+    ~Buffer();
+
+  public:
+    pthread_mutex_t  lock;
+    char            *data;
+    size_t           size;
+    size_t           capacity;
+    off_t            offset;
+    dev_t            dev;
+    ino_t            ino;
+    unsigned         pins;
+
+  private:
+    Buffer(const Buffer&);
+    Buffer &operator=(const Buffer&);
+  };
+
+  int
+  write(FileInfo     *fi,
+        const char   *buf,
+        const size_t  count,
+        const off_t   offset,
+        const size_t  max);
+
+  int
+  flush(FileInfo *fi);
+
+  int
+  flush(FileInfo     *fi,
+        const off_t   offset,
+        const size_t  size);
+
+  bool
+  flush(const dev_t dev,
+        const ino_t ino);
+
+  void
+  release(FileInfo *fi);
+}